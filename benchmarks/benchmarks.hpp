@@ -0,0 +1,80 @@
+#pragma once
+
+#include "factory.hpp"
+#include "random_distributions.hpp"
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+namespace benchmarks
+{
+
+auto ndtree_regroup() -> void;
+auto ndtree_backends() -> void;
+auto ndtree_summary() -> void;
+auto ndtree_refit() -> void;
+auto ndtree_rebuild() -> void;
+auto bh_walk() -> void;
+auto bh_traversal() -> void;
+auto bh_multipole() -> void;
+auto bh_opening() -> void;
+auto bh_mixed_precision() -> void;
+auto bh_reorder() -> void;
+auto fmm_scaling() -> void;
+auto bf_pairwise() -> void;
+auto storage_layout() -> void;
+auto working_memory() -> void;
+auto solver_loops() -> void;
+auto block_timesteps() -> void;
+
+namespace common
+{
+
+inline constexpr auto seed_mass     = 104845342u;
+inline constexpr auto seed_position = 982523355u;
+
+// Cold, uniform cloud of unit masses that collapses under its own gravity
+template <std::size_t N, std::floating_point F>
+auto generate_cold_cloud(std::size_t size, F radius)
+{
+    using namespace pm::factory;
+    using namespace utility::random_distributions;
+
+    auto mass_generator = []() -> F { return F{ 1 }; };
+
+    auto position_generator = [radius]() mutable -> F {
+        using distribution_t = random_distribution<F, DistributionCategory::Uniform>;
+        using param_type     = typename distribution_t::param_type;
+        static const param_type params(-radius, radius);
+        static distribution_t   d(params, seed_position);
+        return d();
+    };
+
+    auto velocity_generator = []() -> F { return F{ 0 }; };
+
+    return particle_set_factory<N, F>(
+        size, mass_generator, position_generator, velocity_generator
+    );
+}
+
+template <typename Fn>
+[[nodiscard]]
+auto time_it(Fn&& fn) -> double
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::forward<Fn>(fn)();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+inline auto print_header(std::string_view name) -> void
+{
+    std::cout << "\n=== " << name << " ===\n";
+}
+
+} // namespace common
+
+} // namespace benchmarks
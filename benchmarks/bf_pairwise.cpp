@@ -0,0 +1,89 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "benchmarks.hpp"
+#include "brute_force.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Full force pass of the brute force engine: one sum per particle against the pairwise
+// pass that evaluates every unordered pair once, serial and with per-band buffers,
+// and against the tiled SIMD kernel. Throughput is in particle pairs per microsecond.
+
+namespace benchmarks
+{
+
+auto bf_pairwise() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t = simulation::bf::brute_force_computation<particle_t, interaction>;
+    using acceleration_t  = typename particle_t::acceleration_t;
+    constexpr auto radius = F{ 100 };
+
+    common::print_header("bf pairwise: per particle sums against bulk passes");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    std::cout << std::setw(12) << "particles" << std::setw(14) << "pass" << std::setw(14)
+              << "force ms" << std::setw(10) << "P2P/us" << std::setw(16)
+              << "max rel diff" << '\n';
+    for (const auto size : { 5'000uz, 20'000uz, 50'000uz })
+    {
+        const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::duration<F>(1),
+            .duration_       = std::chrono::duration<F>(1),
+            .particle_count_ = size,
+            .sim_type_       = simulation::config::SimulationType::brute_force
+        };
+
+        auto       engine    = engine_t(particles, base_config);
+        auto       reference = std::vector<acceleration_t>(size);
+        const auto t_sums    = common::time_it([&] {
+            for (auto i = 0uz; i != size; ++i)
+            {
+                reference[i] = engine.get_acceleration(0, i);
+            }
+        });
+        const auto pairs = static_cast<double>(size * (size - 1));
+        std::cout << std::setw(12) << size << std::setw(14) << "per particle"
+                  << std::fixed << std::setprecision(1) << std::setw(14) << 1e3 * t_sums
+                  << std::setprecision(0) << std::setw(10) << 1e-6 * pairs / t_sums
+                  << std::defaultfloat << std::setprecision(6) << std::setw(16) << 0
+                  << std::endl;
+
+        const auto report = [&](auto const& name, double time) {
+            auto max_diff = F{ 0 };
+            for (auto i = 0uz; i != size; ++i)
+            {
+                max_diff = std::max(
+                    max_diff,
+                    pm::utils::l2_norm((engine.get_acceleration(0, i) - reference[i])
+                                           .value()) /
+                        pm::utils::l2_norm(reference[i].value())
+                );
+            }
+            std::cout << std::setw(12) << size << std::setw(14) << name << std::fixed
+                      << std::setprecision(1) << std::setw(14) << 1e3 * time
+                      << std::setprecision(0) << std::setw(10) << 1e-6 * pairs / time
+                      << std::defaultfloat << std::setprecision(3) << std::setw(16)
+                      << max_diff << std::setprecision(6) << std::endl;
+        };
+        report("pairwise", common::time_it([&] { engine.compute_accelerations(0); }));
+        report("pairwise par", common::time_it([&] {
+                   engine.compute_accelerations(std::execution::par, 0);
+               }));
+        report("simd tiled", common::time_it([&] {
+                   engine.compute_accelerations(std::execution::par_unseq, 0);
+               }));
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,98 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "brute_force.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Force phase time and error of the group walk with the far field in double and in
+// mixed precision over a range of theta, against the brute force engine.
+
+namespace benchmarks
+{
+
+auto bh_mixed_precision() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using brute_force_t =
+        simulation::bf::brute_force_computation<particle_t, interaction>;
+    using acceleration_t     = typename particle_t::acceleration_t;
+    constexpr auto size      = 100'000uz;
+    constexpr auto radius    = F{ 100 };
+    constexpr auto reference = 500uz;
+
+    common::print_header("bh mixed precision: double against float far field");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::duration<F>(1),
+        .duration_       = std::chrono::duration<F>(1),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::barnes_hut
+    };
+
+    auto exact       = std::vector<acceleration_t>(reference);
+    auto brute_force = brute_force_t(particles, base_config);
+    for (auto i = 0uz; i != reference; ++i)
+    {
+        exact[i] = brute_force.get_acceleration(0, i);
+    }
+
+    std::cout << std::setw(12) << "far field" << std::setw(8) << "theta" << std::setw(12)
+              << "evals/part" << std::setw(14) << "force ms" << std::setw(16)
+              << "mean rel error" << std::setw(16) << "max rel error" << '\n';
+    for (const auto theta : { F{ 0.3 }, F{ 0.5 }, F{ 0.7 } })
+    {
+        for (const auto mixed : { false, true })
+        {
+            simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+                .tree_max_depth_    = 16,
+                .tree_box_capacity_ = 16,
+                .theta_             = theta,
+                .traversal_         = simulation::config::TraversalType::group,
+                .mixed_precision_   = mixed
+            };
+            auto engine = engine_t(particles, base_config, bh_config);
+
+            auto       accelerations = std::vector<acceleration_t>(size);
+            const auto force         = common::time_it([&] {
+                engine.commit_buffer(0);
+                for (auto i = 0uz; i != size; ++i)
+                {
+                    accelerations[i] = engine.get_acceleration(0, i);
+                }
+            });
+            auto mean_error = F{ 0 };
+            auto max_error  = F{ 0 };
+            for (auto i = 0uz; i != reference; ++i)
+            {
+                const auto error =
+                    pm::utils::l2_norm((accelerations[i] - exact[i]).value()) /
+                    pm::utils::l2_norm(exact[i].value());
+                mean_error += error / static_cast<F>(reference);
+                max_error   = std::max(max_error, error);
+            }
+            std::cout << std::setw(12) << (mixed ? "mixed" : "double") << std::setw(8)
+                      << theta << std::setw(12) << engine.f_eval_count() / size
+                      << std::fixed << std::setprecision(1) << std::setw(14)
+                      << 1e3 * force << std::defaultfloat << std::setprecision(3)
+                      << std::setw(16) << mean_error << std::setw(16) << max_error
+                      << std::setprecision(6) << std::endl;
+        }
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
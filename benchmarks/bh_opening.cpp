@@ -0,0 +1,114 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "brute_force.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// Cells opened and force error of the opening criteria over a range of theta, against
+// the brute force engine. The relative error criterion is given a first evaluation to
+// take the previous accelerations from, and only the second one is timed.
+
+namespace benchmarks
+{
+
+auto bh_opening() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using brute_force_t =
+        simulation::bf::brute_force_computation<particle_t, interaction>;
+    using acceleration_t     = typename particle_t::acceleration_t;
+    constexpr auto size      = 100'000uz;
+    constexpr auto radius    = F{ 100 };
+    constexpr auto reference = 500uz;
+
+    common::print_header("bh opening: geometric, bmax and relative error criteria");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::duration<F>(1),
+        .duration_       = std::chrono::duration<F>(1),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::barnes_hut
+    };
+
+    auto exact       = std::vector<acceleration_t>(reference);
+    auto brute_force = brute_force_t(particles, base_config);
+    for (auto i = 0uz; i != reference; ++i)
+    {
+        exact[i] = brute_force.get_acceleration(0, i);
+    }
+
+    std::cout << std::setw(16) << "criterion" << std::setw(8) << "theta" << std::setw(12)
+              << "evals/part" << std::setw(14) << "force ms" << std::setw(16)
+              << "mean rel error" << std::setw(16) << "max rel error" << '\n';
+    const auto run = [&]<typename Criterion>(std::string_view name, F theta) {
+        simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+            .tree_max_depth_ = 16, .tree_box_capacity_ = 8, .theta_ = theta
+        };
+        auto engine = simulation::bh_approx::barnes_hut_approximation<
+            particle_t,
+            interaction,
+            2,
+            ndt::ndtree<2, particle_t>,
+            storage::soa_storage,
+            Criterion>(particles, base_config, bh_config);
+
+        auto       accelerations = std::vector<acceleration_t>(size);
+        const auto evaluate      = [&] {
+            engine.commit_buffer(0);
+            for (auto i = 0uz; i != size; ++i)
+            {
+                accelerations[i] = engine.get_acceleration(0, i);
+            }
+        };
+        if constexpr (Criterion::s_uses_acceleration)
+        {
+            evaluate();
+        }
+        const auto evals_before = engine.f_eval_count();
+        const auto force        = common::time_it(evaluate);
+        auto       mean_error   = F{ 0 };
+        auto       max_error    = F{ 0 };
+        for (auto i = 0uz; i != reference; ++i)
+        {
+            const auto error =
+                pm::utils::l2_norm((accelerations[i] - exact[i]).value()) /
+                pm::utils::l2_norm(exact[i].value());
+            mean_error += error / static_cast<F>(reference);
+            max_error   = std::max(max_error, error);
+        }
+        std::cout << std::setw(16) << name << std::setw(8) << theta << std::setw(12)
+                  << (engine.f_eval_count() - evals_before) / size << std::fixed
+                  << std::setprecision(1) << std::setw(14) << 1e3 * force
+                  << std::defaultfloat << std::setprecision(3) << std::setw(16)
+                  << mean_error << std::setw(16) << max_error << std::setprecision(6)
+                  << std::endl;
+    };
+    namespace opening = simulation::bh_approx::opening;
+    for (const auto theta : { F{ 0.3 }, F{ 0.5 }, F{ 0.7 } })
+    {
+        run.operator()<opening::geometric>("geometric", theta);
+        run.operator()<opening::bmax>("bmax", theta);
+    }
+    // theta squared is the relative force error tolerance
+    for (const auto theta : { F{ 0.03 }, F{ 0.05 }, F{ 0.1 } })
+    {
+        run.operator()<opening::relative_error>("relative error", theta);
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,91 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+// Force phase of the particle and group walks with the particles in generation order,
+// which scatters the samples of every leaf over memory, and after sorting them along a
+// Morton or a Hilbert curve. Also the time of the sort itself.
+
+namespace benchmarks
+{
+
+auto bh_reorder() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using acceleration_t  = typename particle_t::acceleration_t;
+    using traversal_t     = simulation::config::TraversalType;
+    using curve_t         = simulation::config::ReorderCurveType;
+    constexpr auto size   = 200'000uz;
+    constexpr auto radius = F{ 100 };
+
+    common::print_header("bh reorder: generation order against space filling curves");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::duration<F>(1),
+        .duration_       = std::chrono::duration<F>(1),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::barnes_hut
+    };
+
+    std::cout << std::setw(12) << "traversal" << std::setw(12) << "order"
+              << std::setw(14) << "reorder ms" << std::setw(14) << "force ms" << '\n';
+    for (const auto traversal : { traversal_t::particle, traversal_t::group })
+    {
+        for (const auto curve : { std::optional<curve_t>{},
+                                  std::optional{ curve_t::morton },
+                                  std::optional{ curve_t::hilbert } })
+        {
+            simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+                .tree_max_depth_    = 16,
+                .tree_box_capacity_ = 8,
+                .theta_             = F{ 0.5 },
+                .traversal_         = traversal,
+                .reorder_curve_     = curve.value_or(curve_t::hilbert)
+            };
+            auto engine  = engine_t(particles, base_config, bh_config);
+            auto reorder = 0.0;
+            if (curve.has_value())
+            {
+                reorder = common::time_it([&] { engine.reorder(); });
+            }
+
+            auto       accelerations = std::vector<acceleration_t>(size);
+            const auto force         = common::time_it([&] {
+                engine.commit_buffer(0);
+                for (auto i = 0uz; i != size; ++i)
+                {
+                    accelerations[i] = engine.get_acceleration(0, i);
+                }
+            });
+            std::cout << std::setw(12)
+                      << simulation::config::detail::traversal_type_to_str(traversal)
+                      << std::setw(12)
+                      << (curve.has_value()
+                              ? simulation::config::detail::reorder_curve_type_to_str(
+                                    curve.value()
+                                )
+                              : "generation")
+                      << std::fixed << std::setprecision(1) << std::setw(14)
+                      << 1e3 * reorder << std::setw(14) << 1e3 * force
+                      << std::defaultfloat << std::endl;
+        }
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,103 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Force phase of the per particle walk against the group (leaf bucket) walk and the dual
+// tree walk over a range of bucket sizes, with their error against direct summation.
+
+namespace benchmarks
+{
+
+auto bh_traversal() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using interaction_t      = typename engine_t::interaction_t;
+    using acceleration_t     = typename particle_t::acceleration_t;
+    using traversal_t        = simulation::config::TraversalType;
+    constexpr auto size      = 100'000uz;
+    constexpr auto radius    = F{ 100 };
+    constexpr auto theta     = F{ 0.5 };
+    constexpr auto reference = 500uz;
+
+    common::print_header("bh traversal: per particle against group and dual walk");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+
+    // Direct summation for the first particles
+    auto exact = std::vector<acceleration_t>(reference);
+    for (auto i = 0uz; i != reference; ++i)
+    {
+        for (auto const& other : particles)
+        {
+            if (other.id() != particles[i].id())
+            {
+                exact[i] = exact[i] +
+                           interaction_t::acceleration_contribution(particles[i], other);
+            }
+        }
+    }
+
+    std::cout << std::setw(10) << "capacity" << std::setw(11) << "traversal"
+              << std::setw(12) << "evals/part" << std::setw(14) << "force ms"
+              << std::setw(16) << "max rel error" << '\n';
+    for (const auto capacity : { 4uz, 8uz, 16uz, 32uz, 64uz })
+    {
+        for (const auto traversal :
+             { traversal_t::particle, traversal_t::group, traversal_t::dual })
+        {
+            simulation::config::simulation_common_config<particle_t> base_config{
+                .dt_             = std::chrono::duration<F>(1),
+                .duration_       = std::chrono::duration<F>(1),
+                .particle_count_ = size,
+                .sim_type_       = simulation::config::SimulationType::barnes_hut
+            };
+            simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+                .tree_max_depth_    = 16,
+                .tree_box_capacity_ = capacity,
+                .theta_             = theta,
+                .traversal_         = traversal
+            };
+            auto engine = engine_t(particles, base_config, bh_config);
+
+            auto       accelerations = std::vector<acceleration_t>(size);
+            const auto force         = common::time_it([&] {
+                engine.commit_buffer(0);
+                for (auto i = 0uz; i != size; ++i)
+                {
+                    accelerations[i] = engine.get_acceleration(0, i);
+                }
+            });
+            auto max_error = F{ 0 };
+            for (auto i = 0uz; i != reference; ++i)
+            {
+                max_error = std::max(
+                    max_error,
+                    pm::utils::l2_norm((accelerations[i] - exact[i]).value()) /
+                        pm::utils::l2_norm(exact[i].value())
+                );
+            }
+            std::cout << std::setw(10) << capacity << std::setw(11)
+                      << simulation::config::detail::traversal_type_to_str(traversal)
+                      << std::setw(12) << engine.f_eval_count() / size << std::fixed
+                      << std::setprecision(1) << std::setw(14) << 1e3 * force
+                      << std::defaultfloat << std::setprecision(3) << std::setw(16)
+                      << max_error << std::setprecision(6) << std::endl;
+        }
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
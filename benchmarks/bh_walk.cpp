@@ -0,0 +1,169 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+// Per interaction cost of the engine's iterative tree walk against the previous
+// recursive fold_left walk, which captured the particle by value at every level and
+// copied every accepted summary.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+// Previous implementation
+template <
+    typename Interaction_Type,
+    typename Box_Type,
+    typename Particle_Type,
+    typename F>
+[[nodiscard]]
+auto recursive_walk(
+    Box_Type const&      b,
+    Particle_Type const& p,
+    F                    theta_sq,
+    std::size_t&         f_evals
+) -> typename Particle_Type::acceleration_t
+{
+    using acceleration_t = typename Particle_Type::acceleration_t;
+    if (!b.summary().has_value() || b.summary().value().id() == p.id())
+    {
+        return acceleration_t{};
+    }
+    auto const summary = b.summary().value();
+    const auto s       = pm::utils::l2_norm_sq(b.diagonal_length().value());
+    const auto d       = pm::utils::l2_norm_sq(
+        pm::utils::distance(p.position(), summary.position()).value()
+    );
+    if ((s / d) < theta_sq)
+    {
+        ++f_evals;
+        return Interaction_Type::acceleration_contribution(p, summary);
+    }
+    if (b.fragmented())
+    {
+        return std::ranges::fold_left(
+            b.subboxes(),
+            acceleration_t{},
+            [p, theta_sq, &f_evals](auto acc, auto const& sb) {
+                return acceleration_t{
+                    std::move(acc) +
+                    recursive_walk<Interaction_Type>(sb, p, theta_sq, f_evals)
+                };
+            }
+        );
+    }
+    return std::ranges::fold_left(
+        b.contained_elements(),
+        acceleration_t{},
+        [p, &f_evals](auto acc, auto const* const other) {
+            if (other->id() == p.id())
+            {
+                return acc;
+            }
+            ++f_evals;
+            return acceleration_t{
+                std::move(acc) + Interaction_Type::acceleration_contribution(p, *other)
+            };
+        }
+    );
+}
+
+template <typename Fn>
+[[nodiscard]]
+auto best_of(std::size_t repetitions, Fn&& fn) -> double
+{
+    auto best = std::numeric_limits<double>::max();
+    for (auto i = 0uz; i != repetitions; ++i)
+    {
+        best = std::min(best, common::time_it(fn));
+    }
+    return best;
+}
+
+} // namespace
+
+auto bh_walk() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using interaction_t     = typename engine_t::interaction_t;
+    using acceleration_t    = typename particle_t::acceleration_t;
+    constexpr auto radius   = F{ 100 };
+    constexpr auto walked   = 20'000uz;
+    constexpr auto repeats  = 3uz;
+    constexpr auto capacity = 8uz;
+
+    common::print_header("bh walk: iterative against recursive tree walk");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    std::cout << std::setw(12) << "particles" << std::setw(8) << "theta" << std::setw(14)
+              << "evals/part" << std::setw(18) << "recursive ns/ev" << std::setw(18)
+              << "iterative ns/ev" << std::setw(14) << "max rel diff" << '\n';
+    for (const auto size : { 100'000uz, 1'000'000uz })
+    {
+        const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+        for (const auto theta : { F{ 0.3 }, F{ 0.7 } })
+        {
+            simulation::config::simulation_common_config<particle_t> base_config{
+                .dt_             = std::chrono::duration<F>(1),
+                .duration_       = std::chrono::duration<F>(1),
+                .particle_count_ = size,
+                .sim_type_       = simulation::config::SimulationType::barnes_hut
+            };
+            simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+                .tree_max_depth_ = 16, .tree_box_capacity_ = capacity, .theta_ = theta
+            };
+            auto engine = engine_t(particles, base_config, bh_config);
+            engine.commit_buffer(0);
+            auto const& root = engine.tree().box();
+            auto const& ps   = engine.current_system_state();
+
+            auto       recursive = std::vector<acceleration_t>(walked);
+            auto       f_evals   = 0uz;
+            const auto t_rec     = best_of(repeats, [&] {
+                f_evals = 0;
+                for (auto i = 0uz; i != walked; ++i)
+                {
+                    recursive[i] = recursive_walk<interaction_t>(
+                        root, ps[i], theta * theta, f_evals
+                    );
+                }
+            });
+            auto       max_diff = F{ 0 };
+            const auto t_it     = best_of(repeats, [&] {
+                max_diff = F{ 0 };
+                for (auto i = 0uz; i != walked; ++i)
+                {
+                    const auto a = engine.get_box_contribution(ps[i], root);
+                    max_diff     = std::max(
+                        max_diff,
+                        pm::utils::l2_norm((a - recursive[i]).value()) /
+                            pm::utils::l2_norm(recursive[i].value())
+                    );
+                }
+            });
+            const auto evals = static_cast<double>(f_evals);
+            std::cout << std::setw(12) << size << std::setw(8) << theta << std::setw(14)
+                      << f_evals / walked << std::fixed << std::setprecision(2)
+                      << std::setw(18) << 1e9 * t_rec / evals << std::setw(18)
+                      << 1e9 * t_it / evals << std::defaultfloat << std::setw(14)
+                      << max_diff << std::endl;
+        }
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,107 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "factory.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Individual block timesteps against Yoshida steps as short as the finest bin, on a
+// dense core inside a sparse halo. Forces from the group walk, errors are the distance
+// to the positions the short shared steps give after one step.
+
+namespace benchmarks
+{
+
+auto block_timesteps() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    constexpr auto size        = 10'000uz;
+    constexpr auto core        = size / 5;
+    constexpr auto core_radius = F{ 5 };
+    constexpr auto bins        = 6u;
+    constexpr auto dt          = F{ 0.125 };
+
+    common::print_header("block timesteps: individual against shared steps");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    auto rng      = std::mt19937{ common::seed_position };
+    auto uniform  = std::uniform_real_distribution<F>(F{ -1 }, F{ 1 });
+    auto calls    = 0uz;
+    auto position = [&]() -> F {
+        return (calls++ / N < core ? core_radius : F{ 100 }) * uniform(rng);
+    };
+    const auto particles = pm::factory::particle_set_factory<N, F>(
+        size, [] { return F{ 1 }; }, position, [] { return F{ 0 }; }
+    );
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::duration<F>(dt),
+        .duration_       = std::chrono::duration<F>(dt),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::barnes_hut
+    };
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_    = 16,
+        .tree_box_capacity_ = 16,
+        .theta_             = F{ 0.5 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+
+    auto shared_config = base_config;
+    shared_config.dt_  = std::chrono::duration<F>(dt / F{ 1 << bins });
+
+    auto       shared         = engine_t(particles, shared_config, bh_config);
+    const auto shared_seconds = common::time_it([&] { shared.run(); });
+
+    std::cout << std::setw(22) << "solver" << std::setw(16) << "evals/part"
+              << std::setw(12) << "step ms" << std::setw(16) << "max error"
+              << std::setw(16) << "mean error" << '\n';
+    const auto report = [&](std::string const& name, engine_t const& engine, F seconds) {
+        auto max_error  = F{ 0 };
+        auto mean_error = F{ 0 };
+        for (auto p_idx = 0uz; p_idx != size; ++p_idx)
+        {
+            auto d = F{ 0 };
+            for (auto i = 0uz; i != N; ++i)
+            {
+                const auto delta =
+                    engine.position_read(p_idx)[i] - shared.position_read(p_idx)[i];
+                d += delta * delta;
+            }
+            max_error = std::max(max_error, std::sqrt(d));
+            mean_error += std::sqrt(d) / static_cast<F>(size);
+        }
+        std::cout << std::setw(22) << name << std::setw(16)
+                  << engine.f_eval_count() / size << std::fixed << std::setprecision(1)
+                  << std::setw(12) << 1e3 * seconds << std::scientific
+                  << std::setprecision(2) << std::setw(16) << max_error << std::setw(16)
+                  << mean_error << std::defaultfloat << std::setprecision(6)
+                  << std::endl;
+    };
+    report("yoshida dt / 2^6", shared, shared_seconds);
+    for (const auto accuracy : { F{ 0.05 }, F{ 0.1 }, F{ 0.2 } })
+    {
+        auto block_config               = base_config;
+        block_config.timestep_bins_     = bins;
+        block_config.timestep_accuracy_ = accuracy;
+        auto       block   = engine_t(particles, block_config, bh_config);
+        const auto seconds = common::time_it([&] { block.run(); });
+        report("block eta " + std::to_string(accuracy).substr(0, 4), block, seconds);
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
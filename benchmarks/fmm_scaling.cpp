@@ -0,0 +1,131 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "fast_multipole_method.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Force phase of the fast multipole method against the group walk of the Barnes-Hut
+// engine for growing particle counts, at comparable accuracy. Errors are against direct
+// summation over the first particles.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+template <typename Engine, typename Acceleration_Type>
+auto report(
+    std::string_view                      name,
+    std::size_t                           size,
+    Engine&                               engine,
+    std::vector<Acceleration_Type> const& exact
+) -> void
+{
+    using F                  = typename Acceleration_Type::value_type;
+    auto       accelerations = std::vector<Acceleration_Type>(size);
+    const auto force         = common::time_it([&] {
+        engine.commit_buffer(0);
+        for (auto i = 0uz; i != size; ++i)
+        {
+            accelerations[i] = engine.get_acceleration(0, i);
+        }
+    });
+    auto mean_error = F{ 0 };
+    for (auto i = 0uz; i != std::ranges::size(exact); ++i)
+    {
+        mean_error += pm::utils::l2_norm((accelerations[i] - exact[i]).value()) /
+                      pm::utils::l2_norm(exact[i].value()) /
+                      static_cast<F>(std::ranges::size(exact));
+    }
+    std::cout << std::setw(12) << size << std::setw(14) << name << std::fixed
+              << std::setprecision(1) << std::setw(14) << 1e3 * force << std::setw(16)
+              << 1e9 * force / static_cast<double>(size) << std::defaultfloat
+              << std::setprecision(3) << std::setw(16) << mean_error
+              << std::setprecision(6) << std::endl;
+}
+
+} // namespace
+
+auto fmm_scaling() -> void
+{
+    using namespace std::literals;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using bh_engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using fmm_engine_t =
+        simulation::fmm::fast_multipole_method<particle_t, interaction>;
+    using interaction_t      = typename bh_engine_t::interaction_t;
+    using acceleration_t     = typename particle_t::acceleration_t;
+    constexpr auto radius    = F{ 100 };
+    constexpr auto reference = 200uz;
+
+    common::print_header("fmm scaling: fast multipole method against barnes hut");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    std::cout << std::setw(12) << "particles" << std::setw(14) << "engine"
+              << std::setw(14) << "force ms" << std::setw(16) << "ns/particle"
+              << std::setw(16) << "mean rel error" << '\n';
+    for (const auto size : { 25'000uz, 100'000uz, 400'000uz })
+    {
+        const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+        auto       exact     = std::vector<acceleration_t>(reference);
+        for (auto i = 0uz; i != reference; ++i)
+        {
+            for (auto const& other : particles)
+            {
+                if (other.id() != particles[i].id())
+                {
+                    exact[i] = exact[i] + interaction_t::acceleration_contribution(
+                                              particles[i], other
+                                          );
+                }
+            }
+        }
+
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::duration<F>(1),
+            .duration_       = std::chrono::duration<F>(1),
+            .particle_count_ = size,
+            .sim_type_       = simulation::config::SimulationType::_none_
+        };
+        {
+            simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+                .tree_max_depth_    = 16,
+                .tree_box_capacity_ = 16,
+                .theta_             = F{ 0.5 },
+                .traversal_         = simulation::config::TraversalType::group,
+                .quadrupole_        = true
+            };
+            auto engine = bh_engine_t(particles, base_config, bh_config);
+            report("barnes hut", size, engine, exact);
+        }
+        for (const auto& [name, order, theta] :
+             { std::tuple{ "fmm p=3 0.7"sv, 3u, F{ 0.7 } },
+               std::tuple{ "fmm p=5 0.5"sv, 5u, F{ 0.5 } } })
+        {
+            simulation::config::fmm_specific_config<particle_t> fmm_config{
+                .tree_max_depth_    = 16,
+                .tree_box_capacity_ = 32,
+                .theta_             = theta,
+                .expansion_order_   = order
+            };
+            auto engine = fmm_engine_t(particles, base_config, fmm_config);
+            report(name, size, engine, exact);
+        }
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
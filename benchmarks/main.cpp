@@ -0,0 +1,55 @@
+#undef USE_ROOT_PLOTTING
+#include "benchmarks.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+// Usage: benchmarks [name...]. Runs every benchmark when no name is given.
+int main(int argc, char** argv)
+{
+    using namespace std::literals;
+    static constexpr auto registry = std::array{
+        std::pair{ "ndtree_regroup"sv, &benchmarks::ndtree_regroup },
+        std::pair{ "ndtree_backends"sv, &benchmarks::ndtree_backends },
+        std::pair{ "ndtree_summary"sv, &benchmarks::ndtree_summary },
+        std::pair{ "ndtree_refit"sv, &benchmarks::ndtree_refit },
+        std::pair{ "ndtree_rebuild"sv, &benchmarks::ndtree_rebuild },
+        std::pair{ "bh_walk"sv, &benchmarks::bh_walk },
+        std::pair{ "bh_traversal"sv, &benchmarks::bh_traversal },
+        std::pair{ "bh_multipole"sv, &benchmarks::bh_multipole },
+        std::pair{ "bh_opening"sv, &benchmarks::bh_opening },
+        std::pair{ "bh_mixed_precision"sv, &benchmarks::bh_mixed_precision },
+        std::pair{ "bh_reorder"sv, &benchmarks::bh_reorder },
+        std::pair{ "fmm_scaling"sv, &benchmarks::fmm_scaling },
+        std::pair{ "bf_pairwise"sv, &benchmarks::bf_pairwise },
+        std::pair{ "storage_layout"sv, &benchmarks::storage_layout },
+        std::pair{ "working_memory"sv, &benchmarks::working_memory },
+        std::pair{ "solver_loops"sv, &benchmarks::solver_loops },
+        std::pair{ "block_timesteps"sv, &benchmarks::block_timesteps },
+    };
+
+    if (argc == 1)
+    {
+        for (auto const& [name, fn] : registry)
+        {
+            fn();
+        }
+        return EXIT_SUCCESS;
+    }
+    for (int i = 1; i != argc; ++i)
+    {
+        const auto it = std::ranges::find(
+            registry, std::string_view{ argv[i] }, [](auto const& e) { return e.first; }
+        );
+        if (it == std::ranges::end(registry))
+        {
+            std::cerr << "Unknown benchmark: " << argv[i] << '\n';
+            return EXIT_FAILURE;
+        }
+        it->second();
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "benchmarks.hpp"
+#include "linear_ndtree.hpp"
+#include "ndtree.hpp"
+#include "particle.hpp"
+#include "particle_interaction.hpp"
+#include "utils.hpp"
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Build, reorganize, summary and traversal cost of the pointer based ndtree, serial and
+// parallel construction, against the Morton ordered linear_ndtree on the same particle
+// sets.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+// Barnes-Hut walk with the same opening criterion as the engine
+template <
+    typename Interaction_Type,
+    typename Box_Type,
+    typename Particle_Type,
+    typename F>
+[[nodiscard]]
+auto walk(Box_Type const& b, Particle_Type const& p, F theta_sq) ->
+    typename Particle_Type::acceleration_t
+{
+    using acceleration_t = typename Particle_Type::acceleration_t;
+    if (!b.summary().has_value() || b.summary().value().id() == p.id())
+    {
+        return acceleration_t{};
+    }
+    const auto s = pm::utils::l2_norm_sq(b.diagonal_length().value());
+    const auto d = pm::utils::l2_norm_sq(
+        pm::utils::distance(p.position(), b.summary().value().position()).value()
+    );
+    if ((s / d) < theta_sq)
+    {
+        return Interaction_Type::acceleration_contribution(p, b.summary().value());
+    }
+    if (b.fragmented())
+    {
+        return std::ranges::fold_left(
+            b.subboxes(),
+            acceleration_t{},
+            [&p, theta_sq](auto acc, auto const& sb) {
+                return acceleration_t{ std::move(acc) +
+                                       walk<Interaction_Type>(sb, p, theta_sq) };
+            }
+        );
+    }
+    return std::ranges::fold_left(
+        b.contained_elements(),
+        acceleration_t{},
+        [&p](auto acc, auto const* const other) {
+            if (other->id() == p.id())
+            {
+                return acc;
+            }
+            return acceleration_t{
+                std::move(acc) + Interaction_Type::acceleration_contribution(p, *other)
+            };
+        }
+    );
+}
+
+template <typename Tree_Type, bool Parallel_Build = false, typename Particle_Type>
+auto run_backend(
+    std::string_view            name,
+    std::vector<Particle_Type>& particles,
+    std::size_t                 walked
+) -> void
+{
+    using F               = typename Particle_Type::value_type;
+    using interaction_t   = pm::interaction::particle_interaction_t<
+          Particle_Type,
+          pm::interaction::InteractionType::Gravitational>;
+    constexpr auto theta  = F{ 0.5 };
+    constexpr auto depth  = 16u;
+    const auto     limits = ndt::detail::compute_limits(particles);
+
+    std::optional<Tree_Type> tree;
+    const auto               build = common::time_it([&] {
+        if constexpr (Parallel_Build)
+        {
+            tree.emplace(std::execution::par, particles, depth, 8uz, limits);
+        }
+        else
+        {
+            tree.emplace(particles, depth, 8uz, limits);
+        }
+    });
+    // Small drift, what a solver substep does to the tree
+    for (auto& p : particles)
+    {
+        for (auto& x : p.position())
+        {
+            x *= F{ 0.999 };
+        }
+    }
+    const auto reorganize = common::time_it([&] { tree->reorganize(); });
+    const auto summary    = common::time_it([&] { tree->cache_summary(); });
+    auto       checksum   = F{ 0 };
+    const auto traversal  = common::time_it([&] {
+        for (auto i = 0uz; i != walked; ++i)
+        {
+            checksum += walk<interaction_t>(tree->box(), particles[i], theta * theta)[0];
+        }
+    });
+    for (auto& p : particles)
+    {
+        for (auto& x : p.position())
+        {
+            x /= F{ 0.999 };
+        }
+    }
+
+    std::cout << std::setw(16) << name << std::setw(10) << tree->box().boxes()
+              << std::fixed << std::setprecision(2) << std::setw(12) << 1e3 * build
+              << std::setw(14) << 1e3 * reorganize << std::setw(12) << 1e3 * summary
+              << std::setw(14) << 1e6 * traversal / static_cast<double>(walked)
+              << std::defaultfloat << std::setw(16) << checksum << '\n';
+}
+
+} // namespace
+
+auto ndtree_backends() -> void
+{
+    using F                 = double;
+    static constexpr auto N = 3;
+    using particle_t        = pm::particle::ndparticle<N, F>;
+    constexpr auto radius   = F{ 100 };
+    constexpr auto walked   = 20'000uz;
+
+    common::print_header("ndtree backends: pointer tree against linear (Morton) tree");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    for (const auto size : { 100'000uz, 1'000'000uz })
+    {
+        auto particles = common::generate_cold_cloud<N, F>(size, radius);
+        std::cout << "Particles: " << size << '\n';
+        std::cout << std::setw(16) << "backend" << std::setw(10) << "boxes"
+                  << std::setw(12) << "build ms" << std::setw(14) << "reorganize ms"
+                  << std::setw(12) << "summary ms" << std::setw(14) << "walk us/part"
+                  << std::setw(16) << "checksum" << '\n';
+        run_backend<ndt::ndtree<2, particle_t>>("ndtree", particles, walked);
+        run_backend<ndt::ndtree<2, particle_t>, true>("ndtree (par)", particles, walked);
+        run_backend<ndt::linear_ndtree<2, particle_t>>(
+            "linear_ndtree", particles, walked
+        );
+        std::cout << '\n';
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
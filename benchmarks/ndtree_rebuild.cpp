@@ -0,0 +1,88 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "benchmarks.hpp"
+#include "ndtree.hpp"
+#include "particle.hpp"
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Reorganizing after every particle moved by up to a given number of leaf widths per
+// coordinate: relocating the escaped samples, rebuilding the tree, and the adaptive
+// policy picking one of them from the migration it finds. Small moves are what a
+// virialized system sees in a step, large ones what a collapse or a long step gives.
+
+namespace benchmarks
+{
+
+auto ndtree_rebuild() -> void
+{
+    using F                 = double;
+    static constexpr auto N = 3;
+    using particle_t        = pm::particle::ndparticle<N, F>;
+    using tree_t            = ndt::ndtree<2, particle_t>;
+    constexpr auto size     = 200'000uz;
+    constexpr auto radius   = F{ 100 };
+    constexpr auto depth    = 16u;
+    constexpr auto capacity = 8uz;
+    constexpr auto repeats  = 3uz;
+
+    common::print_header("ndtree rebuild: relocating against rebuilding");
+    std::cout << std::setw(8) << "leaves" << std::setw(12) << "escaped %" << std::setw(12)
+              << "mean climb" << std::setw(14) << "relocate ms" << std::setw(14)
+              << "rebuild ms" << std::setw(14) << "adaptive ms" << std::setw(12)
+              << "adaptive" << '\n';
+    const auto cloud  = common::generate_cold_cloud<N, F>(size, radius);
+    const auto limits = tree_t::boundary_t(F{ -2 } * radius, F{ 2 } * radius);
+    // A leaf is about 2 radius / cbrt(size / capacity) across
+    const auto leaf = F{ 2 } * radius / std::cbrt(static_cast<F>(size / capacity));
+    for (const auto leaves : { F{ 0.01 }, F{ 0.1 }, F{ 0.3 }, F{ 1 }, F{ 3 }, F{ 10 } })
+    {
+        auto rng     = std::mt19937{ common::seed_mass };
+        auto uniform = std::uniform_real_distribution<F>(-leaves, leaves);
+        auto moved   = cloud;
+        for (auto& p : moved)
+        {
+            for (auto& x : p.position())
+            {
+                x += leaf * uniform(rng);
+            }
+        }
+
+        // Time of the best of the repetitions, and the statistics of the last one
+        auto       stats         = ndt::reorganize_stats{};
+        const auto reorganize_ms = [&](ndt::ReorganizeMode mode) {
+            auto best = std::numeric_limits<double>::max();
+            for (auto i = 0uz; i != repeats; ++i)
+            {
+                auto particles = cloud;
+                auto tree = tree_t(std::execution::par, particles, depth, capacity, limits);
+                tree.set_reorganize_policy({ .mode = mode });
+                std::ranges::copy(moved, std::ranges::begin(particles));
+                best  = std::min(best, common::time_it([&] { tree.reorganize(); }));
+                stats = tree.reorganize_statistics();
+            }
+            return 1e3 * best;
+        };
+        const auto relocate_ms = reorganize_ms(ndt::ReorganizeMode::relocate);
+        const auto rebuild_ms  = reorganize_ms(ndt::ReorganizeMode::rebuild);
+        const auto adaptive_ms = reorganize_ms(ndt::ReorganizeMode::adaptive);
+        std::cout << std::setw(8) << leaves << std::fixed << std::setprecision(2)
+                  << std::setw(12)
+                  << 1e2 * static_cast<double>(stats.escaped) / static_cast<double>(size)
+                  << std::setw(12)
+                  << static_cast<double>(stats.climbed) /
+                         static_cast<double>(std::max(stats.escaped, 1uz))
+                  << std::setw(14) << relocate_ms << std::setw(14) << rebuild_ms
+                  << std::setw(14) << adaptive_ms << std::setw(12)
+                  << (stats.rebuilt ? "rebuild" : "relocate") << std::defaultfloat
+                  << '\n';
+    }
+}
+
+} // namespace benchmarks
@@ -0,0 +1,123 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "benchmarks.hpp"
+#include "ndtree.hpp"
+#include "particle.hpp"
+#include "utils.hpp"
+#include <array>
+#include <cmath>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Tree maintenance over the four substages of a step: reorganizing, regrouping and
+// summarizing at every substage against doing it at the first one and refitting at the
+// others. Particles drift by about a tenth of a leaf per substage. Extent growth is the
+// mean of how much longer the diagonal of a leaf extent is than that of its box.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+template <typename Box_Type>
+auto extent_growth(Box_Type const& b, double& growth, std::size_t& leaves) -> void
+{
+    if (b.fragmented())
+    {
+        for (auto const& sb : b.subboxes())
+        {
+            extent_growth(sb, growth, leaves);
+        }
+        return;
+    }
+    growth += static_cast<double>(
+        pm::utils::l2_norm(b.diagonal_length().value()) /
+        pm::utils::l2_norm(b.boundary().diagonal_length().value())
+    );
+    growth -= 1.0;
+    ++leaves;
+}
+
+} // namespace
+
+auto ndtree_refit() -> void
+{
+    using F                  = double;
+    static constexpr auto N  = 3;
+    using particle_t         = pm::particle::ndparticle<N, F>;
+    using tree_t             = ndt::ndtree<2, particle_t>;
+    constexpr auto radius    = F{ 100 };
+    constexpr auto depth     = 16u;
+    constexpr auto capacity  = 8uz;
+    constexpr auto steps     = 5uz;
+    constexpr auto substages = 4uz;
+
+    common::print_header("ndtree refit: reorganize per substage against per step");
+    std::cout << std::setw(12) << "particles" << std::setw(20) << "reorganize ms/step"
+              << std::setw(16) << "refit ms/step" << std::setw(18) << "extent growth %"
+              << '\n';
+    for (const auto size : { 100'000uz, 1'000'000uz })
+    {
+        const auto cloud = common::generate_cold_cloud<N, F>(size, radius);
+        // A leaf is about 2 radius / cbrt(size / capacity) across
+        const auto speed = F{ 0.2 } * radius / std::cbrt(static_cast<F>(size / capacity));
+        auto       rng   = std::mt19937{ common::seed_mass };
+        auto       uniform    = std::uniform_real_distribution<F>(-speed, speed);
+        auto       velocities = std::vector<std::array<F, N>>(size);
+        for (auto& v : velocities)
+        {
+            for (auto& c : v)
+            {
+                c = uniform(rng);
+            }
+        }
+        // Wide enough for no particle to leave the root
+        const auto limits = tree_t::boundary_t(F{ -2 } * radius, F{ 2 } * radius);
+
+        const auto run = [&](bool refit) -> std::pair<double, double> {
+            auto particles = cloud;
+            auto tree = tree_t(std::execution::par, particles, depth, capacity, limits);
+            tree.cache_summary();
+            auto seconds = 0.0;
+            for (auto step = 0uz; step != steps; ++step)
+            {
+                for (auto stage = 0uz; stage != substages; ++stage)
+                {
+                    for (auto p_idx = 0uz; p_idx != size; ++p_idx)
+                    {
+                        for (auto i = 0uz; i != N; ++i)
+                        {
+                            particles[p_idx].position()[i] += velocities[p_idx][i];
+                        }
+                    }
+                    seconds += common::time_it([&] {
+                        if (refit && stage != 0)
+                        {
+                            tree.refit();
+                            return;
+                        }
+                        tree.reorganize();
+                        tree.regroup();
+                        tree.cache_summary();
+                    });
+                }
+            }
+            auto growth = 0.0;
+            auto leaves = 0uz;
+            extent_growth(tree.box(), growth, leaves);
+            return { 1e3 * seconds / steps, 1e2 * growth / static_cast<double>(leaves) };
+        };
+        const auto [reorganize_ms, ignored] = run(false);
+        const auto [refit_ms, growth]       = run(true);
+        std::cout << std::setw(12) << size << std::fixed << std::setprecision(2)
+                  << std::setw(20) << reorganize_ms << std::setw(16) << refit_ms
+                  << std::setw(18) << growth << std::defaultfloat << '\n';
+    }
+}
+
+} // namespace benchmarks
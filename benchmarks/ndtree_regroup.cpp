@@ -0,0 +1,139 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "particle.hpp"
+#include "simulation_config.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Traversal cost of a collapsing cloud over a long run, with and without regrouping the
+// empty boxes the collapse leaves behind.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+template <typename Box_Type>
+[[nodiscard]]
+auto empty_leaves(Box_Type const& b) -> std::size_t
+{
+    if (!b.fragmented())
+    {
+        return b.contained_elements().empty() ? 1uz : 0uz;
+    }
+    return std::ranges::fold_left(b.subboxes(), 0uz, [](auto acc, auto const& sb) {
+        return acc + empty_leaves(sb);
+    });
+}
+
+// Number of boxes a particle visits with the same opening criterion as the engine
+template <typename Box_Type, typename Particle_Type, typename F>
+[[nodiscard]]
+auto visited_boxes(Box_Type const& b, Particle_Type const& p, F theta_sq) -> std::size_t
+{
+    if (!b.summary().has_value() || b.summary().value().id() == p.id())
+    {
+        return 1;
+    }
+    const auto s = pm::utils::l2_norm_sq(b.diagonal_length().value());
+    const auto d = pm::utils::l2_norm_sq(
+        pm::utils::distance(p.position(), b.summary().value().position()).value()
+    );
+    if ((s / d) < theta_sq || !b.fragmented())
+    {
+        return 1;
+    }
+    return std::ranges::fold_left(
+        b.subboxes(),
+        1uz,
+        [&p, theta_sq](auto acc, auto const& sb) {
+            return acc + visited_boxes(sb, p, theta_sq);
+        }
+    );
+}
+
+} // namespace
+
+auto ndtree_regroup() -> void
+{
+    using F                       = double;
+    static constexpr auto N       = 3;
+    using particle_t              = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction    = pm::interaction::InteractionType::Gravitational;
+    constexpr auto size           = 1000uz;
+    constexpr auto steps          = 10'000uz;
+    constexpr auto report_every   = 1'000uz;
+    constexpr auto radius         = F{ 100 };
+    constexpr auto dt             = F{ 0.05 };
+    constexpr auto theta          = F{ 0.5 };
+    constexpr auto tree_max_depth = 10u;
+    constexpr auto tree_capacity  = 8uz;
+
+    common::print_header("ndtree regroup: collapsing cloud");
+    // Free fall time of the cloud is ~70 time units, a few crossing times fit in the run
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    const auto particles = common::generate_cold_cloud<N, F>(size, radius);
+
+    for (const auto regroup : { false, true })
+    {
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::duration<F>(dt),
+            .duration_       = std::chrono::duration<F>(dt * static_cast<F>(steps)),
+            .particle_count_ = size,
+            .sim_type_       = simulation::config::SimulationType::barnes_hut
+        };
+        simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+            .tree_max_depth_    = tree_max_depth,
+            .tree_box_capacity_ = tree_capacity,
+            .theta_             = theta,
+            .tree_regroup_      = regroup
+        };
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction> engine(
+            particles, base_config, bh_config
+        );
+
+        std::cout << "Regroup: " << std::boolalpha << regroup << std::noboolalpha << '\n';
+        std::cout << std::setw(8) << "step" << std::setw(10) << "boxes" << std::setw(14)
+                  << "empty leaves" << std::setw(16) << "visits/particle" << std::setw(16)
+                  << "f evals/step" << std::setw(12) << "ms/step" << '\n';
+        auto total_seconds = 0.0;
+        auto total_visits  = 0uz;
+        for (auto step = 0uz; step != steps; step += report_every)
+        {
+            const auto f_evals = engine.f_eval_count();
+            const auto seconds = common::time_it([&engine] {
+                for (auto k = 0uz; k != report_every; ++k)
+                {
+                    engine.step();
+                }
+            });
+            total_seconds += seconds;
+
+            auto const& tree   = engine.tree();
+            auto        visits = 0uz;
+            for (auto const& p : engine.current_system_state())
+            {
+                visits += visited_boxes(tree.box(), p, theta * theta);
+            }
+            total_visits += visits;
+            std::cout << std::setw(8) << step + report_every << std::setw(10)
+                      << tree.box().boxes() << std::setw(14) << empty_leaves(tree.box())
+                      << std::setw(16) << visits / size << std::setw(16)
+                      << (engine.f_eval_count() - f_evals) / report_every << std::setw(12)
+                      << std::fixed << std::setprecision(3)
+                      << 1e3 * seconds / static_cast<double>(report_every)
+                      << std::defaultfloat << std::endl;
+        }
+        std::cout << "Total: " << std::fixed << std::setprecision(2) << total_seconds
+                  << " s, mean visits/particle "
+                  << total_visits * report_every / (size * steps) << std::defaultfloat
+                  << "\n\n";
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,102 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "benchmarks.hpp"
+#include "ndtree.hpp"
+#include "particle.hpp"
+#include <algorithm>
+#include <execution>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+// Summary caching through the center of mass accumulator (and parallel subtrees) against
+// the previous recursive merge over copies of every sample and child summary, and the
+// partial update after one sample in a hundred is touched.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+// Previous implementation, the result is returned instead of cached
+template <typename Box_Type>
+[[nodiscard]]
+auto merge_by_copy(Box_Type const& b) -> std::optional<typename Box_Type::sample_t>
+{
+    if (b.fragmented())
+    {
+        auto summaries = std::vector<std::optional<typename Box_Type::sample_t>>{};
+        for (auto const& sb : b.subboxes())
+        {
+            summaries.push_back(merge_by_copy(sb));
+        }
+        return merge(
+            summaries | std::views::filter([](auto const& s) { return s.has_value(); }) |
+            std::views::transform([](auto const& s) { return s.value(); })
+        );
+    }
+    return merge(
+        b.contained_elements() | std::views::transform([](auto const* const e) {
+            return *e;
+        })
+    );
+}
+
+template <typename Fn>
+[[nodiscard]]
+auto best_of(std::size_t repetitions, Fn&& fn) -> double
+{
+    auto best = std::numeric_limits<double>::max();
+    for (auto i = 0uz; i != repetitions; ++i)
+    {
+        best = std::min(best, common::time_it(fn));
+    }
+    return best;
+}
+
+} // namespace
+
+auto ndtree_summary() -> void
+{
+    using F                 = double;
+    static constexpr auto N = 3;
+    using particle_t        = pm::particle::ndparticle<N, F>;
+    using tree_t            = ndt::ndtree<2, particle_t>;
+    constexpr auto radius   = F{ 100 };
+    constexpr auto depth    = 16u;
+    constexpr auto capacity = 8uz;
+    constexpr auto repeats  = 5uz;
+
+    common::print_header("ndtree summary: accumulator against merge by copy");
+    std::cout << std::setw(12) << "particles" << std::setw(12) << "boxes"
+              << std::setw(18) << "merge copy ms" << std::setw(18) << "accumulator ms"
+              << std::setw(18) << "1% dirty ms" << '\n';
+    for (const auto size : { 100'000uz, 1'000'000uz })
+    {
+        auto particles = common::generate_cold_cloud<N, F>(size, radius);
+        auto tree      = tree_t(std::execution::par, particles, depth, capacity);
+
+        auto       reference = std::optional<particle_t>{};
+        const auto by_copy   = best_of(repeats, [&] {
+            reference = merge_by_copy(tree.box());
+        });
+        const auto cached  = best_of(repeats, [&] { tree.cache_summary(); });
+        const auto partial = best_of(repeats, [&] {
+            for (auto p_idx = 0uz; p_idx < size; p_idx += 100)
+            {
+                tree.touch(&particles[p_idx]);
+            }
+            tree.update_summary();
+        });
+        std::cout << std::setw(12) << size << std::setw(12) << tree.box().boxes()
+                  << std::fixed << std::setprecision(2) << std::setw(18) << 1e3 * by_copy
+                  << std::setw(18) << 1e3 * cached << std::setw(18) << 1e3 * partial
+                  << std::defaultfloat << '\n';
+    }
+}
+
+} // namespace benchmarks
@@ -0,0 +1,215 @@
+#undef USE_ROOT_PLOTTING
+#include "benchmarks.hpp"
+#include "particle.hpp"
+#include "particle_storage.hpp"
+#include "yoshida.hpp"
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The kick and drift loops of the Yoshida solver, through the per particle accessors and
+// through the bulk interface. The system hands out stored accelerations that are all
+// zero, so a step is nothing else.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+template <typename Particle_Type, bool Bulk>
+class free_system
+{
+public:
+    using particle_t     = Particle_Type;
+    using value_type     = typename particle_t::value_type;
+    using position_t     = typename particle_t::position_t;
+    using velocity_t     = typename particle_t::velocity_t;
+    using acceleration_t = typename particle_t::acceleration_t;
+    using solver_t       = solvers::yoshida4_solver<free_system, particle_t>;
+    inline static constexpr auto s_dimension      = particle_t::s_dimension;
+    inline static constexpr auto s_working_copies = solver_t::s_working_copies;
+    using storage_t = storage::soa_storage<particle_t, s_working_copies + 1>;
+
+    free_system(
+        std::vector<particle_t> const&    particles,
+        std::chrono::duration<value_type> dt
+    ) :
+        m_particles{ particles },
+        m_accelerations(m_particles.size()),
+        m_solver(this, m_particles.size(), dt)
+    {
+        for (auto& component : m_components)
+        {
+            component.assign(m_particles.size(), value_type{ 0 });
+        }
+    }
+
+    auto step() -> void
+    {
+        m_solver.run();
+    }
+
+    auto commit_buffer(std::size_t) noexcept -> void
+    {
+    }
+
+    [[nodiscard]]
+    auto get_acceleration(std::size_t, std::size_t p_idx) const noexcept
+        -> acceleration_t
+    {
+        return m_accelerations[p_idx];
+    }
+
+    [[nodiscard]]
+    auto position_read(std::size_t p_idx) const noexcept -> position_t
+    {
+        return m_particles.position(s_working_copies, p_idx);
+    }
+
+    auto position_write(std::size_t p_idx, position_t value) noexcept -> void
+    {
+        m_particles.set_position(s_working_copies, p_idx, value);
+    }
+
+    [[nodiscard]]
+    auto position_buffer_read(std::size_t buffer_id, std::size_t p_idx) const noexcept
+        -> position_t
+    {
+        return m_particles.position(buffer_id, p_idx);
+    }
+
+    auto position_buffer_write(
+        std::size_t       buffer_id,
+        std::size_t       p_idx,
+        position_t const& value
+    ) noexcept -> void
+    {
+        m_particles.set_position(buffer_id, p_idx, value);
+    }
+
+    [[nodiscard]]
+    auto velocity_read(std::size_t p_idx) const noexcept -> velocity_t
+    {
+        return m_particles.velocity(s_working_copies, p_idx);
+    }
+
+    auto velocity_write(std::size_t p_idx, velocity_t value) noexcept -> void
+    {
+        m_particles.set_velocity(s_working_copies, p_idx, value);
+    }
+
+    [[nodiscard]]
+    auto velocity_buffer_read(std::size_t buffer_id, std::size_t p_idx) const noexcept
+        -> velocity_t
+    {
+        return m_particles.velocity(buffer_id, p_idx);
+    }
+
+    auto velocity_buffer_write(
+        std::size_t       buffer_id,
+        std::size_t       p_idx,
+        velocity_t const& value
+    ) noexcept -> void
+    {
+        m_particles.set_velocity(buffer_id, p_idx, value);
+    }
+
+    [[nodiscard]]
+    auto positions(std::size_t copy) noexcept -> decltype(auto)
+        requires Bulk
+    {
+        return m_particles.positions(copy);
+    }
+
+    [[nodiscard]]
+    auto positions(std::size_t copy) const noexcept -> decltype(auto)
+        requires Bulk
+    {
+        return m_particles.positions(copy);
+    }
+
+    [[nodiscard]]
+    auto velocities(std::size_t copy) noexcept -> decltype(auto)
+        requires Bulk
+    {
+        return m_particles.velocities(copy);
+    }
+
+    [[nodiscard]]
+    auto velocities(std::size_t copy) const noexcept -> decltype(auto)
+        requires Bulk
+    {
+        return m_particles.velocities(copy);
+    }
+
+    [[nodiscard]]
+    auto accelerations(std::size_t) const noexcept
+        -> std::array<std::span<value_type const>, s_dimension>
+        requires Bulk
+    {
+        auto ret = std::array<std::span<value_type const>, s_dimension>{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = m_components[i];
+        }
+        return ret;
+    }
+
+private:
+    storage_t                                        m_particles;
+    std::vector<acceleration_t>                      m_accelerations;
+    std::array<std::vector<value_type>, s_dimension> m_components;
+    solver_t                                         m_solver;
+};
+
+template <typename System, typename Particle_Type>
+auto report(
+    std::string_view                  name,
+    std::vector<Particle_Type> const& particles,
+    std::size_t                       steps
+) -> void
+{
+    using F     = typename Particle_Type::value_type;
+    auto system = System(particles, std::chrono::duration<F>(1));
+    system.step();
+    const auto seconds = common::time_it([&] {
+        for (auto i = 0uz; i != steps; ++i)
+        {
+            system.step();
+        }
+    });
+    const auto per_step = seconds / static_cast<double>(steps);
+    std::cout << std::setw(12) << std::ranges::size(particles) << std::setw(14) << name
+              << std::fixed << std::setprecision(1) << std::setw(14) << 1e3 * per_step
+              << std::setw(16)
+              << 1e9 * per_step / static_cast<double>(std::ranges::size(particles))
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+} // namespace
+
+auto solver_loops() -> void
+{
+    using F                 = double;
+    static constexpr auto N = 3;
+    using particle_t        = pm::particle::ndparticle<N, F>;
+
+    common::print_header("solver loops: per particle against bulk");
+    std::cout << std::setw(12) << "particles" << std::setw(14) << "interface"
+              << std::setw(14) << "step ms" << std::setw(16) << "ns/particle" << '\n';
+    for (const auto& [size, steps] : { std::pair{ 10'000uz, 2000uz },
+                                       std::pair{ 1'000'000uz, 20uz } })
+    {
+        const auto particles = common::generate_cold_cloud<N, F>(size, F{ 100 });
+        report<free_system<particle_t, false>>("per particle", particles, steps);
+        report<free_system<particle_t, true>>("bulk", particles, steps);
+    }
+}
+
+} // namespace benchmarks
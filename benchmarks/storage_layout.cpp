@@ -0,0 +1,95 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "brute_force.hpp"
+#include "particle.hpp"
+#include "particle_storage.hpp"
+#include "simulation_config.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+// One integration step of the brute force and the Barnes-Hut engines with the array of
+// structures and the structure of arrays particle storage.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+auto report(std::string_view engine, std::string_view layout, double time) -> void
+{
+    std::cout << std::setw(14) << engine << std::setw(10) << layout << std::fixed
+              << std::setprecision(1) << std::setw(14) << 1e3 * time
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+} // namespace
+
+auto storage_layout() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using tree_t               = ndt::ndtree<2, particle_t>;
+    constexpr auto radius      = F{ 100 };
+
+    common::print_header("storage layout: aos against soa");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    std::cout << std::setw(14) << "engine" << std::setw(10) << "layout" << std::setw(14)
+              << "step ms" << '\n';
+    {
+        constexpr auto size      = 20'000uz;
+        const auto     particles = common::generate_cold_cloud<N, F>(size, radius);
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::duration<F>(1),
+            .duration_       = std::chrono::duration<F>(1),
+            .particle_count_ = size,
+            .sim_type_       = simulation::config::SimulationType::brute_force
+        };
+        auto aos = simulation::bf::brute_force_computation<particle_t, interaction>(
+            particles, base_config
+        );
+        report("brute force", "aos", common::time_it([&] { aos.run(); }));
+        auto soa = simulation::bf::
+            brute_force_computation<particle_t, interaction, storage::soa_storage>(
+                particles, base_config
+            );
+        report("brute force", "soa", common::time_it([&] { soa.run(); }));
+    }
+    {
+        constexpr auto size      = 100'000uz;
+        const auto     particles = common::generate_cold_cloud<N, F>(size, radius);
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::duration<F>(1),
+            .duration_       = std::chrono::duration<F>(1),
+            .particle_count_ = size,
+            .sim_type_       = simulation::config::SimulationType::barnes_hut
+        };
+        simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+            .tree_max_depth_    = 16,
+            .tree_box_capacity_ = 16,
+            .theta_             = F{ 0.5 },
+            .traversal_         = simulation::config::TraversalType::group
+        };
+        auto aos = simulation::bh_approx::barnes_hut_approximation<
+            particle_t,
+            interaction,
+            2,
+            tree_t,
+            storage::aos_storage>(particles, base_config, bh_config);
+        report("barnes hut", "aos", common::time_it([&] { aos.run(); }));
+        auto soa =
+            simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>(
+                particles, base_config, bh_config
+            );
+        report("barnes hut", "soa", common::time_it([&] { soa.run(); }));
+    }
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,98 @@
+#undef USE_ROOT_PLOTTING
+#undef DEBUG_NDTREE
+#include "barnes_hut_approximation.hpp"
+#include "benchmarks.hpp"
+#include "fast_multipole_method.hpp"
+#include "particle.hpp"
+#include "particle_storage.hpp"
+#include "simulation_config.hpp"
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <string_view>
+#include <utility>
+
+// Heap held by the engines once their first working copy is committed: the working
+// copies, the tree and the traversal state. Read from the glibc allocator statistics.
+
+namespace benchmarks
+{
+
+namespace
+{
+
+[[nodiscard]]
+auto allocated_bytes() -> std::size_t
+{
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+template <typename Make_Engine>
+auto report(std::string_view engine, std::size_t size, Make_Engine&& make_engine) -> void
+{
+    const auto before = allocated_bytes();
+    auto       sim    = std::forward<Make_Engine>(make_engine)();
+    sim.commit_buffer(0);
+    const auto bytes = static_cast<double>(allocated_bytes() - before);
+    std::cout << std::setw(18) << engine << std::setw(12) << size << std::fixed
+              << std::setprecision(1) << std::setw(12) << bytes / 1e6 << std::setw(18)
+              << bytes / static_cast<double>(size) << std::defaultfloat
+              << std::setprecision(6) << std::endl;
+}
+
+} // namespace
+
+auto working_memory() -> void
+{
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = pm::particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using tree_t               = ndt::ndtree<2, particle_t>;
+    constexpr auto size        = 1'000'000uz;
+
+    common::print_header("working memory: heap per particle");
+    pm::physical_parameters<F>::set_gravitational_constant(F{ 1 });
+    std::cout << std::setw(18) << "engine" << std::setw(12) << "particles"
+              << std::setw(12) << "MB" << std::setw(18) << "bytes/particle" << '\n';
+    const auto particles = common::generate_cold_cloud<N, F>(size, F{ 100 });
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::duration<F>(1),
+        .duration_       = std::chrono::duration<F>(1),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_    = 16,
+        .tree_box_capacity_ = 16,
+        .theta_             = F{ 0.5 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+    report("barnes hut aos", size, [&] {
+        return simulation::bh_approx::barnes_hut_approximation<
+            particle_t,
+            interaction,
+            2,
+            tree_t,
+            storage::aos_storage>(particles, base_config, bh_config);
+    });
+    report("barnes hut soa", size, [&] {
+        return simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>(
+            particles, base_config, bh_config
+        );
+    });
+    simulation::config::fmm_specific_config<particle_t> fmm_config{
+        .tree_max_depth_ = 16, .tree_box_capacity_ = 32, .theta_ = F{ 0.5 }
+    };
+    report("fmm", size, [&] {
+        return simulation::fmm::fast_multipole_method<particle_t, interaction>(
+            particles, base_config, fmm_config
+        );
+    });
+    pm::physical_parameters<F>::reset();
+}
+
+} // namespace benchmarks
@@ -0,0 +1,577 @@
+#pragma once
+
+#include "ndtree.hpp"
+#include "space_filling_curve.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ndt
+{
+
+// Pointer-free alternative to ndtree. Samples are sorted by their Morton (Z-order) key
+// and the boxes are emitted into a flat array, siblings next to each other and every box
+// after its parent, so each box owns a contiguous range of the sorted samples. The tree
+// is rebuilt from scratch on reorganize, which is sort-bound and reuses all its buffers.
+// Only binary subdivisions are supported, as those are the ones a Morton key encodes.
+
+template <concepts::sample_concept Sample_Type>
+class linear_ndbox
+{
+public:
+    using sample_t                              = Sample_Type;
+    using point_t                               = typename sample_t::position_t;
+    using box_t                                 = linear_ndbox<sample_t>;
+    inline static constexpr auto s_dimension    = point_t::s_dimension;
+    using value_type                            = typename sample_t::value_type;
+    using boundary_t                            = ndboundary<point_t>;
+    using depth_t                               = unsigned int;
+    using size_type                             = std::size_t;
+    inline static constexpr auto s_fanout       = 2uz;
+    inline static constexpr auto s_subdivisions = 1uz << s_dimension;
+    inline static constexpr auto s_boundary_tol = value_type{ 1e-4 };
+    using quadrupole_t                          = detail::quadrupole_t<sample_t>;
+    using narrow_summary_t                      = detail::narrow_summary_t<sample_t>;
+    using limits_t                              = detail::limits_accumulator<point_t>;
+
+    template <std::size_t, concepts::sample_concept>
+    friend class linear_ndtree;
+
+public:
+    linear_ndbox(
+        boundary_t boundary,
+        size_type  first_element,
+        size_type  element_count,
+        depth_t    depth
+    ) noexcept :
+        m_boundary{ boundary },
+        m_extent{ boundary },
+        m_first_element{ first_element },
+        m_element_count{ element_count },
+        m_depth{ depth }
+    {
+    }
+
+    [[nodiscard]]
+    inline auto fragmented() const noexcept -> bool
+    {
+        return m_subbox_count != 0;
+    }
+
+    [[nodiscard]]
+    auto summary() const noexcept -> std::optional<sample_t> const&
+    {
+        return m_summary;
+    }
+
+    // Cached by cache_summary(MultipoleOrder::quadrupole), about the summary position
+    [[nodiscard]]
+    auto quadrupole() const noexcept -> std::optional<quadrupole_t> const&
+        requires concepts::multipole_sample<sample_t>
+    {
+        return m_quadrupole;
+    }
+
+    // The summary position and mass in the narrower type of the sample, cached along
+    // with the summary
+    [[nodiscard]]
+    auto narrow_summary() const noexcept -> std::optional<narrow_summary_t> const&
+        requires concepts::narrowable_sample<sample_t>
+    {
+        return m_narrow_summary;
+    }
+
+    // Of the extent, the boundary grown by any sample refit left outside of it
+    [[nodiscard]]
+    auto diagonal_length() const noexcept -> auto
+    {
+        return m_extent.diagonal_length();
+    }
+
+    [[nodiscard]]
+    auto extent() const noexcept -> boundary_t const&
+    {
+        return m_extent;
+    }
+
+    // Tight bounds of the samples, as of the last summary. None for empty boxes.
+    [[nodiscard]]
+    auto sample_bounds() const noexcept -> std::optional<boundary_t> const&
+    {
+        return m_bounds;
+    }
+
+    [[nodiscard]]
+    auto boundary() const noexcept -> boundary_t const&
+    {
+        return m_boundary;
+    }
+
+    // Only the non-empty subdivisions are stored, in Morton order
+    [[nodiscard]]
+    auto subboxes() const noexcept -> std::span<box_t const>
+    {
+        assert(fragmented());
+        return m_subboxes;
+    }
+
+    [[nodiscard]]
+    auto contained_elements() const noexcept -> std::span<sample_t const* const>
+    {
+        assert(!fragmented());
+        return m_elements;
+    }
+
+    [[nodiscard]]
+    auto boxes() const -> std::size_t
+    {
+        return fragmented() ? std::ranges::fold_left(
+                                  subboxes(),
+                                  std::ranges::size(subboxes()),
+                                  [](auto acc, const auto& b) { return acc + b.boxes(); }
+                              )
+                            : 0;
+    }
+
+    [[nodiscard]]
+    auto elements() const noexcept -> std::size_t
+    {
+        return m_element_count;
+    }
+
+    auto print_info(std::ostream& os) const -> void
+    {
+        static auto header = [](auto depth) { return std::string(depth, '\t'); };
+        os << header(m_depth) << "<linear_ndbox<" << s_dimension << ">>\n ";
+        os << header(m_depth + 1) << "Boundary: " << m_boundary << '\n';
+        os << header(m_depth + 1) << "Depth " << m_depth << '\n';
+        os << header(m_depth + 1) << "Fragmented: " << fragmented() << '\n';
+        os << header(m_depth + 1) << "Boxes: " << boxes() << '\n';
+        if (summary().has_value())
+        {
+            os << header(m_depth + 1) << "Summary: " << summary().value().repr() << '\n';
+        }
+        os << header(m_depth + 1) << "Elements: " << elements() << '\n';
+        if (!fragmented())
+        {
+            for (auto const* const e : contained_elements())
+            {
+                os << header(m_depth + 1) << e->repr() << '\n';
+            }
+        }
+        else
+        {
+            for (auto const& b : subboxes())
+            {
+                b.print_info(os);
+            }
+        }
+        os << header(m_depth) << "<\\linear_ndbox<" << s_dimension << ">>\n";
+    }
+
+private:
+    // The sub-boxes have to be summarized already
+    auto cache_summary(MultipoleOrder order) noexcept -> void
+    {
+        m_extent    = m_boundary;
+        auto limits = limits_t{};
+        if (fragmented())
+        {
+            m_summary = detail::summarize<sample_t>(
+                subboxes() |
+                std::views::transform([](auto const& b) -> sample_t const& {
+                    return b.summary().value();
+                })
+            );
+            for (auto const& b : subboxes())
+            {
+                limits.add(b.m_bounds.value());
+            }
+        }
+        else
+        {
+            m_summary = detail::summarize<sample_t>(
+                contained_elements() |
+                std::views::transform([](auto const* const e) -> sample_t const& {
+                    return *e;
+                })
+            );
+            for (auto const* const e : contained_elements())
+            {
+                limits.add(e->position());
+            }
+        }
+        m_bounds = limits.result();
+        if constexpr (concepts::narrowable_sample<sample_t>)
+        {
+            m_narrow_summary = m_summary.transform([](sample_t const& s) {
+                return narrow_monopole(s);
+            });
+        }
+        m_quadrupole.reset();
+        if constexpr (concepts::multipole_sample<sample_t>)
+        {
+            if (order != MultipoleOrder::quadrupole || !m_summary.has_value())
+            {
+                return;
+            }
+            auto const& center = m_summary.value().position();
+            if (fragmented())
+            {
+                m_quadrupole =
+                    detail::summarize_subbox_quadrupoles<sample_t>(center, subboxes());
+            }
+            else
+            {
+                m_quadrupole = detail::summarize_quadrupole<sample_t>(
+                    center,
+                    contained_elements() |
+                        std::views::transform([](auto const* const e) -> sample_t const& {
+                            return *e;
+                        })
+                );
+            }
+        }
+    }
+
+    // Grows the extent to take in the samples, the box has to be summarized already
+    auto fit() noexcept -> void
+    {
+        if (m_bounds.has_value())
+        {
+            m_extent.extend(m_bounds.value());
+        }
+    }
+
+private:
+    boundary_t                       m_boundary;
+    boundary_t                       m_extent; // Of the samples, see refit
+    std::optional<boundary_t>        m_bounds{};
+    std::optional<sample_t>          m_summary{};
+    std::optional<quadrupole_t>      m_quadrupole{};
+    std::optional<narrow_summary_t>  m_narrow_summary{};
+    std::span<box_t const>           m_subboxes{};
+    std::span<sample_t const* const> m_elements{};
+    size_type                        m_first_element;
+    size_type                        m_element_count;
+    size_type                        m_first_subbox = 0;
+    size_type                        m_subbox_count = 0;
+    depth_t                          m_depth;
+};
+
+template <std::size_t Fanout, concepts::sample_concept Sample_Type>
+class linear_ndtree
+{
+    static_assert(Fanout == 2, "Morton keys only encode binary subdivisions");
+    static_assert(
+        Sample_Type::position_t::s_dimension > 0 &&
+            Sample_Type::position_t::s_dimension < 64,
+        "At least one subdivision level has to fit in a 64 bit key"
+    );
+
+public:
+    using sample_t                              = Sample_Type;
+    using position_t                            = typename sample_t::position_t;
+    using value_type                            = typename sample_t::value_type;
+    using size_type                             = std::size_t;
+    inline static constexpr auto s_dimension    = sample_t::s_dimension;
+    using box_t                                 = linear_ndbox<sample_t>;
+    using depth_t                               = typename box_t::depth_t;
+    using point_t                               = typename sample_t::position_t;
+    using boundary_t                            = ndboundary<point_t>;
+    using key_t                                 = std::uint64_t;
+    using keyed_t                               = detail::morton_keyed<sample_t const*>;
+    inline static constexpr auto s_fanout       = box_t::s_fanout;
+    inline static constexpr auto s_subdivisions = box_t::s_subdivisions;
+    // Levels of subdivision a 64 bit key can encode
+    inline static constexpr auto s_key_levels =
+        static_cast<depth_t>(std::numeric_limits<key_t>::digits / s_dimension);
+    inline static constexpr auto s_key_bits = s_key_levels * s_dimension;
+    // Levels the root may grow by, in total, before it is taken again from the bounds of
+    // the samples, as in ndtree
+    inline static constexpr auto s_max_growth = std::size_t{ 4 };
+
+public:
+    linear_ndtree(
+        std::span<sample_t>       collection,
+        depth_t const             max_depth,
+        size_type const           box_capacity,
+        std::optional<boundary_t> limits = std::nullopt
+    ) :
+        m_data_view{ collection },
+        m_boundary{ limits.has_value() ? limits.value()
+                                       : detail::compute_limits(collection) },
+        m_max_depth{ std::min(max_depth, s_key_levels) },
+        m_base_depth{ m_max_depth },
+        m_capacity{ box_capacity }
+    {
+        assert(m_capacity > 0);
+        build();
+    }
+
+    // Boxes refer to the buffers of the tree, which survive a move but not a copy
+    linear_ndtree(linear_ndtree const&)                    = delete;
+    linear_ndtree(linear_ndtree&&)                         = default;
+    auto operator=(linear_ndtree const&) -> linear_ndtree& = delete;
+    auto operator=(linear_ndtree&&) -> linear_ndtree&      = default;
+
+    // Positions changed, sort and emit the boxes again
+    auto reorganize() noexcept -> void
+    {
+        build();
+    }
+
+    // A rebuilt tree has no empty or underfull boxes left to collapse
+    auto regroup() noexcept -> void
+    {
+    }
+
+    // Every box is stored after its parent, so a reverse sweep sees the children first
+    auto cache_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        for (auto& b : m_boxes | std::views::reverse)
+        {
+            b.cache_summary(order);
+        }
+    }
+
+    // Every reorganize rebuilds the boxes, none of them keeps a summary to skip
+    auto update_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        cache_summary(order);
+    }
+
+    auto touch(sample_t const*) noexcept -> void
+    {
+    }
+
+    // Summarizes the boxes again over the samples they hold, without sorting them again
+    auto refit(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        for (auto& b : m_boxes | std::views::reverse)
+        {
+            b.cache_summary(order);
+            b.fit();
+        }
+    }
+
+    // After the samples were permuted in the collection, remap(sp) being the new address
+    // of the sample at sp. Boxes and summaries stay as they are, the samples of every
+    // box are only found at their new addresses.
+    template <typename Remap_Fn>
+    auto rebind(Remap_Fn const& remap) noexcept -> void
+    {
+        for (auto& e : m_sorted)
+        {
+            e = remap(e);
+        }
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> size_type
+    {
+        return std::ranges::size(m_data_view);
+    }
+
+    auto print_info(std::ostream& os = std::cout) const -> void
+    {
+        os << "<linear_ndtree <" << s_fanout << ", " << s_dimension << ">>\n";
+        os << "Capacity: " << m_capacity << '\n';
+        os << "Max depth: " << m_max_depth << '\n';
+        os << "Elements: " << box().elements() << " out of "
+           << std::ranges::size(m_data_view) << '\n';
+        if (box().summary().has_value())
+        {
+            os << "Summary: " << box().summary().value().repr() << '\n';
+        }
+        os << "<\\linear_ndtree<" << s_fanout << ", " << s_dimension << ">>\n";
+    }
+
+    [[nodiscard]]
+    auto box() const noexcept -> box_t const&
+    {
+        return m_boxes.front();
+    }
+
+    // Boxes in storage order, the root first
+    [[nodiscard]]
+    auto boxes() const noexcept -> std::span<box_t const>
+    {
+        return m_boxes;
+    }
+
+    // Samples in Morton order, every box owns a contiguous range of them
+    [[nodiscard]]
+    auto sorted_elements() const noexcept -> std::span<sample_t const* const>
+    {
+        return m_sorted;
+    }
+
+private:
+    auto build() noexcept -> void
+    {
+        // Samples that left the root grow it, as in ndtree. Growing towards the two
+        // corners of the bounds of the finite ones takes all of them in, and those that
+        // are not finite are left out.
+        const auto limits =
+            detail::compute_finite_limits(std::execution::par, m_data_view);
+        if (limits.has_value())
+        {
+            for (auto const& corner : { limits->min(), limits->max() })
+            {
+                // Within the tolerance the root already takes the corner in
+                if (detail::in(corner, m_boundary, box_t::s_boundary_tol))
+                {
+                    continue;
+                }
+                const auto growth = detail::growth_towards<s_fanout, s_max_growth>(
+                    m_boundary, corner
+                );
+                if (m_growth + growth > s_max_growth)
+                {
+                    m_boundary  = limits.value();
+                    m_growth    = 0;
+                    m_max_depth = m_base_depth;
+                    break;
+                }
+                for (auto i = 0uz; i != growth; ++i)
+                {
+                    m_boundary = detail::grow_towards<s_fanout>(m_boundary, corner).first;
+                }
+                m_growth    += growth;
+                m_max_depth  = static_cast<depth_t>(
+                    std::min(m_base_depth + m_growth, std::size_t{ s_key_levels })
+                );
+            }
+        }
+        m_keyed.clear();
+        for (auto const& e : m_data_view)
+        {
+            // Only those the root could not grow to are left out
+            if (detail::in(e.position(), m_boundary, box_t::s_boundary_tol))
+            {
+                m_keyed.push_back({ morton_key(e.position()), &e });
+            }
+        }
+        detail::radix_sort<s_key_bits>(m_keyed, m_scratch);
+
+        m_sorted.resize(std::ranges::size(m_keyed));
+        std::ranges::transform(m_keyed, std::ranges::begin(m_sorted), &keyed_t::value);
+
+        m_boxes.clear();
+        m_boxes.emplace_back(m_boundary, 0uz, std::ranges::size(m_sorted), depth_t{ 0 });
+        subdivide(0);
+
+        // Storage does not move anymore, resolve the indices into views
+        for (auto& b : m_boxes)
+        {
+            b.m_subboxes =
+                std::span<box_t const>{ m_boxes.data() + b.m_first_subbox,
+                                        b.m_subbox_count };
+            b.m_elements = std::span<sample_t const* const>{
+                m_sorted.data() + b.m_first_element, b.m_element_count
+            };
+        }
+    }
+
+    // Emits the non-empty children of the box next to each other, then recurses
+    auto subdivide(size_type const box_idx) noexcept -> void
+    {
+        const auto depth = m_boxes[box_idx].m_depth;
+        const auto count = m_boxes[box_idx].m_element_count;
+        if (count <= m_capacity || depth == m_max_depth)
+        {
+            return;
+        }
+        const auto shift = (s_key_levels - 1 - depth) * s_dimension;
+        const auto digit = [shift](keyed_t const& e) -> key_t {
+            return (e.key >> shift) & (s_subdivisions - 1);
+        };
+        const auto first_subbox = std::ranges::size(m_boxes);
+        const auto first        = m_boxes[box_idx].m_first_element;
+        const auto last         = std::ranges::begin(m_keyed) +
+                          static_cast<std::ptrdiff_t>(first + count);
+        for (auto it = std::ranges::begin(m_keyed) + static_cast<std::ptrdiff_t>(first);
+             it != last;)
+        {
+            const auto d    = digit(*it);
+            const auto next = std::ranges::partition_point(
+                it, last, [&digit, d](auto const& e) { return digit(e) == d; }
+            );
+            m_boxes.emplace_back(
+                subdivision(m_boxes[box_idx].m_boundary, d),
+                static_cast<size_type>(it - std::ranges::begin(m_keyed)),
+                static_cast<size_type>(next - it),
+                depth + 1
+            );
+            it = next;
+        }
+        m_boxes[box_idx].m_first_subbox = first_subbox;
+        m_boxes[box_idx].m_subbox_count = std::ranges::size(m_boxes) - first_subbox;
+        for (auto i = first_subbox; i != first_subbox + m_boxes[box_idx].m_subbox_count;
+             ++i)
+        {
+            subdivide(i);
+        }
+    }
+
+    // Same layout as ndbox: bit i of the index selects the top half of dimension i
+    [[nodiscard]]
+    static auto subdivision(boundary_t const& b, key_t const idx) noexcept -> boundary_t
+    {
+        point_t min;
+        point_t max;
+        for (auto i = decltype(s_dimension){ 0 }; i != s_dimension; ++i)
+        {
+            const auto top_half = (idx & (key_t{ 1 } << i)) != 0;
+            min[i]              = top_half ? b.mid(i) : b.min(i);
+            max[i]              = top_half ? b.max(i) : b.mid(i);
+        }
+        return boundary_t{ min, max };
+    }
+
+    [[nodiscard]]
+    auto morton_key(point_t const& p) const noexcept -> key_t
+    {
+        return sfc::morton_key<s_key_levels, s_dimension>(
+            sfc::cells<s_key_levels>(p, m_boundary)
+        );
+    }
+
+private:
+    std::span<sample_t>          m_data_view;
+    boundary_t                   m_boundary;
+    depth_t                      m_max_depth;
+    depth_t                      m_base_depth; // Before the root grew
+    // Levels the root grew by since it was taken from the bounds of the samples
+    std::size_t                  m_growth = 0;
+    size_type                    m_capacity;
+    std::vector<keyed_t>         m_keyed;
+    std::vector<keyed_t>         m_scratch;
+    std::vector<sample_t const*> m_sorted;
+    std::vector<box_t>           m_boxes;
+};
+
+template <std::size_t Fanout, concepts::sample_concept Sample_Type>
+auto operator<<(std::ostream& os, linear_ndtree<Fanout, Sample_Type> const& tree)
+    -> std::ostream&
+{
+    tree.print_info(os);
+    tree.box().print_info(os);
+    return os;
+}
+
+} // namespace ndt
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <tbb/spin_mutex.h>
+#include <utility>
+#include <vector>
+
+namespace ndt
+{
+
+// Per-tree pool for ndbox storage. All the subdivisions of a box are handed out at once
+// as a single aligned block, and leaf element buffers keep their capacity when they are
+// returned, so a tree in steady state does not need to touch the heap.
+template <typename Box_Type, typename Element_Type, std::size_t Block_Size>
+class ndbox_arena
+{
+public:
+    using box_t                                   = Box_Type;
+    using element_t                               = Element_Type;
+    using element_buffer_t                        = std::vector<element_t>;
+    using size_type                               = std::size_t;
+    inline static constexpr auto s_block_size     = Block_Size;
+    inline static constexpr auto s_cache_line     = std::size_t{ 64 };
+    inline static constexpr auto s_min_chunk_size = size_type{ 8 };
+
+public:
+    explicit ndbox_arena(size_type element_buffer_capacity) noexcept :
+        m_buffer_capacity{ element_buffer_capacity }
+    {
+    }
+
+    ndbox_arena(ndbox_arena const&)                    = delete;
+    ndbox_arena(ndbox_arena&&)                         = delete;
+    auto operator=(ndbox_arena const&) -> ndbox_arena& = delete;
+    auto operator=(ndbox_arena&&) -> ndbox_arena&      = delete;
+
+    // Boxes must have been destroyed by their owner before the arena goes away
+    ~ndbox_arena() noexcept
+    {
+        assert(blocks_in_use() == 0);
+    }
+
+    // Returns uninitialized storage for s_block_size contiguous boxes
+    [[nodiscard]]
+    auto acquire_block() noexcept -> box_t*
+    {
+        if (m_free_blocks.empty())
+        {
+            refill(1, 0);
+        }
+        auto* const block = m_free_blocks.back();
+        m_free_blocks.pop_back();
+        m_peak_blocks = std::max(m_peak_blocks, blocks_in_use());
+        return block;
+    }
+
+    // The boxes in the block must already be destroyed
+    auto release_block(box_t* const block) noexcept -> void
+    {
+        assert(block != nullptr);
+        m_free_blocks.push_back(block);
+    }
+
+    [[nodiscard]]
+    auto acquire_element_buffer() noexcept -> element_buffer_t
+    {
+        if (m_free_buffers.empty())
+        {
+            refill(0, 1);
+        }
+        auto buffer = std::move(m_free_buffers.back());
+        m_free_buffers.pop_back();
+        m_peak_buffers = std::max(m_peak_buffers, element_buffers_in_use());
+        return buffer;
+    }
+
+    auto release_element_buffer(element_buffer_t&& buffer) noexcept -> void
+    {
+        if (buffer.capacity() == 0)
+        {
+            return;
+        }
+        buffer.clear();
+        m_free_buffers.push_back(std::move(buffer));
+    }
+
+    // Hands blocks and buffers free here to another arena. The blocks stay in the chunks
+    // of this arena, so the other one has to be adopted before this one goes away.
+    auto lend(ndbox_arena& other, size_type blocks, size_type buffers) noexcept -> void
+    {
+        assert(this != &other);
+        assert(blocks <= std::ranges::size(m_free_blocks));
+        assert(buffers <= std::ranges::size(m_free_buffers));
+        const auto first_block =
+            std::ranges::end(m_free_blocks) - static_cast<std::ptrdiff_t>(blocks);
+        const auto first_buffer =
+            std::ranges::end(m_free_buffers) - static_cast<std::ptrdiff_t>(buffers);
+        std::ranges::copy(
+            first_block,
+            std::ranges::end(m_free_blocks),
+            std::back_inserter(other.m_free_blocks)
+        );
+        std::ranges::move(
+            first_buffer,
+            std::ranges::end(m_free_buffers),
+            std::back_inserter(other.m_free_buffers)
+        );
+        m_free_blocks.erase(first_block, std::ranges::end(m_free_blocks));
+        m_free_buffers.erase(first_buffer, std::ranges::end(m_free_buffers));
+        m_allocated_blocks        -= blocks;
+        m_allocated_buffers       -= buffers;
+        other.m_allocated_blocks  += blocks;
+        other.m_allocated_buffers += buffers;
+    }
+
+    // Takes over all the storage of another arena. Blocks and buffers it handed out stay
+    // valid, they just have to be released to this arena from now on.
+    auto adopt(ndbox_arena& other) noexcept -> void
+    {
+        assert(this != &other);
+        std::ranges::move(other.m_chunks, std::back_inserter(m_chunks));
+        std::ranges::copy(other.m_free_blocks, std::back_inserter(m_free_blocks));
+        std::ranges::move(other.m_free_buffers, std::back_inserter(m_free_buffers));
+        m_allocated_blocks  += std::exchange(other.m_allocated_blocks, 0);
+        m_allocated_buffers += std::exchange(other.m_allocated_buffers, 0);
+        other.m_chunks.clear();
+        other.m_free_blocks.clear();
+        other.m_free_buffers.clear();
+    }
+
+    // One arena per box of a block, for subtrees built concurrently. They are created on
+    // the first call and kept, empty, from then on, along with their own task arenas and
+    // partitions, so building again does not allocate them again.
+    [[nodiscard]]
+    auto task_arenas() noexcept -> std::span<std::unique_ptr<ndbox_arena> const>
+    {
+        if (std::ranges::empty(m_task_arenas))
+        {
+            m_task_arenas.resize(s_block_size);
+            for (auto& arena : m_task_arenas)
+            {
+                arena = std::make_unique<ndbox_arena>(m_buffer_capacity);
+            }
+        }
+        return m_task_arenas;
+    }
+
+    // Lends the free blocks and buffers to the task arenas, each one what its subtree
+    // needed at most in earlier builds, or a share of them by that when there is not
+    // enough. The rest stays here, and a task that runs out borrows from it one block or
+    // buffer at a time, so the build only allocates when the arena does not hold enough
+    // for the whole tree.
+    auto lend_to_tasks() noexcept -> void
+    {
+        const auto arenas = task_arenas();
+        auto       total  = demand_t{};
+        for (auto const& arena : arenas)
+        {
+            total.blocks  += arena->m_demand.blocks;
+            total.buffers += arena->m_demand.buffers;
+        }
+        const auto share = [](size_type free, size_type total_need, size_type need) {
+            return free >= total_need ? need : free * need / total_need;
+        };
+        const auto free_blocks  = std::ranges::size(m_free_blocks);
+        const auto free_buffers = std::ranges::size(m_free_buffers);
+        for (auto const& arena : arenas)
+        {
+            lend(
+                *arena,
+                share(free_blocks, total.blocks, arena->m_demand.blocks),
+                share(free_buffers, total.buffers, arena->m_demand.buffers)
+            );
+            arena->m_lender       = this;
+            arena->m_peak_blocks  = 0;
+            arena->m_peak_buffers = 0;
+        }
+    }
+
+    // Adopts the task arenas, after they record the most their subtree needed. Storage
+    // is counted at its peak, as a leaf splitting holds on to its buffer until its
+    // samples are in the new leaves, and the needs of the tasks add up to the peak of
+    // this arena.
+    auto adopt_tasks() noexcept -> void
+    {
+        auto excess = demand_t{};
+        for (auto const& arena : task_arenas())
+        {
+            auto& demand   = arena->m_demand;
+            demand.blocks  = std::max(demand.blocks, arena->m_peak_blocks);
+            demand.buffers = std::max(demand.buffers, arena->m_peak_buffers);
+            excess.blocks  += demand.blocks - arena->blocks_in_use();
+            excess.buffers += demand.buffers - arena->element_buffers_in_use();
+            arena->m_lender  = nullptr;
+            adopt(*arena);
+        }
+        m_peak_blocks  = std::max(m_peak_blocks, blocks_in_use() + excess.blocks);
+        m_peak_buffers =
+            std::max(m_peak_buffers, element_buffers_in_use() + excess.buffers);
+    }
+
+    // Scratch to split samples among the boxes of a block, empty and keeping capacity
+    [[nodiscard]]
+    auto partitions() noexcept -> std::span<element_buffer_t>
+    {
+        m_partitions.resize(s_block_size);
+        for (auto& partition : m_partitions)
+        {
+            partition.clear();
+        }
+        return m_partitions;
+    }
+
+    [[nodiscard]]
+    auto allocated_blocks() const noexcept -> size_type
+    {
+        return m_allocated_blocks;
+    }
+
+    [[nodiscard]]
+    auto blocks_in_use() const noexcept -> size_type
+    {
+        return m_allocated_blocks - std::ranges::size(m_free_blocks);
+    }
+
+    [[nodiscard]]
+    auto free_element_buffers() const noexcept -> size_type
+    {
+        return std::ranges::size(m_free_buffers);
+    }
+
+    [[nodiscard]]
+    auto allocated_element_buffers() const noexcept -> size_type
+    {
+        return m_allocated_buffers;
+    }
+
+    [[nodiscard]]
+    auto element_buffers_in_use() const noexcept -> size_type
+    {
+        return m_allocated_buffers - std::ranges::size(m_free_buffers);
+    }
+
+private:
+    struct demand_t
+    {
+        size_type blocks  = 0;
+        size_type buffers = 0;
+    };
+
+    struct alignas(std::max(alignof(box_t), s_cache_line)) block_storage
+    {
+        std::byte data[sizeof(box_t) * s_block_size];
+    };
+
+    // From the arena that lent this one storage, which the other tasks of the build may
+    // be borrowing from at the same time, and from the heap at the root
+    auto refill(size_type blocks, size_type buffers) noexcept -> void
+    {
+        if (blocks == 0 && buffers == 0)
+        {
+            return;
+        }
+        if (m_lender != nullptr)
+        {
+            auto const lock = tbb::spin_mutex::scoped_lock{ m_lender->m_mutex };
+            m_lender->refill(
+                blocks - std::min(blocks, std::ranges::size(m_lender->m_free_blocks)),
+                buffers - std::min(buffers, std::ranges::size(m_lender->m_free_buffers))
+            );
+            m_lender->lend(*this, blocks, buffers);
+            return;
+        }
+        if (blocks != 0)
+        {
+            grow();
+        }
+        for (auto i = size_type{ 0 }; i != buffers; ++i)
+        {
+            m_free_buffers.emplace_back().reserve(m_buffer_capacity);
+            ++m_allocated_buffers;
+        }
+    }
+
+    // Chunks grow geometrically and are never moved, so handed out blocks stay valid
+    auto grow() noexcept -> void
+    {
+        const auto chunk_size = std::max(s_min_chunk_size, m_allocated_blocks);
+        auto&&     chunk      = m_chunks.emplace_back(
+            std::make_unique_for_overwrite<block_storage[]>(chunk_size)
+        );
+        m_free_blocks.reserve(m_free_blocks.size() + chunk_size);
+        for (auto i = chunk_size; i != 0; --i)
+        {
+            m_free_blocks.push_back(reinterpret_cast<box_t*>(chunk[i - 1].data));
+        }
+        m_allocated_blocks += chunk_size;
+    }
+
+private:
+    std::vector<std::unique_ptr<block_storage[]>> m_chunks;
+    std::vector<box_t*>                           m_free_blocks;
+    std::vector<element_buffer_t>                 m_free_buffers;
+    size_type                                     m_allocated_blocks = 0;
+    size_type                                     m_allocated_buffers = 0;
+    size_type                                     m_buffer_capacity;
+    std::vector<std::unique_ptr<ndbox_arena>>     m_task_arenas;
+    std::vector<element_buffer_t>                 m_partitions;
+    // Most storage in use at once since the arena was last lent storage
+    size_type                                     m_peak_blocks  = 0;
+    size_type                                     m_peak_buffers = 0;
+    // Most storage the subtree of a task arena needed in any build
+    demand_t                                      m_demand;
+    // Of a task arena during a build, guarded by its mutex
+    ndbox_arena*                                  m_lender = nullptr;
+    tbb::spin_mutex                               m_mutex;
+};
+
+} // namespace ndt
@@ -3,19 +3,30 @@
 #include "constexpr_functions.hpp"
 #include "error_handling.hpp"
 #include "logging.hpp"
+#include "ndbox_arena.hpp"
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <execution>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <optional>
 #include <ostream>
 #include <ranges>
+#include <span>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 #ifdef DEBUG_NDTREE
 #include <iostream>
@@ -56,8 +67,83 @@ concept sample_concept = requires(T t) {
     { merge(std::array{ t, t }) } -> std::same_as<std::optional<T>>;
 } && std::is_destructible_v<T>;
 
+// Samples that provide, through ADL, an accumulator to merge them one at a time
+template <typename T>
+concept accumulable_sample = sample_concept<T> && requires(T const t) {
+    merge_accumulator(t).add(t);
+    { merge_accumulator(t).result() } -> std::same_as<std::optional<T>>;
+};
+
+// Samples that provide, through ADL, the quadrupole moment of a single sample about a
+// center. The moments of a box are the sum of those of its samples.
+template <typename T>
+concept multipole_sample =
+    sample_concept<T> && requires(T const t, typename T::position_t const c) {
+        requires std::default_initializable<decltype(quadrupole_contribution(t, c))>;
+        quadrupole_contribution(t, c) += quadrupole_contribution(t, c);
+    };
+
+// Samples that provide, through ADL, their position and mass in a narrower type, for far
+// fields evaluated in lower precision
+template <typename T>
+concept narrowable_sample = sample_concept<T> && requires(T const t) {
+    requires std::copyable<decltype(narrow_monopole(t))>;
+};
+
 } // namespace concepts
 
+// Highest order of the moments cache_summary computes for each box. The monopole is the
+// summary sample itself.
+enum struct MultipoleOrder
+{
+    monopole,
+    quadrupole
+};
+
+// Migration found by a reorganize of ndtree, and what was done about it
+struct reorganize_stats
+{
+    std::size_t samples = 0; // In the tree before reorganizing
+    std::size_t escaped = 0; // Out of their leaf
+    // Levels the escaped samples climb to a box that takes them in, the root for those
+    // that left it
+    std::size_t climbed = 0;
+    // Depths of the leaves of all samples, summed
+    std::size_t depth   = 0;
+    bool        rebuilt = false;
+};
+
+enum struct ReorganizeMode
+{
+    adaptive,
+    relocate,
+    rebuild
+};
+
+// How a reorganize of ndtree handles the samples that left their leaves: relocating
+// them, or building the tree again from all samples. Adaptively, relocating costs about
+// twice the levels the samples climb, up and back down, and rebuilding the depth of
+// every sample. relocation_cost weighs a level relocated against a level built.
+struct reorganize_policy
+{
+    ReorganizeMode mode            = ReorganizeMode::adaptive;
+    double         relocation_cost = 4.0;
+
+    [[nodiscard]]
+    auto rebuild(reorganize_stats const& stats) const noexcept -> bool
+    {
+        switch (mode)
+        {
+        case ReorganizeMode::relocate: return false;
+        case ReorganizeMode::rebuild: return true;
+        case ReorganizeMode::adaptive:
+            return relocation_cost * 2.0 * static_cast<double>(stats.climbed) >
+                   static_cast<double>(stats.depth);
+        default: utility::error_handling::assert_unreachable();
+        }
+    }
+};
+
 template <concepts::Point Point_Type>
 class ndboundary
 {
@@ -127,6 +213,22 @@ public:
         return m_max - m_min;
     }
 
+    // Grows the boundary to take in p
+    constexpr auto extend(point_t const& p) noexcept -> void
+    {
+        for (index_t i = 0; i != s_dimension; ++i)
+        {
+            m_min[i] = std::min(m_min[i], p[i]);
+            m_max[i] = std::max(m_max[i], p[i]);
+        }
+    }
+
+    constexpr auto extend(ndboundary const& b) noexcept -> void
+    {
+        extend(b.m_min);
+        extend(b.m_max);
+    }
+
     [[nodiscard]]
     constexpr auto operator<=>(ndboundary const&) const = default;
 
@@ -165,6 +267,36 @@ auto in(
     return true;
 }
 
+// Through the bits of the value, as -ffinite-math-only folds std::isfinite to true
+template <std::floating_point Value_Type>
+[[nodiscard]]
+constexpr auto finite(Value_Type x) noexcept -> bool
+{
+    static_assert(std::numeric_limits<Value_Type>::is_iec559);
+    using bits_t =
+        std::conditional_t<sizeof(Value_Type) == 4, std::uint32_t, std::uint64_t>;
+    static_assert(sizeof(bits_t) == sizeof(Value_Type));
+    constexpr auto s_mantissa_bits = std::numeric_limits<Value_Type>::digits - 1;
+    constexpr auto s_exponent_mask = (std::numeric_limits<bits_t>::max() >> 1) &
+                                     ~((bits_t{ 1 } << s_mantissa_bits) - 1);
+    return (std::bit_cast<bits_t>(x) & s_exponent_mask) != s_exponent_mask;
+}
+
+template <concepts::Point Point_Type>
+[[nodiscard]]
+auto finite(Point_Type const& p) noexcept -> bool
+{
+    for (auto i = decltype(Point_Type::s_dimension){ 0 }; i != Point_Type::s_dimension;
+         ++i)
+    {
+        if (!finite(p[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 template <concepts::Point Point_Type>
 [[nodiscard]]
 auto count_in(
@@ -175,25 +307,319 @@ auto count_in(
     return std::ranges::count_if(collection, [b](auto const& p) { return in(p, b); });
 }
 
+// Bounds of positions added one at a time, in a single pass over them. All dimensions
+// are reduced together, into per-dimension minima and maxima the compiler keeps in
+// vector registers.
+template <concepts::Point Point_Type>
+class limits_accumulator
+{
+public:
+    using point_t                            = Point_Type;
+    using value_type                         = typename point_t::value_type;
+    inline static constexpr auto s_dimension = point_t::s_dimension;
+    using boundary_t                         = ndboundary<point_t>;
+
+public:
+    auto add(point_t const& p) noexcept -> void
+    {
+        for (auto i = decltype(s_dimension){ 0 }; i != s_dimension; ++i)
+        {
+            m_min[i] = std::min(m_min[i], p[i]);
+            m_max[i] = std::max(m_max[i], p[i]);
+        }
+    }
+
+    auto add(limits_accumulator const& other) noexcept -> void
+    {
+        for (auto i = decltype(s_dimension){ 0 }; i != s_dimension; ++i)
+        {
+            m_min[i] = std::min(m_min[i], other.m_min[i]);
+            m_max[i] = std::max(m_max[i], other.m_max[i]);
+        }
+    }
+
+    auto add(boundary_t const& b) noexcept -> void
+    {
+        add(b.min());
+        add(b.max());
+    }
+
+    // None when nothing was added
+    [[nodiscard]]
+    auto result() const noexcept -> std::optional<boundary_t>
+    {
+        if (m_min[0] > m_max[0])
+        {
+            return std::nullopt;
+        }
+        point_t min;
+        point_t max;
+        for (auto i = decltype(s_dimension){ 0 }; i != s_dimension; ++i)
+        {
+            min[i] = m_min[i];
+            max[i] = m_max[i];
+        }
+        return boundary_t{ min, max };
+    }
+
+private:
+    using components_t = std::array<value_type, s_dimension>;
+
+    [[nodiscard]]
+    static constexpr auto filled(value_type v) noexcept -> components_t
+    {
+        components_t c;
+        c.fill(v);
+        return c;
+    }
+
+private:
+    // Not infinities, which -ffinite-math-only does not keep
+    components_t m_min = filled(std::numeric_limits<value_type>::max());
+    components_t m_max = filled(std::numeric_limits<value_type>::lowest());
+};
+
+// Below these many samples the bounds are reduced by the calling thread
+inline constexpr auto s_parallel_limits_grain = std::size_t{ 16384 };
+
+// Bounds of the positions of the samples, which must not be empty
 [[nodiscard]]
 auto compute_limits(std::ranges::range auto const& data) noexcept
     requires concepts::sample_concept<std::ranges::range_value_t<decltype(data)>>
 {
-    using sample_t   = std::ranges::range_value_t<decltype(data)>;
-    using point_t    = typename sample_t::position_t;
-    constexpr auto N = point_t::s_dimension;
-    point_t        min;
-    point_t        max;
+    using sample_t = std::ranges::range_value_t<decltype(data)>;
+    auto limits    = limits_accumulator<typename sample_t::position_t>{};
+    for (auto const& s : data)
+    {
+        limits.add(s.position());
+    }
+    assert(limits.result().has_value());
+    return limits.result().value();
+}
+
+// Bounds of the positions the samples that keep accepts, with chunks of at least
+// s_parallel_limits_grain samples reduced concurrently. None when no sample passes.
+template <typename Filter_Fn>
+[[nodiscard]]
+auto reduce_limits(
+    std::ranges::random_access_range auto const& data,
+    Filter_Fn                                    keep
+) noexcept
+    requires concepts::sample_concept<std::ranges::range_value_t<decltype(data)>>
+{
+    using sample_t      = std::ranges::range_value_t<decltype(data)>;
+    using accumulator_t = limits_accumulator<typename sample_t::position_t>;
+    const auto size     = static_cast<std::size_t>(std::ranges::size(data));
+    const auto first    = std::ranges::begin(data);
+    const auto limits   = tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0uz, size, s_parallel_limits_grain),
+        accumulator_t{},
+        [first, &keep](tbb::blocked_range<std::size_t> const& r, accumulator_t acc) {
+            for (auto i = r.begin(); i != r.end(); ++i)
+            {
+                auto const& p = first[static_cast<std::ptrdiff_t>(i)].position();
+                if (keep(p))
+                {
+                    acc.add(p);
+                }
+            }
+            return acc;
+        },
+        [](accumulator_t lhs, accumulator_t const& rhs) {
+            lhs.add(rhs);
+            return lhs;
+        }
+    );
+    return limits.result();
+}
+
+// As compute_limits, with chunks of at least s_parallel_limits_grain samples reduced
+// concurrently
+[[nodiscard]]
+auto compute_limits(
+    std::execution::parallel_policy,
+    std::ranges::random_access_range auto const& data
+) noexcept
+    requires concepts::sample_concept<std::ranges::range_value_t<decltype(data)>>
+{
+    const auto limits = reduce_limits(data, [](auto const&) { return true; });
+    assert(limits.has_value());
+    return limits.value();
+}
+
+// Bounds of the finite positions of the samples, none when there are none
+[[nodiscard]]
+auto compute_finite_limits(
+    std::execution::parallel_policy,
+    std::ranges::random_access_range auto const& data
+) noexcept
+    requires concepts::sample_concept<std::ranges::range_value_t<decltype(data)>>
+{
+    return reduce_limits(data, [](auto const& p) { return finite(p); });
+}
+
+// Boundary Fanout times as wide as b in every dimension, grown towards p, and the index
+// of the sub-box b is in it, numbered as ndbox numbers its sub-boxes
+template <std::size_t Fanout, concepts::Point Point_Type>
+[[nodiscard]]
+auto grow_towards(ndboundary<Point_Type> const& b, Point_Type const& p) noexcept
+    -> std::pair<ndboundary<Point_Type>, std::size_t>
+{
+    using value_type = typename Point_Type::value_type;
+    constexpr auto N = Point_Type::s_dimension;
+    auto           min    = b.min();
+    auto           max    = b.max();
+    auto           corner = std::size_t{ 0 };
+    auto           stride = std::size_t{ 1 };
     for (auto i = decltype(N){ 0 }; i != N; ++i)
     {
-        const auto bounds =
-            std::ranges::minmax(data | std::views::transform([i](auto const& p) -> auto {
-                                    return p.position()[i];
-                                }));
-        min[i] = bounds.min;
-        max[i] = bounds.max;
+        const auto growth = static_cast<value_type>(Fanout - 1) * (max[i] - min[i]);
+        if (p[i] < min[i])
+        {
+            min[i] -= growth;
+            corner += (Fanout - 1) * stride;
+        }
+        else
+        {
+            max[i] += growth;
+        }
+        stride *= Fanout;
     }
-    return ndboundary<point_t>{ min, max };
+    return { ndboundary<Point_Type>{ min, max }, corner };
+}
+
+// Times grow_towards must grow b for it to take in p, from the distance of p to the far
+// side of b in every dimension. Max_Growth + 1 when more are needed.
+template <std::size_t Fanout, std::size_t Max_Growth, concepts::Point Point_Type>
+[[nodiscard]]
+auto growth_towards(ndboundary<Point_Type> const& b, Point_Type const& p) noexcept
+    -> std::size_t
+{
+    using value_type = typename Point_Type::value_type;
+    constexpr auto N = Point_Type::s_dimension;
+    static constexpr auto s_fanout = static_cast<value_type>(Fanout);
+    static constexpr auto s_max_widening =
+        static_cast<value_type>(utility::cx_functions::pow(Fanout, Max_Growth));
+    auto growth = std::size_t{ 0 };
+    for (auto i = decltype(N){ 0 }; i != N; ++i)
+    {
+        const auto width = b.max(i) - b.min(i);
+        const auto reach = p[i] < b.min(i)   ? b.max(i) - p[i]
+                           : p[i] > b.max(i) ? p[i] - b.min(i)
+                                             : value_type{ 0 };
+        if (reach <= width)
+        {
+            continue;
+        }
+        if (reach > s_max_widening * width)
+        {
+            return Max_Growth + 1;
+        }
+        const auto steps     = std::ceil(std::log(reach / width) / std::log(s_fanout));
+        growth               = std::max(growth, static_cast<std::size_t>(steps));
+    }
+    return growth;
+}
+
+// Merges a range of sample references, through the sample accumulator if it has one
+template <concepts::sample_concept Sample_Type>
+[[nodiscard]]
+auto summarize(std::ranges::forward_range auto&& samples) noexcept
+    -> std::optional<Sample_Type>
+{
+    if constexpr (concepts::accumulable_sample<Sample_Type>)
+    {
+        using accumulator_t =
+            decltype(merge_accumulator(std::declval<Sample_Type const&>()));
+        auto accumulator = accumulator_t{};
+        for (Sample_Type const& s : samples)
+        {
+            accumulator.add(s);
+        }
+        return accumulator.result();
+    }
+    else
+    {
+        return merge(samples);
+    }
+}
+
+struct no_quadrupole
+{
+};
+
+template <typename Sample_Type>
+struct quadrupole
+{
+    using type = no_quadrupole;
+};
+
+template <concepts::multipole_sample Sample_Type>
+struct quadrupole<Sample_Type>
+{
+    using type = decltype(quadrupole_contribution(
+        std::declval<Sample_Type const&>(),
+        std::declval<typename Sample_Type::position_t const&>()
+    ));
+};
+
+template <typename Sample_Type>
+using quadrupole_t = typename quadrupole<Sample_Type>::type;
+
+struct no_narrow_summary
+{
+};
+
+template <typename Sample_Type>
+struct narrow_summary
+{
+    using type = no_narrow_summary;
+};
+
+template <concepts::narrowable_sample Sample_Type>
+struct narrow_summary<Sample_Type>
+{
+    using type = decltype(narrow_monopole(std::declval<Sample_Type const&>()));
+};
+
+template <typename Sample_Type>
+using narrow_summary_t = typename narrow_summary<Sample_Type>::type;
+
+// Quadrupole about center of a leaf, from its samples
+template <concepts::multipole_sample Sample_Type>
+[[nodiscard]]
+auto summarize_quadrupole(
+    typename Sample_Type::position_t const& center,
+    std::ranges::forward_range auto&&       samples
+) noexcept -> quadrupole_t<Sample_Type>
+{
+    auto q = quadrupole_t<Sample_Type>{};
+    for (Sample_Type const& s : samples)
+    {
+        q += quadrupole_contribution(s, center);
+    }
+    return q;
+}
+
+// Quadrupole about center of a fragmented box, from the summarized sub-boxes. Each
+// moment is moved to center by adding that of the sub-box summary (parallel axis).
+template <concepts::multipole_sample Sample_Type>
+[[nodiscard]]
+auto summarize_subbox_quadrupoles(
+    typename Sample_Type::position_t const& center,
+    std::ranges::forward_range auto&&       boxes
+) noexcept -> quadrupole_t<Sample_Type>
+{
+    auto q = quadrupole_t<Sample_Type>{};
+    for (auto const& b : boxes)
+    {
+        if (b.summary().has_value())
+        {
+            q += b.quadrupole().value();
+            q += quadrupole_contribution(b.summary().value(), center);
+        }
+    }
+    return q;
 }
 
 } // namespace detail
@@ -213,6 +639,14 @@ public:
     inline static constexpr auto s_subdivisions =
         utility::cx_functions::pow(s_fanout, s_dimension);
     inline static constexpr auto s_boundary_tol = value_type{ 1e-4 };
+    // Below these many samples a subtree is built or summarized by the calling thread
+    inline static constexpr auto s_parallel_build_grain   = std::size_t{ 2048 };
+    inline static constexpr auto s_parallel_summary_grain = std::size_t{ 4096 };
+    using element_buffer_t = std::vector<sample_t const*>;
+    using arena_t = ndbox_arena<ndbox, sample_t const*, s_subdivisions>;
+    using quadrupole_t     = detail::quadrupole_t<sample_t>;
+    using narrow_summary_t = detail::narrow_summary_t<sample_t>;
+    using limits_t         = detail::limits_accumulator<point_t>;
 
 public:
     ndbox(
@@ -220,16 +654,36 @@ public:
         std::size_t max_elements,
         depth_t     depth,
         depth_t     max_depth,
-        ndbox*      parent
+        ndbox*      parent,
+        arena_t*    arena
     ) :
         m_boundary{ boundary },
+        m_extent{ boundary },
+        m_bounds{ std::nullopt },
         m_elements{},
+        m_subboxes{ nullptr },
         m_summary{ std::nullopt },
+        m_quadrupole{ std::nullopt },
+        m_narrow_summary{ std::nullopt },
         m_parent{ parent },
+        m_arena{ arena },
         m_capacity{ max_elements },
         m_max_depth{ max_depth },
         m_depth{ depth }
     {
+        assert(m_arena != nullptr);
+    }
+
+    // Sub-boxes keep a pointer to their parent, so boxes never move
+    ndbox(ndbox const&)                    = delete;
+    ndbox(ndbox&&)                         = delete;
+    auto operator=(ndbox const&) -> ndbox& = delete;
+    auto operator=(ndbox&&) -> ndbox&      = delete;
+
+    ~ndbox() noexcept
+    {
+        release_subboxes();
+        m_arena->release_element_buffer(std::move(m_elements));
     }
 
     [[nodiscard]]
@@ -244,7 +698,13 @@ public:
             auto&& elements = contained_elements();
             if (elements.size() < m_capacity || m_depth == m_max_depth)
             {
+                if (elements.capacity() == 0)
+                {
+                    elements = m_arena->acquire_element_buffer();
+                }
                 elements.push_back(sp);
+                ++m_element_count;
+                mark_dirty();
 #if DEBUG_NDTREE
                 std::cout << "Value at " << sp->position() << " stored in Box at depth "
                           << m_depth << " with bounds " << m_boundary << '\n';
@@ -272,6 +732,7 @@ public:
             {
                 if (const auto success = b.insert(sp); success)
                 {
+                    ++m_element_count;
                     return true;
                 }
             }
@@ -280,6 +741,55 @@ public:
         utility::error_handling::assert_unreachable();
     }
 
+    // Inserts the samples into an empty box, building large subtrees concurrently. The
+    // result is the same tree as inserting them one at a time in the same order: every
+    // subtree receives its samples in order, so it can be built on its own. Each task
+    // allocates from one of the task arenas of this box's arena, which lends them its
+    // free blocks and buffers and adopts them afterwards, so a tree built again only
+    // uses the storage the last build returned to the arena.
+    // Returns the number of samples inside the box.
+    auto build(std::span<sample_t const* const> samples) noexcept -> std::size_t
+    {
+        assert(!fragmented() && std::ranges::empty(m_elements));
+        const auto size = std::ranges::size(samples);
+        if (size < s_parallel_build_grain || size <= m_capacity || m_depth == m_max_depth)
+        {
+            return static_cast<std::size_t>(
+                std::ranges::count_if(samples, [this](auto const* const s) {
+                    return insert(s);
+                })
+            );
+        }
+        fragment();
+        const auto partitions = m_arena->partitions();
+        for (auto const* const s : samples)
+        {
+            // First sub-box that accepts the sample, as insert does
+            const auto it = std::ranges::find_if(subboxes(), [s](auto const& b) {
+                return detail::in(s->position(), b.m_boundary, s_boundary_tol);
+            });
+            if (it != std::ranges::end(subboxes()))
+            {
+                partitions[static_cast<std::size_t>(it - std::ranges::begin(subboxes()))]
+                    .push_back(s);
+            }
+        }
+        m_arena->lend_to_tasks();
+        const auto arenas = m_arena->task_arenas();
+        auto       counts = std::array<std::size_t, s_subdivisions>{};
+        tbb::parallel_for(std::size_t{ 0 }, s_subdivisions, [&](std::size_t i) {
+            m_subboxes[i].rebind_arena(arenas[i].get());
+            counts[i] = m_subboxes[i].build(partitions[i]);
+        });
+        m_arena->adopt_tasks();
+        for (auto&& b : subboxes())
+        {
+            b.rebind_arena(m_arena);
+        }
+        m_element_count = std::ranges::fold_left(counts, 0uz, std::plus{});
+        return m_element_count;
+    }
+
     auto reorganize() noexcept -> void
     {
         if (fragmented())
@@ -321,23 +831,72 @@ public:
 #endif
             if (out_of_bounds_range.begin() != out_of_bounds_range.end())
             {
+                // Relocating may insert into this box again (and even fragment it), so
+                // the escaped samples are taken out before they are handed up
+                auto escaped = m_arena->acquire_element_buffer();
+                escaped.assign(out_of_bounds_range.begin(), out_of_bounds_range.end());
+                contained_elements().erase(
+                    out_of_bounds_range.begin(), out_of_bounds_range.end()
+                );
+                m_element_count -= std::ranges::size(escaped);
+                mark_dirty();
                 if (m_parent)
                 {
-                    for (auto const* const p : out_of_bounds_range)
+                    for (auto const* const p : escaped)
                     {
                         assert(!detail::in(p->position(), m_boundary, s_boundary_tol));
                         m_parent->relocate(p);
                     }
                 }
-                contained_elements().erase(
-                    out_of_bounds_range.begin(), out_of_bounds_range.end()
-                );
+                m_arena->release_element_buffer(std::move(escaped));
+            }
+        }
+    }
+
+    // Folds fragmented boxes back into leaves when all their elements fit in one box.
+    // Sub-boxes are regrouped first, so empty or sparse subtrees collapse in one pass and
+    // their blocks are returned to the arena.
+    auto regroup() noexcept -> void
+    {
+        if (!fragmented())
+        {
+            return;
+        }
+        for (auto&& b : subboxes())
+        {
+            b.regroup();
+        }
+        if (std::ranges::any_of(subboxes(), [](auto const& b) { return b.fragmented(); }))
+        {
+            return;
+        }
+        const auto count = std::ranges::fold_left(
+            subboxes(),
+            0uz,
+            [](auto acc, auto const& b) {
+                return acc + std::ranges::size(b.contained_elements());
             }
+        );
+        if (count > m_capacity)
+        {
+            return;
+        }
+        auto elements =
+            count == 0 ? element_buffer_t{} : m_arena->acquire_element_buffer();
+        for (auto const& b : subboxes())
+        {
+            std::ranges::copy(b.contained_elements(), std::back_inserter(elements));
         }
+        release_subboxes();
+        m_elements = std::move(elements);
+        mark_dirty();
     }
 
+    // The sample left one of the sub-boxes, it is not counted here until inserted again
     auto relocate(sample_t const* const sp) noexcept -> void
     {
+        assert(m_element_count > 0);
+        --m_element_count;
         if (!detail::in(sp->position(), m_boundary, s_boundary_tol))
         {
             if (m_parent)
@@ -349,7 +908,7 @@ public:
             {
                 std::ostringstream ss;
                 ss << "Sample at " << sp->position()
-                   << " no longer tracked by the tree...";
+                   << " left the root, the tree grows on reorganize...";
                 utility::logging::default_source::log(utility::logging::info, ss.str());
             }
 #endif
@@ -362,29 +921,175 @@ public:
         }
     }
 
-    auto cache_summary() noexcept -> void
+    // Adds the samples out of their leaf and the levels they climb to stats, and the
+    // leaves they are out of to migrated, leaving the tree as it is. Reorganizing those
+    // leaves relocates every escaped sample.
+    auto collect_migration(
+        reorganize_stats&    stats,
+        std::vector<ndbox*>& migrated
+    ) noexcept -> void
     {
         if (fragmented())
         {
             for (auto&& b : subboxes())
             {
-                b.cache_summary();
+                b.collect_migration(stats, migrated);
             }
-            m_summary = merge(
-                subboxes() | std::views::filter([](auto const& b) {
-                    return b.summary().has_value();
-                }) |
-                std::views::transform([](auto const& b) { return b.summary().value(); })
-            );
+            return;
         }
+        stats.depth += static_cast<std::size_t>(m_depth) * std::ranges::size(m_elements);
+        const auto escaped_before = stats.escaped;
+        for (auto const* const e : m_elements)
+        {
+            if (detail::in(e->position(), m_boundary, s_boundary_tol))
+            {
+                continue;
+            }
+            if (stats.escaped++ == escaped_before)
+            {
+                migrated.push_back(this);
+            }
+            for (auto const* b = m_parent; b != nullptr; b = b->m_parent)
+            {
+                ++stats.climbed;
+                if (detail::in(e->position(), b->m_boundary, s_boundary_tol))
+                {
+                    break;
+                }
+            }
+        }
+    }
 
-        else
+    // Empties the box, its sub-boxes and elements go back to the arena
+    auto clear() noexcept -> void
+    {
+        release_subboxes();
+        m_arena->release_element_buffer(std::exchange(m_elements, element_buffer_t{}));
+        m_element_count = 0;
+        mark_dirty();
+    }
+
+    // Empties the root and gives it another boundary and maximum depth
+    auto reset(boundary_t boundary, depth_t max_depth) noexcept -> void
+    {
+        assert(m_parent == nullptr);
+        clear();
+        m_boundary  = boundary;
+        m_extent    = boundary;
+        m_bounds    = std::nullopt;
+        m_max_depth = max_depth;
+    }
+
+    // Makes the root s_fanout times as wide, towards p. The current contents become the
+    // sub-box in the opposite corner, one level deeper, and the maximum depth grows by
+    // one so leaves can still be as small as before.
+    auto grow(point_t const& p) noexcept -> void
+    {
+        assert(m_parent == nullptr);
+        const auto [boundary, corner] = detail::grow_towards<s_fanout>(m_boundary, p);
+        const auto old_boundary       = std::exchange(m_boundary, boundary);
+        const auto old_extent         = std::exchange(m_extent, boundary);
+        auto       old_bounds         = std::exchange(m_bounds, std::nullopt);
+        auto       elements           = std::exchange(m_elements, element_buffer_t{});
+        const auto subboxes           = std::exchange(m_subboxes, nullptr);
+        const auto fragmented         = m_fragmented;
+        ++m_max_depth;
+        m_subboxes   = m_arena->acquire_block();
+        m_fragmented = true;
+        construct_subboxes();
+
+        auto& inner           = m_subboxes[corner];
+        inner.m_boundary      = old_boundary;
+        inner.m_extent        = old_extent;
+        inner.m_bounds        = std::move(old_bounds);
+        inner.m_elements      = std::move(elements);
+        inner.m_subboxes      = subboxes;
+        inner.m_fragmented    = fragmented;
+        inner.m_element_count = m_element_count;
+        if (fragmented)
+        {
+            for (auto&& b : inner.subboxes())
+            {
+                b.m_parent = &inner;
+                b.deepen();
+            }
+        }
+        mark_dirty();
+    }
+
+    // Bottom up, with a task per sub-box for subtrees holding at least
+    // s_parallel_summary_grain elements. Children are reduced by reference, so no sample
+    // is copied on the way.
+    auto cache_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        summarize_subtree(order, summary_pass::full);
+    }
+
+    // As cache_summary, but only for the boxes changed since their summary was cached:
+    // the leaves that gained, lost or had touched samples, and their ancestors. Clean
+    // subtrees keep their summary.
+    auto update_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        summarize_subtree(order, summary_pass::dirty);
+    }
+
+    // As cache_summary, for samples that moved without being relocated. The boxes keep
+    // their samples, and their extent grows to take in those that left them.
+    auto refit(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        summarize_subtree(order, summary_pass::refit);
+    }
+
+    // Marks the leaf holding the sample dirty after the sample moved. A sample may still
+    // be anywhere in its leaf give or take the tolerance, so every box whose bounds take
+    // its position is looked into. One that left its leaf is not found, reorganize marks
+    // both leaves when it relocates it.
+    auto touch(sample_t const* const sp) noexcept -> bool
+    {
+        if (!detail::in(sp->position(), m_boundary, s_boundary_tol))
+        {
+            return false;
+        }
+        if (fragmented())
+        {
+            return std::ranges::any_of(subboxes(), [sp](auto&& b) {
+                return b.touch(sp);
+            });
+        }
+        if (std::ranges::find(contained_elements(), sp) ==
+            std::ranges::end(contained_elements()))
+        {
+            return false;
+        }
+        mark_dirty();
+        return true;
+    }
+
+    // Points every sample at remap(sample), for samples that moved to another address
+    // with their positions unchanged. Leaves keep their samples in address order.
+    template <typename Remap_Fn>
+    auto rebind(Remap_Fn const& remap) noexcept -> void
+    {
+        if (fragmented())
+        {
+            for (auto&& b : subboxes())
+            {
+                b.rebind(remap);
+            }
+            return;
+        }
+        for (auto& e : contained_elements())
         {
-            m_summary =
-                merge(contained_elements() | std::views::transform([](auto const& b) {
-                          return *b;
-                      }));
+            e = remap(e);
         }
+        std::ranges::sort(contained_elements());
+    }
+
+    // Whether the cached summary is stale
+    [[nodiscard]]
+    auto dirty() const noexcept -> bool
+    {
+        return m_dirty;
     }
 
     [[nodiscard]]
@@ -399,10 +1104,47 @@ public:
         return m_summary;
     }
 
+    // Cached by cache_summary(MultipoleOrder::quadrupole), about the summary position
+    [[nodiscard]]
+    auto quadrupole() const noexcept -> std::optional<quadrupole_t> const&
+        requires concepts::multipole_sample<sample_t>
+    {
+        return m_quadrupole;
+    }
+
+    // The summary position and mass in the narrower type of the sample, cached along
+    // with the summary by every summary pass
+    [[nodiscard]]
+    auto narrow_summary() const noexcept -> std::optional<narrow_summary_t> const&
+        requires concepts::narrowable_sample<sample_t>
+    {
+        return m_narrow_summary;
+    }
+
+    // Of the extent, the boundary grown by any sample refit left outside of it
     [[nodiscard]]
     auto diagonal_length() const noexcept -> auto
     {
-        return m_boundary.diagonal_length();
+        return m_extent.diagonal_length();
+    }
+
+    [[nodiscard]]
+    auto boundary() const noexcept -> boundary_t const&
+    {
+        return m_boundary;
+    }
+
+    [[nodiscard]]
+    auto extent() const noexcept -> boundary_t const&
+    {
+        return m_extent;
+    }
+
+    // Tight bounds of the samples, as of the last summary pass. None for empty boxes.
+    [[nodiscard]]
+    auto sample_bounds() const noexcept -> std::optional<boundary_t> const&
+    {
+        return m_bounds;
     }
 
     auto print_info(std::ostream& os) const -> void
@@ -449,15 +1191,9 @@ public:
     }
 
     [[nodiscard]]
-    auto elements() const -> std::size_t
+    auto elements() const noexcept -> std::size_t
     {
-        return m_fragmented
-                   ? std::ranges::fold_left(
-                         subboxes(),
-                         0uz,
-                         [](auto acc, const auto& e) { return acc + e.elements(); }
-                     )
-                   : std::ranges::size(contained_elements());
+        return m_element_count;
     }
 
 #if __GNUC__ >= 14
@@ -465,44 +1201,37 @@ public:
     auto contained_elements(this auto&& self) noexcept -> auto&&
     {
         std::forward<decltype(self)>(self).assert_not_fragmented();
-        return std::get<0>(std::forward<decltype(self)>(self).m_elements);
-    }
-
-    [[nodiscard]]
-    auto subboxes(this auto&& self) noexcept -> auto&&
-    {
-        std::forward<decltype(self)>(self).assert_fragmented();
-        return std::get<1>(std::forward<decltype(self)>(self).m_elements);
+        return std::forward<decltype(self)>(self).m_elements;
     }
 #else
     [[nodiscard]]
-    auto contained_elements() noexcept -> auto&
+    auto contained_elements() noexcept -> element_buffer_t&
     {
         assert_not_fragmented();
-        return std::get<0>(m_elements);
+        return m_elements;
     }
 
     [[nodiscard]]
-    auto contained_elements() const noexcept -> auto const&
+    auto contained_elements() const noexcept -> element_buffer_t const&
     {
         assert_not_fragmented();
-        return std::get<0>(m_elements);
+        return m_elements;
     }
+#endif
 
     [[nodiscard]]
-    auto subboxes() noexcept -> auto&
+    auto subboxes() noexcept -> std::span<box_t, s_subdivisions>
     {
         assert_fragmented();
-        return std::get<1>(m_elements);
+        return std::span<box_t, s_subdivisions>{ m_subboxes, s_subdivisions };
     }
 
     [[nodiscard]]
-    auto subboxes() const noexcept -> auto const&
+    auto subboxes() const noexcept -> std::span<box_t const, s_subdivisions>
     {
         assert_fragmented();
-        return std::get<1>(m_elements);
+        return std::span<box_t const, s_subdivisions>{ m_subboxes, s_subdivisions };
     }
-#endif
 
 private:
     // because you cannot portably have a macro expansion (assert) inside #if #endif
@@ -516,17 +1245,140 @@ private:
         assert(!fragmented());
     }
 
+    // Every summary depends on those of the boxes below, so a dirty box has dirty
+    // ancestors and marking stops at the first box that is dirty already
+    auto mark_dirty() noexcept -> void
+    {
+        for (auto* b = this; b != nullptr && !b->m_dirty; b = b->m_parent)
+        {
+            b->m_dirty = true;
+        }
+    }
+
+    enum struct summary_pass
+    {
+        full,
+        dirty,
+        refit
+    };
+
+    auto summarize_subtree(MultipoleOrder order, summary_pass pass) noexcept -> void
+    {
+        if (pass == summary_pass::dirty && !m_dirty)
+        {
+            return;
+        }
+        if (fragmented())
+        {
+            if (m_element_count >= s_parallel_summary_grain)
+            {
+                tbb::parallel_for(
+                    std::size_t{ 0 },
+                    s_subdivisions,
+                    [this, order, pass](std::size_t i) {
+                        m_subboxes[i].summarize_subtree(order, pass);
+                    }
+                );
+            }
+            else
+            {
+                for (auto&& b : subboxes())
+                {
+                    b.summarize_subtree(order, pass);
+                }
+            }
+            m_summary = detail::summarize<sample_t>(
+                subboxes() | std::views::filter([](auto const& b) {
+                    return b.summary().has_value();
+                }) |
+                std::views::transform([](auto const& b) -> sample_t const& {
+                    return b.summary().value();
+                })
+            );
+        }
+        else
+        {
+            m_summary = detail::summarize<sample_t>(
+                contained_elements() |
+                std::views::transform([](auto const* const e) -> sample_t const& {
+                    return *e;
+                })
+            );
+        }
+        cache_quadrupole(order);
+        cache_narrow_summary();
+        auto limits = limits_t{};
+        if (fragmented())
+        {
+            for (auto const& b : subboxes())
+            {
+                if (b.m_bounds.has_value())
+                {
+                    limits.add(b.m_bounds.value());
+                }
+            }
+        }
+        else
+        {
+            for (auto const* const e : contained_elements())
+            {
+                limits.add(e->position());
+            }
+        }
+        m_bounds = limits.result();
+        m_extent = m_boundary;
+        if (pass == summary_pass::refit && m_bounds.has_value())
+        {
+            m_extent.extend(m_bounds.value());
+        }
+        m_dirty = false;
+    }
+
+
     auto fragment() noexcept -> void
     {
-        using size_type = decltype(s_dimension);
         if (m_fragmented)
         {
             return;
         }
-        auto samples = std::move(contained_elements());
-        m_elements   = std::vector<ndbox>();
+        mark_dirty();
+        auto samples = std::exchange(m_elements, element_buffer_t{});
+        m_subboxes   = m_arena->acquire_block();
         m_fragmented = true;
-        subboxes().reserve(s_subdivisions);
+        construct_subboxes();
+        for (auto const* const s : samples)
+        {
+            if (!s)
+            {
+                continue;
+            }
+            // A box that has not been reorganized yet may still hold samples that moved
+            // out of its bounds, those have to go back up instead of being dropped
+            if (!std::ranges::any_of(subboxes(), [s](auto&& b) { return b.insert(s); }))
+            {
+                relocate(s);
+            }
+        }
+        m_arena->release_element_buffer(std::move(samples));
+    }
+
+    auto deepen() noexcept -> void
+    {
+        ++m_depth;
+        ++m_max_depth;
+        if (m_fragmented)
+        {
+            for (auto&& b : subboxes())
+            {
+                b.deepen();
+            }
+        }
+    }
+
+    // Into the block m_subboxes points to, empty, in the order grow_towards numbers them
+    auto construct_subboxes() noexcept -> void
+    {
+        using size_type = decltype(s_dimension);
         if constexpr (s_fanout == 2)
         {
             static_assert(
@@ -547,8 +1399,15 @@ private:
                     min[i] = top_half ? m_boundary.mid(i) : m_boundary.min(i);
                     max[i] = top_half ? m_boundary.max(i) : m_boundary.mid(i);
                 }
-                subboxes().push_back(box_t{
-                    boundary_t{ min, max }, m_capacity, m_depth + 1, m_max_depth, this });
+                std::construct_at(
+                    m_subboxes + binary_div,
+                    boundary_t{ min, max },
+                    m_capacity,
+                    m_depth + 1,
+                    m_max_depth,
+                    this,
+                    m_arena
+                );
             }
         }
         else
@@ -571,36 +1430,99 @@ private:
                     max[i]  = m_boundary.min(i) + (j + value_type{ 1 }) * delta;
                     dim_idx = std::floor(dim_idx / static_cast<value_type>(s_fanout));
                 }
-                subboxes().push_back(box_t{
-                    boundary_t{ min, max }, m_capacity, m_depth + 1, m_max_depth, this });
+                std::construct_at(
+                    m_subboxes + n,
+                    boundary_t{ min, max },
+                    m_capacity,
+                    m_depth + 1,
+                    m_max_depth,
+                    this,
+                    m_arena
+                );
             }
         }
-        for (auto const* const s : samples)
+    }
+
+    auto cache_quadrupole(MultipoleOrder order) noexcept -> void
+    {
+        m_quadrupole.reset();
+        if constexpr (concepts::multipole_sample<sample_t>)
         {
-            if (!s)
+            if (order != MultipoleOrder::quadrupole || !m_summary.has_value())
             {
-                continue;
+                return;
             }
+            auto const& center = m_summary.value().position();
+            if (fragmented())
+            {
+                m_quadrupole =
+                    detail::summarize_subbox_quadrupoles<sample_t>(center, subboxes());
+            }
+            else
+            {
+                m_quadrupole = detail::summarize_quadrupole<sample_t>(
+                    center,
+                    contained_elements() |
+                        std::views::transform([](auto const* const e) -> sample_t const& {
+                            return *e;
+                        })
+                );
+            }
+        }
+    }
+
+    auto cache_narrow_summary() noexcept -> void
+    {
+        if constexpr (concepts::narrowable_sample<sample_t>)
+        {
+            m_narrow_summary = m_summary.transform([](sample_t const& s) {
+                return narrow_monopole(s);
+            });
+        }
+    }
+
+    auto rebind_arena(arena_t* const arena) noexcept -> void
+    {
+        m_arena = arena;
+        if (fragmented())
+        {
             for (auto&& b : subboxes())
             {
-                if (const auto success = b.insert(s); success)
-                {
-                    break;
-                }
+                b.rebind_arena(arena);
             }
         }
     }
 
+    // Destroys the sub-boxes (recursively) and gives their block back to the arena
+    auto release_subboxes() noexcept -> void
+    {
+        if (!m_fragmented)
+        {
+            return;
+        }
+        std::destroy_n(m_subboxes, s_subdivisions);
+        m_arena->release_block(std::exchange(m_subboxes, nullptr));
+        m_fragmented = false;
+    }
+
 private:
-    boundary_t m_boundary;
-
-    std::variant<std::vector<sample_t const*>, std::vector<ndbox>> m_elements;
-    std::optional<sample_t>                                        m_summary;
-    ndbox*                                                         m_parent;
-    std::size_t                                                    m_capacity;
-    bool                                                           m_fragmented = false;
-    depth_t                                                        m_max_depth;
-    depth_t                                                        m_depth;
+    boundary_t                      m_boundary;
+    boundary_t                      m_extent; // Of the samples, see refit
+    std::optional<boundary_t>       m_bounds;
+    element_buffer_t                m_elements;
+    box_t*                          m_subboxes;
+    std::optional<sample_t>         m_summary;
+    std::optional<quadrupole_t>     m_quadrupole;
+    std::optional<narrow_summary_t> m_narrow_summary;
+    ndbox*                          m_parent;
+    arena_t*                        m_arena;
+    std::size_t                     m_capacity;
+    std::size_t                     m_element_count = 0; // In the whole subtree
+    bool                            m_fragmented    = false;
+    // Summary stale, see mark_dirty. New boxes have none yet.
+    bool                            m_dirty         = true;
+    depth_t                         m_max_depth;
+    depth_t                         m_depth;
 };
 
 template <std::size_t Fanout, concepts::sample_concept Sample_Type>
@@ -620,8 +1542,12 @@ public:
     using depth_t                               = typename box_t::depth_t;
     using point_t                               = typename sample_t::position_t;
     using boundary_t                            = ndboundary<point_t>;
+    using arena_t                               = typename box_t::arena_t;
     inline static constexpr auto s_fanout       = box_t::s_fanout;
     inline static constexpr auto s_subdivisions = box_t::s_subdivisions;
+    // Levels the root may grow by, in total, before the tree is built again in the
+    // bounds of the samples. Every growth deepens the whole tree by a level.
+    inline static constexpr auto s_max_growth = std::size_t{ 4 };
 
 public:
     ndtree(
@@ -631,12 +1557,14 @@ public:
         std::optional<boundary_t> limits = std::nullopt
     ) :
         m_data_view{ collection },
+        m_arena{ std::make_unique<arena_t>(box_capacity) },
         m_box(
             limits.has_value() ? limits.value() : detail::compute_limits(collection),
             box_capacity,
             0uz,
             max_depth,
-            nullptr
+            nullptr,
+            m_arena.get()
         ),
         m_max_depth{ max_depth },
         m_capacity{ box_capacity }
@@ -649,20 +1577,132 @@ public:
         }
     }
 
+    // Builds the same tree as the serial constructor, with the limits reduced and the
+    // subtrees of large boxes built concurrently
+    ndtree(
+        std::execution::parallel_policy policy,
+        std::span<sample_t>             collection,
+        depth_t const                   max_depth,
+        size_type const                 box_capacity,
+        std::optional<boundary_t>       limits = std::nullopt
+    ) :
+        m_data_view{ collection },
+        m_arena{ std::make_unique<arena_t>(box_capacity) },
+        m_box(
+            limits.has_value() ? limits.value()
+                               : detail::compute_limits(policy, collection),
+            box_capacity,
+            0uz,
+            max_depth,
+            nullptr,
+            m_arena.get()
+        ),
+        m_max_depth{ max_depth },
+        m_capacity{ box_capacity }
+    {
+        auto samples = std::vector<sample_t const*>(std::ranges::size(collection));
+        std::ranges::transform(
+            collection, std::ranges::begin(samples), [](auto const& e) { return &e; }
+        );
+        [[maybe_unused]]
+        const auto inserted = m_box.build(samples);
+        assert(inserted == std::ranges::size(collection));
+    }
+
     [[nodiscard]]
     auto insert(sample_t const* const sp) noexcept -> bool
     {
         return m_box.insert(sp);
     }
 
+    // Relocates the samples that left their leaf, or builds the tree again when the
+    // policy finds that cheaper. Samples that left the root are not dropped, the root
+    // grows until it takes them in.
     auto reorganize() noexcept -> void
     {
-        m_box.reorganize();
+        m_reorganize_stats = reorganize_stats{ .samples = m_box.elements() };
+        m_migrated.clear();
+        m_box.collect_migration(m_reorganize_stats, m_migrated);
+        if (m_reorganize_policy.rebuild(m_reorganize_stats))
+        {
+            rebuild();
+            m_reorganize_stats.rebuilt = true;
+        }
+        else
+        {
+            // Only the leaves samples left. A leaf fragmented by the samples relocated
+            // before it keeps its escaped samples in sub-boxes, reorganize visits them.
+            for (auto* const b : m_migrated)
+            {
+                b->reorganize();
+            }
+        }
+        if (m_box.elements() != size())
+        {
+            track_escaped();
+        }
+    }
+
+    // Of the last reorganize
+    [[nodiscard]]
+    auto reorganize_statistics() const noexcept -> reorganize_stats const&
+    {
+        return m_reorganize_stats;
+    }
+
+    auto set_reorganize_policy(reorganize_policy policy) noexcept -> void
+    {
+        m_reorganize_policy = policy;
+    }
+
+    auto regroup() noexcept -> void
+    {
+        m_box.regroup();
+    }
+
+    // Summarizes every box again
+    auto cache_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        m_box.cache_summary(order);
+        m_summary_order = order;
+    }
+
+    // Summarizes the boxes along the paths changed since the last summary: inserts,
+    // relocations by reorganize, merges by regroup, and the samples touched after their
+    // position changed in place. A sample that moved without being touched keeps a stale
+    // summary unless it left its leaf. Falls back to cache_summary for a different order.
+    auto update_summary(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        if (m_summary_order != order)
+        {
+            cache_summary(order);
+            return;
+        }
+        m_box.update_summary(order);
+    }
+
+    // Summarizes every box again without moving samples between them, for positions that
+    // changed little since the last reorganize. Walks size boxes by their extent, so
+    // samples that left their box are still accounted for.
+    auto refit(MultipoleOrder order = MultipoleOrder::monopole) noexcept -> void
+    {
+        m_box.refit(order);
+        m_summary_order = order;
     }
 
-    auto cache_summary() noexcept -> void
+    // Records that the position of a sample changed, for update_summary
+    auto touch(sample_t const* const sp) noexcept -> void
     {
-        m_box.cache_summary();
+        [[maybe_unused]]
+        const auto found = m_box.touch(sp);
+    }
+
+    // After the samples were permuted in the collection, remap(sp) being the new address
+    // of the sample at sp. Boxes and summaries stay as they are.
+    template <typename Remap_Fn>
+    auto rebind(Remap_Fn const& remap) noexcept -> void
+    {
+        m_box.rebind(remap);
     }
 
     [[nodiscard]]
@@ -692,11 +1732,107 @@ public:
         return m_box;
     }
 
+    [[nodiscard]]
+    auto arena() const noexcept -> arena_t const&
+    {
+        return *m_arena;
+    }
+
 private:
-    std::span<sample_t> m_data_view;
-    box_t               m_box;
-    depth_t             m_max_depth;
-    size_type           m_capacity;
+    // In new bounds, at the depth the tree was constructed with
+    auto rebuild(boundary_t const& limits) noexcept -> void
+    {
+        m_max_depth -= static_cast<depth_t>(std::exchange(m_growth, 0uz));
+        m_box.reset(limits, m_max_depth);
+        rebuild();
+    }
+
+    // From every sample within the root, the same tree a fresh parallel construction
+    // builds in the same bounds. The storage of the old tree goes back to the arena
+    // first, and the new one is built from it.
+    auto rebuild() noexcept -> void
+    {
+        m_box.clear();
+        m_rebuild_samples.clear();
+        for (auto const& s : m_data_view)
+        {
+            if (detail::in(s.position(), m_box.boundary(), box_t::s_boundary_tol))
+            {
+                m_rebuild_samples.push_back(&s);
+            }
+        }
+        [[maybe_unused]]
+        const auto inserted = m_box.build(m_rebuild_samples);
+    }
+
+    // Every sample in the tree is within the tolerance of the root, so those outside of
+    // it are the ones that escaped, along with those that are not finite, which no root
+    // takes in and are left out. As in linear_ndtree, the root grows towards the two
+    // corners of the bounds of the finite samples, which takes all of them in, until it
+    // has grown s_max_growth levels since the tree was built in the bounds of the
+    // samples. A corner further out has the tree built in those bounds again instead.
+    auto track_escaped() noexcept -> void
+    {
+        const auto limits =
+            detail::compute_finite_limits(std::execution::par, m_data_view);
+        if (!limits.has_value())
+        {
+            return;
+        }
+        m_escaped.clear();
+        for (auto const& s : m_data_view)
+        {
+            if (detail::finite(s.position()) &&
+                !detail::in(s.position(), m_box.boundary(), box_t::s_boundary_tol))
+            {
+                m_escaped.push_back(&s);
+            }
+        }
+        for (auto const& corner : { limits->min(), limits->max() })
+        {
+            if (detail::in(corner, m_box.boundary(), box_t::s_boundary_tol))
+            {
+                continue;
+            }
+            const auto growth =
+                detail::growth_towards<s_fanout, s_max_growth>(m_box.boundary(), corner);
+            if (m_growth + growth > s_max_growth)
+            {
+                rebuild(limits.value());
+                m_reorganize_stats.rebuilt = true;
+                return;
+            }
+            for (auto i = 0uz; i != growth; ++i)
+            {
+                m_box.grow(corner);
+                ++m_max_depth;
+            }
+            m_growth += growth;
+        }
+        for (auto const* const s : m_escaped)
+        {
+            [[maybe_unused]]
+            const auto inserted = insert(s);
+        }
+    }
+
+    std::span<sample_t>           m_data_view;
+    std::unique_ptr<arena_t>      m_arena; // Must outlive m_box
+    box_t                         m_box;
+    depth_t                       m_max_depth;
+    size_type                     m_capacity;
+    // Levels the root grew by since the tree was built in the bounds of the samples
+    std::size_t                   m_growth = 0;
+    // Of the last cache_summary, none before the first one
+    std::optional<MultipoleOrder> m_summary_order;
+    reorganize_policy             m_reorganize_policy;
+    reorganize_stats              m_reorganize_stats;
+    // Leaves samples left, found by the last reorganize. Boxes never move, and nothing
+    // but regroup and rebuild frees them.
+    std::vector<box_t*>           m_migrated;
+    // Scratch for the samples a rebuild inserts, and for those track_escaped inserts
+    std::vector<sample_t const*>  m_rebuild_samples;
+    std::vector<sample_t const*>  m_escaped;
 };
 
 template <std::size_t Fanout, concepts::sample_concept Sample_Type>
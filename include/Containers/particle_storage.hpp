@@ -0,0 +1,459 @@
+#pragma once
+
+#include "particle_concepts.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <numeric>
+#include <span>
+#include <vector>
+
+// Working copies of a particle system, as the simulation engines keep them: one copy per
+// solver substage plus the current state. The engines only go through position and
+// velocity accessors per copy and index, so the layout is a template parameter.
+//
+// aos_storage keeps whole particles, one vector per copy. soa_storage keeps one array
+// per coordinate of positions and velocities in each copy, and the masses once, as no
+// engine changes them. Its arrays start on a cache line and are padded to a whole one
+// with massless particles at the origin, so packed kernels can read them directly.
+//
+// Both stage a copy into a single set of particles for the tree based engines, which
+// keep one tree over them for every copy. soa_storage stages into the particles it
+// takes its ids, masses and charges from, aos_storage into a vector of its own.
+
+namespace storage
+{
+
+namespace detail
+{
+
+inline constexpr auto s_alignment = std::size_t{ 64 };
+
+template <typename T>
+struct aligned_allocator
+{
+    using value_type = T;
+
+    aligned_allocator() noexcept = default;
+
+    template <typename U>
+    aligned_allocator(aligned_allocator<U> const&) noexcept
+    {
+    }
+
+    [[nodiscard]]
+    auto allocate(std::size_t n) -> T*
+    {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t{ s_alignment })
+        );
+    }
+
+    auto deallocate(T* p, std::size_t n) noexcept -> void
+    {
+        ::operator delete(p, n * sizeof(T), std::align_val_t{ s_alignment });
+    }
+
+    template <typename U>
+    auto operator==(aligned_allocator<U> const&) const noexcept -> bool
+    {
+        return true;
+    }
+};
+
+} // namespace detail
+
+template <typename T>
+using aligned_vector = std::vector<T, detail::aligned_allocator<T>>;
+
+// Moves the element at order[i] to i, through a copy so the buffer of values stays where
+// it is. Elements past the size of order are left alone.
+template <typename Container>
+auto permute(Container& values, std::span<std::size_t const> order) -> void
+{
+    auto permuted = std::vector<typename Container::value_type>{};
+    permuted.reserve(std::ranges::size(order));
+    for (auto const idx : order)
+    {
+        permuted.push_back(values[idx]);
+    }
+    std::ranges::copy(permuted, std::ranges::begin(values));
+}
+
+template <pm::particle_concepts::Particle Particle_Type, std::size_t Copies>
+class aos_storage
+{
+public:
+    using particle_t                         = Particle_Type;
+    using position_t                         = typename particle_t::position_t;
+    using velocity_t                         = typename particle_t::velocity_t;
+    using owning_container_t                 = std::vector<particle_t>;
+    inline static constexpr auto s_copies    = Copies;
+    inline static constexpr auto s_is_packed = false;
+
+    explicit aos_storage(std::vector<particle_t> const& particles) :
+        m_copies{ make_copies(particles) }
+    {
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    {
+        return std::ranges::size(m_copies[0]);
+    }
+
+    [[nodiscard]]
+    auto position(std::size_t copy, std::size_t idx) const noexcept -> position_t const&
+    {
+        return m_copies[copy][idx].position();
+    }
+
+    auto set_position(std::size_t copy, std::size_t idx, position_t const& value) noexcept
+        -> void
+    {
+        m_copies[copy][idx].position() = value;
+    }
+
+    [[nodiscard]]
+    auto velocity(std::size_t copy, std::size_t idx) const noexcept -> velocity_t const&
+    {
+        return m_copies[copy][idx].velocity();
+    }
+
+    auto set_velocity(std::size_t copy, std::size_t idx, velocity_t const& value) noexcept
+        -> void
+    {
+        m_copies[copy][idx].velocity() = value;
+    }
+
+    [[nodiscard]]
+    auto particle(std::size_t copy, std::size_t idx) const noexcept -> particle_t const&
+    {
+        return m_copies[copy][idx];
+    }
+
+    // The particles of a copy themselves, the tree based engines index into them
+    [[nodiscard]]
+    auto particles(std::size_t copy) noexcept -> owning_container_t&
+    {
+        return m_copies[copy];
+    }
+
+    [[nodiscard]]
+    auto particles(std::size_t copy) const noexcept -> owning_container_t const&
+    {
+        return m_copies[copy];
+    }
+
+    // Writes a copy into the staged particles, in place once they exist, so pointers
+    // into them stay valid
+    auto stage(std::size_t copy) -> owning_container_t&
+    {
+        if (std::ranges::empty(m_staged))
+        {
+            m_staged = m_copies[copy];
+        }
+        else
+        {
+            std::ranges::copy(m_copies[copy], std::ranges::begin(m_staged));
+        }
+        return m_staged;
+    }
+
+    // As stage, also listing the particles whose staged position changed
+    auto stage(std::size_t copy, std::vector<std::size_t>& moved) -> owning_container_t&
+    {
+        moved.clear();
+        if (std::ranges::empty(m_staged))
+        {
+            moved.resize(size());
+            std::iota(std::ranges::begin(moved), std::ranges::end(moved), 0uz);
+            return stage(copy);
+        }
+        for (auto idx = 0uz; idx != size(); ++idx)
+        {
+            if (m_staged[idx].position() != m_copies[copy][idx].position())
+            {
+                moved.push_back(idx);
+            }
+            m_staged[idx] = m_copies[copy][idx];
+        }
+        return m_staged;
+    }
+
+    [[nodiscard]]
+    auto staged() const noexcept -> owning_container_t const&
+    {
+        return m_staged;
+    }
+
+    // Moves the particle at order[i] to i in every copy and in the staged particles,
+    // which keep their storage
+    auto reorder(std::span<std::size_t const> order) -> void
+    {
+        for (auto& copy : m_copies)
+        {
+            permute(copy, order);
+        }
+        if (!std::ranges::empty(m_staged))
+        {
+            permute(m_staged, order);
+        }
+    }
+
+private:
+    [[nodiscard]]
+    static auto make_copies(std::vector<particle_t> const& particles)
+        -> std::array<owning_container_t, s_copies>
+    {
+        auto copies = std::array<owning_container_t, s_copies>{};
+        copies.fill(particles);
+        return copies;
+    }
+
+    std::array<owning_container_t, s_copies> m_copies;
+    owning_container_t                       m_staged;
+};
+
+template <pm::particle_concepts::Particle Particle_Type, std::size_t Copies>
+class soa_storage
+{
+public:
+    using particle_t                         = Particle_Type;
+    using value_type                         = typename particle_t::value_type;
+    using position_t                         = typename particle_t::position_t;
+    using velocity_t                         = typename particle_t::velocity_t;
+    using owning_container_t                 = std::vector<particle_t>;
+    using component_t                        = aligned_vector<value_type>;
+    inline static constexpr auto s_dimension = particle_t::s_dimension;
+    inline static constexpr auto s_copies    = Copies;
+    inline static constexpr auto s_is_packed = true;
+    // Elements per cache line, every array holds a multiple of them
+    inline static constexpr auto s_padding = detail::s_alignment / sizeof(value_type);
+
+    explicit soa_storage(std::vector<particle_t> const& particles) :
+        m_particles{ particles },
+        m_padded_size{ (std::ranges::size(particles) + s_padding - 1) / s_padding *
+                       s_padding },
+        m_masses(m_padded_size, value_type{ 0 })
+    {
+        for (auto& copy : m_copies)
+        {
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                copy.positions[i].assign(m_padded_size, value_type{ 0 });
+                copy.velocities[i].assign(m_padded_size, value_type{ 0 });
+            }
+            for (auto idx = 0uz; idx != size(); ++idx)
+            {
+                for (auto i = 0uz; i != s_dimension; ++i)
+                {
+                    copy.positions[i][idx]  = particles[idx].position()[i];
+                    copy.velocities[i][idx] = particles[idx].velocity()[i];
+                }
+            }
+        }
+        for (auto idx = 0uz; idx != size(); ++idx)
+        {
+            m_masses[idx] = particles[idx].mass().magnitude();
+        }
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    {
+        return std::ranges::size(m_particles);
+    }
+
+    [[nodiscard]]
+    auto padded_size() const noexcept -> std::size_t
+    {
+        return m_padded_size;
+    }
+
+    [[nodiscard]]
+    auto position(std::size_t copy, std::size_t idx) const noexcept -> position_t
+    {
+        auto ret = position_t{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = m_copies[copy].positions[i][idx];
+        }
+        return ret;
+    }
+
+    auto set_position(std::size_t copy, std::size_t idx, position_t const& value) noexcept
+        -> void
+    {
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            m_copies[copy].positions[i][idx] = value[i];
+        }
+    }
+
+    [[nodiscard]]
+    auto velocity(std::size_t copy, std::size_t idx) const noexcept -> velocity_t
+    {
+        auto ret = velocity_t{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = m_copies[copy].velocities[i][idx];
+        }
+        return ret;
+    }
+
+    auto set_velocity(std::size_t copy, std::size_t idx, velocity_t const& value) noexcept
+        -> void
+    {
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            m_copies[copy].velocities[i][idx] = value[i];
+        }
+    }
+
+    // A particle put together from a copy. Ids, masses and charges never change, they
+    // come from the particles the storage was built from.
+    [[nodiscard]]
+    auto particle(std::size_t copy, std::size_t idx) const noexcept -> particle_t
+    {
+        auto ret       = m_particles[idx];
+        ret.position() = position(copy, idx);
+        ret.velocity() = velocity(copy, idx);
+        return ret;
+    }
+
+    // Writes a copy into particles built from the same system, in place, so pointers
+    // into them stay valid
+    auto gather(std::size_t copy, owning_container_t& particles) const noexcept -> void
+    {
+        for (auto idx = 0uz; idx != size(); ++idx)
+        {
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                particles[idx].position()[i] = m_copies[copy].positions[i][idx];
+                particles[idx].velocity()[i] = m_copies[copy].velocities[i][idx];
+            }
+        }
+    }
+
+    [[nodiscard]]
+    auto particles(std::size_t copy) const -> owning_container_t
+    {
+        auto ret = m_particles;
+        gather(copy, ret);
+        return ret;
+    }
+
+    // The particles the storage was built from hold the staged copy, their ids, masses
+    // and charges are all that is read from them otherwise
+    auto stage(std::size_t copy) noexcept -> owning_container_t&
+    {
+        gather(copy, m_particles);
+        return m_particles;
+    }
+
+    // As stage, also listing the particles whose staged position changed
+    auto stage(std::size_t copy, std::vector<std::size_t>& moved) -> owning_container_t&
+    {
+        moved.clear();
+        for (auto idx = 0uz; idx != size(); ++idx)
+        {
+            auto& p = m_particles[idx];
+            if (p.position() != position(copy, idx))
+            {
+                moved.push_back(idx);
+            }
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                p.position()[i] = m_copies[copy].positions[i][idx];
+                p.velocity()[i] = m_copies[copy].velocities[i][idx];
+            }
+        }
+        return m_particles;
+    }
+
+    [[nodiscard]]
+    auto staged() const noexcept -> owning_container_t const&
+    {
+        return m_particles;
+    }
+
+    // Moves the particle at order[i] to i in every copy, the masses and the staged
+    // particles, which keep their storage. The padding stays massless at the origin.
+    auto reorder(std::span<std::size_t const> order) -> void
+    {
+        for (auto& copy : m_copies)
+        {
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                permute(copy.positions[i], order);
+                permute(copy.velocities[i], order);
+            }
+        }
+        permute(m_masses, order);
+        permute(m_particles, order);
+    }
+
+    // One span per coordinate, over the padded arrays
+    [[nodiscard]]
+    auto positions(std::size_t copy) const noexcept
+        -> std::array<std::span<value_type const>, s_dimension>
+    {
+        return spans<value_type const>(m_copies[copy].positions);
+    }
+
+    [[nodiscard]]
+    auto positions(std::size_t copy) noexcept
+        -> std::array<std::span<value_type>, s_dimension>
+    {
+        return spans<value_type>(m_copies[copy].positions);
+    }
+
+    [[nodiscard]]
+    auto velocities(std::size_t copy) const noexcept
+        -> std::array<std::span<value_type const>, s_dimension>
+    {
+        return spans<value_type const>(m_copies[copy].velocities);
+    }
+
+    [[nodiscard]]
+    auto velocities(std::size_t copy) noexcept
+        -> std::array<std::span<value_type>, s_dimension>
+    {
+        return spans<value_type>(m_copies[copy].velocities);
+    }
+
+    [[nodiscard]]
+    auto masses() const noexcept -> std::span<value_type const>
+    {
+        return m_masses;
+    }
+
+private:
+    struct copy_t
+    {
+        std::array<component_t, s_dimension> positions;
+        std::array<component_t, s_dimension> velocities;
+    };
+
+    template <typename T, typename Components>
+    [[nodiscard]]
+    static auto spans(Components& components) noexcept
+        -> std::array<std::span<T>, s_dimension>
+    {
+        auto ret = std::array<std::span<T>, s_dimension>{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = components[i];
+        }
+        return ret;
+    }
+
+    owning_container_t           m_particles;
+    std::size_t                  m_padded_size;
+    component_t                  m_masses;
+    std::array<copy_t, s_copies> m_copies;
+};
+
+} // namespace storage
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "ndtree.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+// Keys of points along a space filling curve over a boundary subdivided into 2^Levels
+// cells per dimension, and the radix sort that orders samples by them. Points close on
+// the curve are close in space. The Hilbert curve only ever steps to an adjacent cell,
+// the Morton (Z-order) curve jumps at the boundaries of its quadrants but is cheaper to
+// compute and is the order of the boxes of linear_ndtree.
+
+namespace ndt
+{
+
+enum struct SpaceFillingCurve
+{
+    morton,
+    hilbert
+};
+
+namespace detail
+{
+
+template <typename Value_Type>
+struct morton_keyed
+{
+    std::uint64_t key;
+    Value_Type    value;
+};
+
+// LSD radix sort on the lowest Key_Bits bits of the keys, one byte per pass. Passes in
+// which every key has the same digit are skipped. Stable, as the build relies on it for
+// reproducible leaves.
+template <std::size_t Key_Bits, typename Value_Type>
+auto radix_sort(
+    std::vector<morton_keyed<Value_Type>>& data,
+    std::vector<morton_keyed<Value_Type>>& scratch
+) noexcept -> void
+{
+    static constexpr auto s_digit_bits = 8uz;
+    static constexpr auto s_radix      = 1uz << s_digit_bits;
+    static constexpr auto s_passes     = (Key_Bits + s_digit_bits - 1) / s_digit_bits;
+    scratch.resize(std::ranges::size(data));
+    for (auto pass = 0uz; pass != s_passes; ++pass)
+    {
+        const auto shift = pass * s_digit_bits;
+        auto       count = std::array<std::size_t, s_radix>{};
+        for (auto const& e : data)
+        {
+            ++count[(e.key >> shift) & (s_radix - 1)];
+        }
+        if (std::ranges::find(count, std::ranges::size(data)) != std::ranges::end(count))
+        {
+            continue;
+        }
+        auto offset = 0uz;
+        for (auto& c : count)
+        {
+            offset = std::exchange(c, offset) + offset;
+        }
+        for (auto const& e : data)
+        {
+            scratch[count[(e.key >> shift) & (s_radix - 1)]++] = e;
+        }
+        std::swap(data, scratch);
+    }
+}
+
+} // namespace detail
+
+namespace sfc
+{
+
+using key_t = std::uint64_t;
+
+// Levels of subdivision a 64 bit key can encode in Dimension dimensions, leaving the top
+// bit free so a cell count always fits
+template <std::size_t Dimension>
+inline constexpr auto s_key_levels =
+    static_cast<unsigned>((std::numeric_limits<key_t>::digits - 1) / Dimension);
+
+template <std::size_t Dimension>
+using cells_t = std::array<key_t, Dimension>;
+
+// Cell of the point along every dimension. Points outside of the boundary take the
+// nearest cell.
+template <unsigned Levels, concepts::Point Point_Type>
+[[nodiscard]]
+auto cells(Point_Type const& p, ndboundary<Point_Type> const& boundary) noexcept
+    -> cells_t<Point_Type::s_dimension>
+{
+    using value_type              = typename Point_Type::value_type;
+    static constexpr auto s_cells = key_t{ 1 } << Levels;
+    auto                  ret     = cells_t<Point_Type::s_dimension>{};
+    for (auto i = 0uz; i != Point_Type::s_dimension; ++i)
+    {
+        const auto extent = boundary.max(i) - boundary.min(i);
+        const auto x      = extent > value_type{ 0 } ? (p[i] - boundary.min(i)) / extent
+                                                     : value_type{ 0 };
+        ret[i] = static_cast<key_t>(std::clamp(
+            std::floor(x * static_cast<value_type>(s_cells)),
+            value_type{ 0 },
+            static_cast<value_type>(s_cells - 1)
+        ));
+    }
+    return ret;
+}
+
+// Bit l of the cell along dimension i is bit l * Dimension + i of the key
+template <unsigned Levels, std::size_t Dimension>
+[[nodiscard]]
+constexpr auto morton_key(cells_t<Dimension> const& cells) noexcept -> key_t
+{
+    auto key = key_t{ 0 };
+    for (auto i = 0uz; i != Dimension; ++i)
+    {
+        for (auto level = 0u; level != Levels; ++level)
+        {
+            key |= ((cells[i] >> level) & key_t{ 1 }) << (level * Dimension + i);
+        }
+    }
+    return key;
+}
+
+// Skilling's transform (Programming the Hilbert curve, 2004): the cells are rotated and
+// reflected level by level into the transposed Hilbert index, whose bits are then
+// interleaved as in a Morton key
+template <unsigned Levels, std::size_t Dimension>
+[[nodiscard]]
+constexpr auto hilbert_key(cells_t<Dimension> x) noexcept -> key_t
+{
+    static constexpr auto s_top = key_t{ 1 } << (Levels - 1);
+    for (auto q = s_top; q > 1; q >>= 1)
+    {
+        const auto p = q - 1;
+        for (auto i = 0uz; i != Dimension; ++i)
+        {
+            if ((x[i] & q) != 0)
+            {
+                x[0] ^= p;
+            }
+            else
+            {
+                const auto t  = (x[0] ^ x[i]) & p;
+                x[0]         ^= t;
+                x[i]         ^= t;
+            }
+        }
+    }
+    for (auto i = 1uz; i != Dimension; ++i)
+    {
+        x[i] ^= x[i - 1];
+    }
+    auto t = key_t{ 0 };
+    for (auto q = s_top; q > 1; q >>= 1)
+    {
+        if ((x[Dimension - 1] & q) != 0)
+        {
+            t ^= q - 1;
+        }
+    }
+    auto key = key_t{ 0 };
+    for (auto level = Levels; level-- != 0;)
+    {
+        for (auto i = 0uz; i != Dimension; ++i)
+        {
+            key = (key << 1) | (((x[i] ^ t) >> level) & key_t{ 1 });
+        }
+    }
+    return key;
+}
+
+template <concepts::Point Point_Type>
+[[nodiscard]]
+auto key(
+    SpaceFillingCurve             curve,
+    Point_Type const&             p,
+    ndboundary<Point_Type> const& boundary
+) noexcept -> key_t
+{
+    static constexpr auto s_dimension = Point_Type::s_dimension;
+    static constexpr auto s_levels    = s_key_levels<s_dimension>;
+    const auto            c           = cells<s_levels>(p, boundary);
+    switch (curve)
+    {
+    case SpaceFillingCurve::morton: return morton_key<s_levels, s_dimension>(c);
+    case SpaceFillingCurve::hilbert: return hilbert_key<s_levels, s_dimension>(c);
+    default: utility::error_handling::assert_unreachable();
+    }
+}
+
+// Indices 0 to size in the order the curve visits the positions, left in the values of
+// keyed. The keys are computed concurrently, position(idx) is called once per index.
+template <concepts::Point Point_Type, typename Position_Fn>
+auto sort(
+    SpaceFillingCurve                                curve,
+    std::size_t                                      size,
+    Position_Fn&&                                    position,
+    ndboundary<Point_Type> const&                    boundary,
+    std::vector<detail::morton_keyed<std::size_t>>& keyed,
+    std::vector<detail::morton_keyed<std::size_t>>& scratch
+) -> void
+{
+    static constexpr auto s_dimension = Point_Type::s_dimension;
+    static constexpr auto s_grain     = std::size_t{ 4096 };
+    keyed.resize(size);
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>(0, size, s_grain),
+        [&](tbb::blocked_range<std::size_t> const& r) {
+            for (auto idx = r.begin(); idx != r.end(); ++idx)
+            {
+                keyed[idx] = { key<Point_Type>(curve, position(idx), boundary), idx };
+            }
+        }
+    );
+    detail::radix_sort<s_key_levels<s_dimension> * s_dimension>(keyed, scratch);
+}
+
+} // namespace sfc
+
+} // namespace ndt
@@ -3,6 +3,7 @@
 #include "concepts.hpp"
 #include "particle_concepts.hpp"
 #include "physical_magnitudes.hpp"
+#include <array>
 #include <optional>
 #include <ranges>
 #include <sstream>
@@ -231,6 +232,162 @@ auto merge(std::ranges::input_range auto&& particles) noexcept
     );
 }
 
+// Running mass, center of mass and mean velocity of a set of particles, without ranges
+// or temporaries. It gives the same center of mass as merge up to rounding, as it sums
+// moments and divides once where merge weighs every particle by its mass fraction. A
+// single particle is returned as is, keeping its id.
+template <std::size_t N, std::floating_point F>
+class center_of_mass_accumulator
+{
+public:
+    using particle_t = ndparticle<N, F>;
+    using value_type = F;
+    using mass_t     = typename particle_t::mass_t;
+    using position_t = typename particle_t::position_t;
+    using velocity_t = typename particle_t::velocity_t;
+
+    // The particle has to outlive the accumulator
+    constexpr auto add(particle_t const& p) noexcept -> void
+    {
+        if (m_count++ == 0)
+        {
+            m_first = &p;
+        }
+        const auto m = p.mass().magnitude();
+        m_mass += m;
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            m_moment[i] += m * p.position()[i];
+            m_momentum[i] += m * p.velocity()[i];
+        }
+    }
+
+    [[nodiscard]]
+    constexpr auto result() const noexcept -> std::optional<particle_t>
+    {
+        if (m_count == 0)
+        {
+            return std::nullopt;
+        }
+        else if (m_count == 1)
+        {
+            return *m_first;
+        }
+        position_t position{};
+        velocity_t velocity{};
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            position[i] = m_moment[i] / m_mass;
+            velocity[i] = m_momentum[i] / m_mass;
+        }
+        return particle_t(mass_t{ m_mass }, position, velocity, ParticleType::fictitious);
+    }
+
+private:
+    particle_t const*         m_first = nullptr;
+    std::size_t               m_count = 0;
+    value_type                m_mass{};
+    std::array<value_type, N> m_moment{};
+    std::array<value_type, N> m_momentum{};
+};
+
+// Found through ADL by containers that summarize particles
+template <std::size_t N, std::floating_point F>
+[[nodiscard]]
+constexpr auto merge_accumulator(ndparticle<N, F> const&) noexcept
+    -> center_of_mass_accumulator<N, F>
+{
+    return {};
+}
+
+// Traceless quadrupole moment, Q_ij = sum m (3 x_i x_j - |x|^2 delta_ij), of a set of
+// point masses at offsets x from a center. Moments about the same center add up.
+template <std::size_t N, std::floating_point F>
+class quadrupole_moment
+{
+public:
+    using value_type = F;
+
+    constexpr auto add(value_type m, std::array<value_type, N> const& x) noexcept -> void
+    {
+        auto x_sq = value_type{ 0 };
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            x_sq += x[i] * x[i];
+        }
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            for (std::size_t j = 0; j != N; ++j)
+            {
+                const auto trace = i == j ? x_sq : value_type{ 0 };
+                m_q[i][j] += m * (value_type{ 3 } * x[i] * x[j] - trace);
+            }
+        }
+    }
+
+    constexpr auto operator+=(quadrupole_moment const& other) noexcept
+        -> quadrupole_moment&
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            for (std::size_t j = 0; j != N; ++j)
+            {
+                m_q[i][j] += other.m_q[i][j];
+            }
+        }
+        return *this;
+    }
+
+    [[nodiscard]]
+    constexpr auto operator()(std::size_t i, std::size_t j) const noexcept -> value_type
+    {
+        return m_q[i][j];
+    }
+
+private:
+    std::array<std::array<value_type, N>, N> m_q{};
+};
+
+// Found through ADL by containers that cache multipole moments, the moment of a single
+// particle about center
+template <std::size_t N, std::floating_point F>
+[[nodiscard]]
+constexpr auto quadrupole_contribution(
+    ndparticle<N, F> const&                      p,
+    typename ndparticle<N, F>::position_t const& center
+) noexcept -> quadrupole_moment<N, F>
+{
+    auto x = std::array<F, N>{};
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        x[i] = p.position()[i] - center[i];
+    }
+    auto q = quadrupole_moment<N, F>{};
+    q.add(p.mass().magnitude(), x);
+    return q;
+}
+
+// Position and mass of a particle in single precision
+template <std::size_t N>
+struct float_monopole
+{
+    std::array<float, N> position{};
+    float                mass{};
+};
+
+// Found through ADL by containers that also cache their summaries in a narrower type
+template <std::size_t N, std::floating_point F>
+[[nodiscard]]
+constexpr auto narrow_monopole(ndparticle<N, F> const& p) noexcept -> float_monopole<N>
+{
+    auto m = float_monopole<N>{ .mass = static_cast<float>(p.mass().magnitude()) };
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        m.position[i] = static_cast<float>(p.position()[i]);
+    }
+    return m;
+}
+
 template <std::size_t N, std::floating_point F>
 auto operator<<(std::ostream& os, ndparticle<N, F> pp) noexcept -> std::ostream&
 {
@@ -3,7 +3,10 @@
 #include "particle_concepts.hpp"
 #include "physical_constants.hpp"
 #include "physical_magnitudes.hpp"
+#include "simd_math.hpp"
 #include "utils.hpp"
+#include <array>
+#include <utility>
 
 #ifndef DEBUG_PRINT_INTERACTION
 #define DEBUG_PRINT_INTERACTION (false)
@@ -29,6 +32,8 @@ struct gravitational_interaction
     using acceleration_t                            = typename particle_t::acceleration_t;
     using position_t                                = typename particle_t::position_t;
     using mass_t                                    = typename particle_t::mass_t;
+    using gradient_t = std::array<std::array<value_type, particle_t::s_dimension>,
+                                  particle_t::s_dimension>;
 
     inline static constexpr auto epsilon = static_cast<value_type>(4.5e-1);
 
@@ -43,6 +48,96 @@ struct gravitational_interaction
                                 b.mass().magnitude() / (d * d * d + epsilon)) *
                                distance };
     }
+
+    // G m / (d^3 + epsilon), the acceleration per unit of separation that a mass causes
+    // at squared distance d_sq. Works on scalars and on SIMD packs alike, for kernels
+    // that keep positions and masses in separate arrays, also in a narrower type than
+    // value_type.
+    template <typename T>
+    inline static auto acceleration_scale(T const& d_sq, T const& mass) noexcept -> T
+    {
+        namespace sm    = utility::simd_math;
+        using element_t = sm::element_t<T>;
+        return T(static_cast<element_t>(pm::physical_parameters<value_type>::G)) * mass *
+               sm::reciprocal(d_sq * sm::sqrt(d_sq) + T(static_cast<element_t>(epsilon)));
+    }
+
+    // Both halves of the pair at once, the acceleration of a due to b and of b due to a.
+    // The kernel is shared and only the masses differ.
+    inline static auto pair_contribution(
+        particle_t const& a,
+        particle_t const& b
+    ) noexcept -> std::pair<acceleration_t, acceleration_t>
+    {
+        const auto distance = utils::distance(a.position(), b.position());
+        const auto d        = utils::l2_norm(distance.value());
+        const auto scale = pm::physical_parameters<value_type>::G / (d * d * d + epsilon);
+        return { acceleration_t{ (scale * b.mass().magnitude()) * distance },
+                 acceleration_t{ (-scale * a.mass().magnitude()) * distance } };
+    }
+
+    // Field of a far cell with center of mass b and traceless quadrupole moment q about
+    // it, q(i, j) = sum m (3 x_i x_j - |x|^2 delta_ij). Only the monopole is softened,
+    // cells are far from a by the time they are accepted.
+    template <typename Quadrupole_Type>
+    inline static auto far_field_contribution(
+        particle_t const&      a,
+        particle_t const&      b,
+        Quadrupole_Type const& q
+    ) noexcept -> acceleration_t
+    {
+        constexpr auto N        = particle_t::s_dimension;
+        const auto     distance = utils::distance(a.position(), b.position());
+        const auto     d_sq     = utils::l2_norm_sq(distance.value());
+        const auto     d        = std::sqrt(d_sq);
+        const auto     d_5      = d_sq * d_sq * d;
+        auto           qd       = std::array<value_type, N>{};
+        auto           dqd      = value_type{ 0 };
+        for (auto i = decltype(N){ 0 }; i != N; ++i)
+        {
+            for (auto j = decltype(N){ 0 }; j != N; ++j)
+            {
+                qd[i] += q(i, j) * distance[j];
+            }
+            dqd += distance[i] * qd[i];
+        }
+        const auto G      = pm::physical_parameters<value_type>::G;
+        const auto radial = G * (b.mass().magnitude() / (d * d * d + epsilon) +
+                                 value_type{ 2.5 } * dqd / (d_5 * d_sq));
+        auto       acc    = acceleration_t{ radial * distance };
+        for (auto i = decltype(N){ 0 }; i != N; ++i)
+        {
+            acc[i] -= G / d_5 * qd[i];
+        }
+        return acc;
+    }
+
+    // Jacobian of the acceleration that b causes at a with respect to the position of a,
+    // d acc_i / d x_j. Not softened, like the far field.
+    inline static auto acceleration_gradient(
+        particle_t const& a,
+        particle_t const& b
+    ) noexcept -> gradient_t
+    {
+        constexpr auto N        = particle_t::s_dimension;
+        const auto     distance = utils::distance(a.position(), b.position());
+        const auto     d_sq     = utils::l2_norm_sq(distance.value());
+        const auto     d_3      = d_sq * std::sqrt(d_sq);
+        const auto     G        = pm::physical_parameters<value_type>::G;
+        const auto     gm       = G * b.mass().magnitude();
+        auto           gradient = gradient_t{};
+        for (auto i = decltype(N){ 0 }; i != N; ++i)
+        {
+            for (auto j = decltype(N){ 0 }; j != N; ++j)
+            {
+                const auto diagonal = i == j ? value_type{ 1 } : value_type{ 0 };
+                gradient[i][j] =
+                    gm * (value_type{ 3 } * distance[i] * distance[j] / (d_3 * d_sq) -
+                          diagonal / d_3);
+            }
+        }
+        return gradient;
+    }
 };
 
 template <Particle Particle_Type>
@@ -70,6 +165,20 @@ struct electrostatic_interaction
                                 a.mass().magnitude() / (d * d * d + epsilon)) /
                                distance };
     }
+
+    // Both halves of the pair at once, the acceleration of a due to b and of b due to a
+    inline static auto pair_contribution(
+        particle_t const& a,
+        particle_t const& b
+    ) noexcept -> std::pair<acceleration_t, acceleration_t>
+    {
+        const auto distance = utils::distance(a.position(), b.position());
+        const auto d        = utils::l2_norm(distance.value());
+        const auto k = pm::physical_constants_<value_type>::K * b.charge().magnitude() *
+                       a.charge().magnitude() / (d * d * d + epsilon);
+        return { acceleration_t{ (k / a.mass().magnitude()) / distance },
+                 acceleration_t{ (-k / b.mass().magnitude()) / distance } };
+    }
 };
 
 namespace detail
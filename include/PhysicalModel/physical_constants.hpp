@@ -1,6 +1,7 @@
 #pragma once
 
 #include <concepts>
+#include <limits>
 
 namespace pm
 {
@@ -8,10 +9,11 @@ namespace pm
 template <std::floating_point F>
 struct physical_constants_
 {
-    // Only for small ones, improve check
-    static_assert(std::is_same_v<F, double>);
     inline static constexpr auto G = static_cast<F>(6.6743e-11);
     inline static constexpr auto K = static_cast<F>(8.987551787e9);
+    // The constants have to be normal numbers of F, as they are in float and double
+    static_assert(G >= std::numeric_limits<F>::min());
+    static_assert(K <= std::numeric_limits<F>::max());
 };
 
 template <std::floating_point F>
@@ -1,20 +1,39 @@
 #pragma once
 
-#include "compile_time_utility.hpp"
+#include "block_leapfrog.hpp"
 #include "concepts.hpp"
 #include "generics.hpp"
+#include "linear_ndtree.hpp"
 #include "ndtree.hpp"
+#include "opening_criteria.hpp"
 #include "particle_concepts.hpp"
 #include "particle_interaction.hpp"
+#include "particle_storage.hpp"
 #include "physical_magnitudes.hpp"
 #include "simulation_config.hpp"
+#include "space_filling_curve.hpp"
 #include "utils.hpp"
 #include "yoshida.hpp"
-#include <atomic>
+#include <algorithm>
+#include <array>
 #include <bits/ranges_algo.h>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <experimental/simd>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <deque>
 #include <vector>
 #ifdef USE_ROOT_PLOTTING
 #include "scatter_plot_3D.hpp"
@@ -34,15 +53,24 @@ template <
     pm::particle_concepts::Particle  Particle_Type,
     pm::interaction::InteractionType Interaction_Type,
     // typename Solver_Type,
-    std::size_t Tree_Fanout = 2>
+    std::size_t Tree_Fanout = 2,
+    // Either ndt::ndtree or ndt::linear_ndtree
+    typename Tree_Type = ndt::ndtree<Tree_Fanout, Particle_Type>,
+    // Either storage::soa_storage or storage::aos_storage
+    template <typename, std::size_t> typename Storage_Type = storage::soa_storage,
+    // One of the criteria in opening_criteria.hpp
+    typename Opening_Criterion = opening::geometric>
 class barnes_hut_approximation
 {
 public:
     using particle_t                           = Particle_Type;
-    inline static constexpr auto s_tree_fanout = Tree_Fanout;
-    using tree_t                               = ndt::ndtree<s_tree_fanout, particle_t>;
+    using tree_t                               = Tree_Type;
+    inline static constexpr auto s_tree_fanout = tree_t::s_fanout;
+    static_assert(s_tree_fanout == Tree_Fanout);
     using box_t                                = typename tree_t::box_t;
     using solver_t      = solvers::yoshida4_solver<barnes_hut_approximation, particle_t>;
+    using block_solver_t =
+        solvers::block_leapfrog_solver<barnes_hut_approximation, particle_t>;
     using interaction_t = particle_interaction_t<particle_t, Interaction_Type>;
     static_assert(pm::particle_concepts::Interaction<interaction_t>);
     using depth_t                                 = typename tree_t::depth_t;
@@ -55,7 +83,40 @@ public:
     using mass_t                                  = typename particle_t::mass_t;
     using duration_t                              = std::chrono::duration<value_type>;
     using owning_container_t                      = std::vector<particle_t>;
+    using walk_stack_t                            = std::vector<box_t const*>;
+    using traversal_t                             = simulation::config::TraversalType;
+    using opening_criterion_t                     = Opening_Criterion;
+    using keyed_index_t = ndt::detail::morton_keyed<std::size_t>;
+    inline static constexpr auto s_dimension      = particle_t::s_dimension;
+    // Whether the tree caches quadrupoles and the interaction has a kernel for them
+    inline static constexpr auto s_quadrupole_support =
+        requires(box_t const& b, particle_t const& p) {
+            interaction_t::far_field_contribution(p, p, b.quadrupole().value());
+        };
+    // Whether the interaction can carry the field of a cell across a target cell
+    inline static constexpr auto s_gradient_support =
+        requires(particle_t const& p) { interaction_t::acceleration_gradient(p, p); };
+    // Whether the opening criterion reads the previous acceleration of the targets
+    inline static constexpr auto s_keeps_acceleration =
+        opening_criterion_t::s_uses_acceleration;
+    // Type and packs of the far field in mixed precision, and whether the interaction
+    // kernel runs on them and the tree caches the summaries in that type
+    using shadow_t      = float;
+    using shadow_simd_t = std::experimental::native_simd<shadow_t>;
+    inline static constexpr auto s_mixed_precision_support =
+        requires(shadow_simd_t const& v, box_t const& b) {
+            interaction_t::acceleration_scale(v, v);
+            { b.narrow_summary().value().mass } -> std::convertible_to<shadow_t>;
+            { b.narrow_summary().value().position[0] } -> std::convertible_to<shadow_t>;
+        };
     inline static constexpr auto s_working_copies = solver_t::s_working_copies;
+    using storage_t = Storage_Type<particle_t, s_working_copies + 1>;
+    // Targets holding at least these many particles pass their cells to the sub-boxes
+    // as separate tasks in the dual walk
+    inline static constexpr auto s_dual_parallel_grain = std::size_t{ 2048 };
+    // With up to one particle in these many moved, only the paths to their leaves are
+    // summarized again. Above it the parallel pass over the whole tree is cheaper.
+    inline static constexpr auto s_partial_summary_ratio = std::size_t{ 8 };
     inline static constexpr auto s_theta_range =
         utility::generics::interval{ value_type{ 0 }, value_type{ 1 } };
 
@@ -76,25 +137,59 @@ public:
             std::chrono::duration_cast<duration_t>(base_config.duration_)
         },
         m_dt{ std::chrono::duration_cast<duration_t>(base_config.dt_) },
-        m_particles{
-            utility::compile_time_utility::array_factory<s_working_copies + 1>(particles)
-        },
-        m_ndtrees{ utility::compile_time_utility::array_factory<s_working_copies>(
-            [this, specific_config, tree_bounds](std::size_t I) -> tree_t {
-                return tree_t(
-                    m_particles[I],
-                    specific_config.tree_max_depth_,
-                    specific_config.tree_box_capacity_,
-                    tree_bounds
-                );
-            }
+        m_particles{ particles },
+        m_ndtree{ make_tree(
+            m_particles.stage(s_working_copies),
+            specific_config.tree_max_depth_,
+            specific_config.tree_box_capacity_,
+            tree_bounds
         ) },
-        m_simulation_size{ std::ranges::size(current_system_state()) },
+        m_simulation_size{ m_particles.size() },
         m_solver(this, m_simulation_size, m_dt),
-        m_theta_sq{ std::pow(specific_config.theta_, value_type{ 2 }), s_theta_range }
+        m_theta_sq{ std::pow(specific_config.theta_, value_type{ 2 }), s_theta_range },
+        m_tree_regroup{ specific_config.tree_regroup_ },
+        m_tree_refit{ specific_config.tree_refit_ },
+        m_traversal{ specific_config.traversal_ },
+        m_mixed_precision{ s_mixed_precision_support &&
+                           specific_config.mixed_precision_ },
+        m_multipole_order{ specific_config.quadrupole_ ? ndt::MultipoleOrder::quadrupole
+                                                       : ndt::MultipoleOrder::monopole },
+        m_reorder_interval{ specific_config.reorder_interval_ },
+        m_reorder_curve{ reorder_curve(specific_config.reorder_curve_) }
     {
         assert(m_dt > duration_t{ 0 });
         assert(m_simulation_duration > duration_t{ 0 });
+        // The shadow cells only carry monopoles, see barnes_hut_specific_config::is_valid
+        assert(!m_mixed_precision || m_multipole_order == ndt::MultipoleOrder::monopole);
+        m_original_index.resize(m_simulation_size);
+        std::iota(
+            std::ranges::begin(m_original_index), std::ranges::end(m_original_index), 0uz
+        );
+        if constexpr (s_keeps_acceleration)
+        {
+            m_acceleration_norms.assign(m_simulation_size, value_type{ 0 });
+        }
+        // linear_ndtree is rebuilt on every reorganize, there is nothing to choose
+        if constexpr (requires { m_ndtree.set_reorganize_policy({}); })
+        {
+            m_ndtree.set_reorganize_policy(
+                { .mode            = reorganize_mode(specific_config.tree_reorganize_),
+                  .relocation_cost = static_cast<double>(
+                      specific_config.tree_relocation_cost_
+                  ) }
+            );
+        }
+        if (base_config.timestep_bins_ > 0)
+        {
+            m_block_solver.emplace(
+                this,
+                m_simulation_size,
+                m_dt,
+                base_config.timestep_bins_,
+                base_config.timestep_accuracy_,
+                std::cbrt(interaction_t::epsilon)
+            );
+        }
     }
 
     auto run() noexcept -> void
@@ -106,11 +201,10 @@ public:
         data[0].resize(m_simulation_size);
         plotting::plots_3D::scatter_plot_3D scatter_plot(data);
 #endif
-        m_ndtrees[0].cache_summary();
+        m_ndtree.cache_summary(m_multipole_order);
         while (m_current_time < m_simulation_duration)
         {
-            m_solver.run();
-            m_current_time += m_dt;
+            step();
 #if MEASURE_ENERGY
             if (utility::random::srandom::randfloat<float>() < 0.02f)
             {
@@ -132,7 +226,7 @@ public:
             filename << "execution_data_" << m_current_time;
             if (utility::random::srandom::randfloat<float>() < 0.01f)
             {
-                logger::csv::write_to_csv(m_particles[s_working_copies], filename.str());
+                logger::csv::write_to_csv(current_system_state(), filename.str());
             }
 #endif
 #ifdef USE_ROOT_PLOTTING
@@ -141,14 +235,11 @@ public:
                 for (auto j = decltype(m_simulation_size){}; j != m_simulation_size; ++j)
                 {
                     data[0][j].x =
-                        static_cast<float>(m_particles[s_working_copies][j].position()[0]
-                        );
+                        static_cast<float>(m_particles.position(s_working_copies, j)[0]);
                     data[0][j].y =
-                        static_cast<float>(m_particles[s_working_copies][j].position()[1]
-                        );
+                        static_cast<float>(m_particles.position(s_working_copies, j)[1]);
                     data[0][j].z =
-                        static_cast<float>(m_particles[s_working_copies][j].position()[2]
-                        );
+                        static_cast<float>(m_particles.position(s_working_copies, j)[2]);
                 }
                 scatter_plot.render();
                 m_prev_plot_time = m_current_time;
@@ -157,103 +248,257 @@ public:
         }
     }
 
-    auto get_acceleration(size_type copy_idx, std::size_t p_idx) noexcept
-        -> acceleration_t
+    auto step() noexcept -> void
+    {
+        if (m_reorder_interval != 0 && m_steps % m_reorder_interval == 0)
+        {
+            reorder();
+        }
+        ++m_steps;
+        m_reorganize_tree = true;
+        if (m_block_solver.has_value())
+        {
+            m_block_solver->run();
+        }
+        else
+        {
+            m_solver.run();
+        }
+        m_current_time += m_dt;
+    }
+
+    // Sorts the particles along the reorder curve over the root of the tree, in every
+    // working copy, so particles close in space are close in memory. The tree keeps its
+    // boxes and summaries, its samples are pointed at their new slots. Ids move with the
+    // particles, original_index tells where each one started.
+    auto reorder() -> void
     {
-        return get_box_contribution(
-            m_particles[copy_idx][p_idx], m_ndtrees[copy_idx].box()
+        ndt::sfc::sort<position_t>(
+            m_reorder_curve,
+            m_simulation_size,
+            [this](std::size_t p_idx) { return position_read(p_idx); },
+            m_ndtree.box().boundary(),
+            m_reorder_keys,
+            m_reorder_scratch
+        );
+        m_order.resize(m_simulation_size);
+        std::ranges::transform(
+            m_reorder_keys, std::ranges::begin(m_order), &keyed_index_t::value
         );
+        // Slot every particle moves to, for the tree
+        m_reorder_slots.resize(m_simulation_size);
+        for (auto p_idx = 0uz; p_idx != m_simulation_size; ++p_idx)
+        {
+            m_reorder_slots[m_order[p_idx]] = p_idx;
+        }
+        m_particles.reorder(m_order);
+        auto const* const base = m_particles.staged().data();
+        m_ndtree.rebind([this, base](particle_t const* p) {
+            return base + m_reorder_slots[static_cast<std::size_t>(p - base)];
+        });
+        storage::permute(m_original_index, m_order);
+        if constexpr (s_keeps_acceleration)
+        {
+            storage::permute(m_acceleration_norms, m_order);
+        }
+        if (m_block_solver.has_value())
+        {
+            m_block_solver->reorder(m_order);
+        }
     }
 
+    // Index in the particles the engine was built from of the one now at p_idx
     [[nodiscard]]
-    auto get_box_contribution(particle_t const& p, box_t const& b) const -> acceleration_t
+    auto original_index(std::size_t p_idx) const noexcept -> std::size_t
     {
-        if (!b.summary().has_value() || b.summary().value().id() == p.id())
+        return m_original_index[p_idx];
+    }
+
+    // The current state in the order of the particles the engine was built from, for
+    // output that has to line up across steps
+    [[nodiscard]]
+    auto current_system_state_in_original_order() const -> owning_container_t
+    {
+        auto ret = owning_container_t(current_system_state());
+        for (auto p_idx = 0uz; p_idx != m_simulation_size; ++p_idx)
         {
-            return acceleration_t{};
+            ret[m_original_index[p_idx]] = m_particles.particle(s_working_copies, p_idx);
         }
-        auto const summary = b.summary().value();
-        const auto s       = pm::utils::l2_norm_sq(b.diagonal_length().value());
-        const auto d       = pm::utils::l2_norm_sq(
-            pm::utils::distance(p.position(), summary.position()).value()
-        );
-        if ((s / d) < m_theta_sq.get())
+        return ret;
+    }
+
+    // Of the working copy committed last, the only one the tree holds
+    auto get_acceleration(size_type, std::size_t p_idx) noexcept -> acceleration_t
+    {
+        // Particles outside of the tree bounds belong to no box and are walked alone
+        const auto acc =
+            m_traversal != traversal_t::particle && m_grouped[p_idx]
+                ? m_group_accelerations[p_idx]
+                : get_box_contribution(
+                      m_particles.staged()[p_idx],
+                      m_ndtree.box(),
+                      m_f_eval_count.local(),
+                      m_walk_stacks.local(),
+                      previous_acceleration(p_idx)
+                  );
+        if constexpr (s_keeps_acceleration)
         {
-            ++m_f_eval_count;
-            return interaction_t::acceleration_contribution(p, summary);
+            m_acceleration_norms[p_idx] = pm::utils::l2_norm(acc.value());
         }
-        else
+        return acc;
+    }
+
+    [[nodiscard]]
+    auto get_box_contribution(particle_t const& p, box_t const& b) const -> acceleration_t
+    {
+        return get_box_contribution(p, b, m_f_eval_count.local(), m_walk_stacks.local());
+    }
+
+    // Depth first walk over an explicit stack of boxes. Particles and summaries are only
+    // read through references, the walk reads positions and masses and nothing is
+    // copied. f_evals and stack belong to the calling thread, they are looked up once
+    // per walk instead of once per interaction. acc_old is the magnitude of the
+    // previous acceleration of p, for the opening criterion.
+    [[nodiscard]]
+    auto get_box_contribution(
+        particle_t const& p,
+        box_t const&      b,
+        std::size_t&      f_evals,
+        walk_stack_t&     stack,
+        value_type        acc_old = value_type{ 0 }
+    ) const -> acceleration_t
+    {
+        auto acc = acceleration_t{};
+        stack.clear();
+        stack.push_back(&b);
+        while (!stack.empty())
         {
-            if (b.fragmented())
+            auto const& box = *stack.back();
+            stack.pop_back();
+            if (!box.summary().has_value())
             {
-                return std::ranges::fold_left(
-                    b.subboxes(),
-                    acceleration_t{},
-                    [this, p](auto acc, auto const& subbox) {
-                        return acceleration_t{ std::move(acc) +
-                                               get_box_contribution(p, subbox) };
-                    }
-                );
+                continue;
+            }
+            auto const& summary = box.summary().value();
+            if (summary.id() == p.id())
+            {
+                continue;
+            }
+            const auto d = pm::utils::l2_norm_sq(
+                pm::utils::distance(p.position(), summary.position()).value()
+            );
+            if (accept(box, d, acc_old))
+            {
+                ++f_evals;
+                acc = std::move(acc) + cell_contribution(p, box);
+            }
+            else if (box.fragmented())
+            {
+                // Reversed, so sub-boxes are visited in order
+                for (auto const& subbox : box.subboxes() | std::views::reverse)
+                {
+                    stack.push_back(&subbox);
+                }
             }
             else
             {
-                return std::ranges::fold_left(
-                    b.contained_elements(),
-                    acceleration_t{},
-                    [this, p](auto acc, auto const* const other) {
-                        if (other->id() != p.id()) [[likely]]
-                        {
-                            ++m_f_eval_count;
-                            return acceleration_t{
-                                std::move(acc) +
-                                interaction_t::acceleration_contribution(p, *other)
-                            };
-                        }
-                        else
-                        {
-                            return acc;
-                        }
+                for (auto const* const other : box.contained_elements())
+                {
+                    if (other->id() != p.id()) [[likely]]
+                    {
+                        ++f_evals;
+                        acc = std::move(acc) +
+                              interaction_t::acceleration_contribution(p, *other);
                     }
-                );
+                }
             }
         }
+        return acc;
     }
 
+    // The particles themselves with the array of structures storage, put together from
+    // the arrays with the structure of arrays one
     [[nodiscard]]
-    inline auto current_system_state() const noexcept -> auto const&
+    inline auto current_system_state() const -> decltype(auto)
     {
-        return m_particles[s_working_copies];
+        return m_particles.particles(s_working_copies);
     }
 
     [[nodiscard]]
-    inline auto current_system_state() noexcept -> auto&
+    inline auto current_system_state() -> decltype(auto)
     {
-        return m_particles[s_working_copies];
+        return m_particles.particles(s_working_copies);
     }
 
+    // Stages the working copy and updates the tree over it in place. The tree and the
+    // staged particles are shared by every copy, get_acceleration reads the last one
+    // committed.
     inline auto commit_buffer(std::size_t working_copy_idx) noexcept -> void
     {
-        m_ndtrees[working_copy_idx].reorganize();
-        m_ndtrees[working_copy_idx].cache_summary();
+        update_tree(working_copy_idx);
+        if (m_traversal == traversal_t::group)
+        {
+            evaluate_groups();
+        }
+        else if (m_traversal == traversal_t::dual)
+        {
+            evaluate_dual();
+        }
+    }
+
+    // Same as above when only the particles in active need their acceleration, as with
+    // individual timesteps. The tree holds every particle, the group walk only visits
+    // the buckets holding an active particle, and get_acceleration walks the tree once
+    // per active particle in place of the dual walk.
+    inline auto commit_buffer(
+        std::size_t                   working_copy_idx,
+        std::span<std::size_t const> active
+    ) noexcept -> void
+    {
+        if (std::ranges::size(active) == m_simulation_size)
+        {
+            commit_buffer(working_copy_idx);
+            return;
+        }
+        update_tree(working_copy_idx);
+        if (m_traversal == traversal_t::group)
+        {
+            m_active.assign(m_simulation_size, std::uint8_t{ 0 });
+            for (auto const p_idx : active)
+            {
+                m_active[p_idx] = std::uint8_t{ 1 };
+            }
+            evaluate_groups(m_active);
+        }
+        else if (m_traversal == traversal_t::dual)
+        {
+            m_grouped.assign(m_simulation_size, std::uint8_t{ 0 });
+        }
     }
 
     [[nodiscard]]
-    inline auto position_read(std::size_t p_idx) const noexcept -> position_t const&
+    inline auto tree() const noexcept -> tree_t const&
+    {
+        return m_ndtree;
+    }
 
+    // By reference or by value, depending on the storage
+    [[nodiscard]]
+    inline auto position_read(std::size_t p_idx) const noexcept -> decltype(auto)
     {
-        return current_system_state()[p_idx].position();
+        return m_particles.position(s_working_copies, p_idx);
     }
 
     inline auto position_write(std::size_t p_idx, position_t value) noexcept -> void
     {
-        current_system_state()[p_idx].position() = value;
+        m_particles.set_position(s_working_copies, p_idx, value);
     }
 
     [[nodiscard]]
     inline auto position_buffer_read(std::size_t buffer_id, std::size_t p_idx)
-        const noexcept -> position_t const&
+        const noexcept -> decltype(auto)
     {
-        return m_particles[buffer_id][p_idx].position();
+        return m_particles.position(buffer_id, p_idx);
     }
 
     inline auto position_buffer_write(
@@ -262,25 +507,25 @@ public:
         position_t const& value
     ) noexcept -> void
     {
-        m_particles[buffer_id][p_idx].position() = value;
+        m_particles.set_position(buffer_id, p_idx, value);
     }
 
     [[nodiscard]]
-    inline auto velocity_read(std::size_t p_idx) const noexcept -> velocity_t const&
+    inline auto velocity_read(std::size_t p_idx) const noexcept -> decltype(auto)
     {
-        return current_system_state()[p_idx].velocity();
+        return m_particles.velocity(s_working_copies, p_idx);
     }
 
     inline auto velocity_write(std::size_t p_idx, velocity_t value) noexcept -> void
     {
-        current_system_state()[p_idx].velocity() = value;
+        m_particles.set_velocity(s_working_copies, p_idx, value);
     }
 
     [[nodiscard]]
     inline auto velocity_buffer_read(std::size_t buffer_id, std::size_t p_idx)
-        const noexcept -> velocity_t const&
+        const noexcept -> decltype(auto)
     {
-        return m_particles[buffer_id][p_idx].velocity();
+        return m_particles.velocity(buffer_id, p_idx);
     }
 
     inline auto velocity_buffer_write(
@@ -289,25 +534,719 @@ public:
         velocity_t const& value
     ) noexcept -> void
     {
-        m_particles[buffer_id][p_idx].velocity() = value;
+        m_particles.set_velocity(buffer_id, p_idx, value);
+    }
+
+    // Bulk interface of the solver, with the structure of arrays storage: whole copies,
+    // one span per coordinate. Copy s_working_copies is the current state.
+    [[nodiscard]]
+    inline auto positions(std::size_t copy_idx) noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.positions(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto positions(std::size_t copy_idx) const noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.positions(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto velocities(std::size_t copy_idx) noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.velocities(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto velocities(std::size_t copy_idx) const noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.velocities(copy_idx);
+    }
+
+    // Accelerations of the working copy committed last, one array per coordinate.
+    // Particles the traversal left out are walked here, in parallel.
+    [[nodiscard]]
+    auto accelerations(std::size_t copy_idx)
+        -> std::array<std::span<value_type const>, s_dimension>
+        requires storage_t::s_is_packed
+    {
+        for (auto& component : m_acceleration_components)
+        {
+            component.resize(m_simulation_size);
+        }
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(
+                0, m_simulation_size, solver_t::s_parallel_grain
+            ),
+            [this, copy_idx](tbb::blocked_range<std::size_t> const& r) {
+                for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                {
+                    const auto acc = get_acceleration(copy_idx, p_idx);
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        m_acceleration_components[i][p_idx] = acc[i];
+                    }
+                }
+            }
+        );
+        auto ret = std::array<std::span<value_type const>, s_dimension>{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = m_acceleration_components[i];
+        }
+        return ret;
     }
 
     [[nodiscard]]
     inline auto f_eval_count() const noexcept -> std::size_t
     {
-        return m_f_eval_count;
+        return m_f_eval_count.combine(std::plus{});
     }
 
 private:
-    duration_t                                           m_current_time{};
-    duration_t                                           m_simulation_duration;
-    duration_t                                           m_dt;
-    std::array<owning_container_t, s_working_copies + 1> m_particles;
-    std::array<tree_t, s_working_copies>                 m_ndtrees;
-    size_type                                            m_simulation_size;
-    solver_t                                             m_solver;
-    mutable std::atomic<std::size_t>                     m_f_eval_count = 0;
-    utility::generics::ranged_value<value_type>          m_theta_sq;
+    using components_t = std::array<storage::aligned_vector<value_type>, s_dimension>;
+
+    // With tree_refit only the first commit of a step reorganizes the tree, the later
+    // ones refit it to the staged positions
+    auto update_tree(std::size_t working_copy_idx) -> void
+    {
+        if (m_tree_refit && !m_reorganize_tree)
+        {
+            m_particles.stage(working_copy_idx);
+            m_ndtree.refit(m_multipole_order);
+            return;
+        }
+        m_reorganize_tree = false;
+        auto&      staged  = m_particles.stage(working_copy_idx, m_moved);
+        const auto partial =
+            m_moved.size() * s_partial_summary_ratio <= m_simulation_size;
+        if (partial)
+        {
+            for (const auto p_idx : m_moved)
+            {
+                m_ndtree.touch(&staged[p_idx]);
+            }
+        }
+        m_ndtree.reorganize();
+        if (m_tree_regroup)
+        {
+            m_ndtree.regroup();
+        }
+        if (partial)
+        {
+            m_ndtree.update_summary(m_multipole_order);
+        }
+        else
+        {
+            m_ndtree.cache_summary(m_multipole_order);
+        }
+    }
+
+    [[nodiscard]]
+    static auto reorganize_mode(simulation::config::TreeReorganizeType type) noexcept
+        -> ndt::ReorganizeMode
+    {
+        using simulation::config::TreeReorganizeType;
+        switch (type)
+        {
+        case TreeReorganizeType::adaptive: return ndt::ReorganizeMode::adaptive;
+        case TreeReorganizeType::relocate: return ndt::ReorganizeMode::relocate;
+        case TreeReorganizeType::rebuild: return ndt::ReorganizeMode::rebuild;
+        default: utility::error_handling::assert_unreachable();
+        }
+    }
+
+    [[nodiscard]]
+    static auto reorder_curve(simulation::config::ReorderCurveType type) noexcept
+        -> ndt::SpaceFillingCurve
+    {
+        using simulation::config::ReorderCurveType;
+        switch (type)
+        {
+        case ReorderCurveType::morton: return ndt::SpaceFillingCurve::morton;
+        case ReorderCurveType::hilbert: return ndt::SpaceFillingCurve::hilbert;
+        default: utility::error_handling::assert_unreachable();
+        }
+    }
+
+    [[nodiscard]]
+    static auto make_tree(
+        owning_container_t&       particles,
+        depth_t                   max_depth,
+        size_type                 box_capacity,
+        std::optional<boundary_t> bounds
+    ) -> tree_t
+    {
+        if constexpr (std::is_constructible_v<
+                          tree_t,
+                          std::execution::parallel_policy,
+                          owning_container_t&,
+                          depth_t,
+                          size_type,
+                          std::optional<boundary_t>>)
+        {
+            return tree_t(
+                std::execution::par, particles, max_depth, box_capacity, bounds
+            );
+        }
+        else
+        {
+            return tree_t(particles, max_depth, box_capacity, bounds);
+        }
+    }
+
+    // Cells accepted for a whole leaf bucket, and particles of the leaves it opened. In
+    // mixed precision the monopoles of the cells are also kept in shadow_t, one array
+    // per coordinate padded to whole packs with massless cells.
+    struct interaction_list
+    {
+        std::vector<box_t const*>                      cells;
+        std::vector<particle_t const*>                 particles;
+        std::array<std::vector<shadow_t>, s_dimension> shadow_positions;
+        std::vector<shadow_t>                          shadow_masses;
+    };
+
+    struct dual_frame
+    {
+        walk_stack_t candidates;
+        walk_stack_t kept;
+    };
+
+    // Field carried down the target cells of the dual walk: the acceleration at the
+    // target's center of mass and its gradient there, from every cell accepted for the
+    // target or for one of its ancestors
+    struct local_field
+    {
+        using gradient_t =
+            std::array<std::array<value_type, s_dimension>, s_dimension>;
+
+        acceleration_t acceleration{};
+        gradient_t     gradient{};
+
+        // First order expansion about center, at position
+        [[nodiscard]]
+        auto at(position_t const& center, position_t const& position) const noexcept
+            -> acceleration_t
+        {
+            auto acc = acceleration;
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                for (auto j = 0uz; j != s_dimension; ++j)
+                {
+                    acc[i] += gradient[i][j] * (position[j] - center[j]);
+                }
+            }
+            return acc;
+        }
+    };
+
+    // Field of an accepted cell, with its quadrupole when the tree caches them
+    [[nodiscard]]
+    auto cell_contribution(particle_t const& p, box_t const& b) const noexcept
+        -> acceleration_t
+    {
+        if constexpr (s_quadrupole_support)
+        {
+            if (b.quadrupole().has_value())
+            {
+                return interaction_t::far_field_contribution(
+                    p, b.summary().value(), b.quadrupole().value()
+                );
+            }
+        }
+        return interaction_t::acceleration_contribution(p, b.summary().value());
+    }
+
+    // Walks the tree once per leaf bucket and evaluates the shared interaction list for
+    // every particle of the bucket. A cell is accepted when the opening criterion holds
+    // at the point of the bucket's bounding box closest to the cell's center of mass,
+    // which makes it hold for every particle of the bucket. With active flags, only the
+    // flagged particles are evaluated and buckets without any are skipped.
+    auto evaluate_groups(std::span<std::uint8_t const> active = {}) -> void
+    {
+        auto const& root = m_ndtree.box();
+        auto const* base = m_particles.staged().data();
+        collect_leaves(root);
+        m_group_accelerations.resize(m_simulation_size);
+        m_grouped.assign(m_simulation_size, std::uint8_t{ 0 });
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_leaves.size()),
+            [&](tbb::blocked_range<std::size_t> const& r) {
+                auto& list    = m_interaction_lists.local();
+                auto& stack   = m_walk_stacks.local();
+                auto& f_evals = m_f_eval_count.local();
+                for (auto l = r.begin(); l != r.end(); ++l)
+                {
+                    auto const& leaf      = *m_leaves[l];
+                    auto const  is_active = [&](particle_t const* p) {
+                        return active.empty() ||
+                               active[static_cast<std::size_t>(p - base)] != 0;
+                    };
+                    if (!std::ranges::any_of(leaf.contained_elements(), is_active))
+                    {
+                        continue;
+                    }
+                    build_interaction_list(leaf, root, list, stack);
+                    for (auto const* const p : leaf.contained_elements())
+                    {
+                        const auto p_idx = static_cast<std::size_t>(p - base);
+                        if (!is_active(p))
+                        {
+                            continue;
+                        }
+                        m_group_accelerations[p_idx] =
+                            evaluate_interaction_list(*p, list, f_evals);
+                        m_grouped[p_idx] = std::uint8_t{ 1 };
+                    }
+                }
+            }
+        );
+    }
+
+    // Walks the tree against itself. Every target box tests the candidate cells it
+    // inherits from its parent: a cell that is accepted for the whole target adds its
+    // field at the target's center of mass, a cell at least as large as the target is
+    // replaced by its sub-boxes and tested again, and the rest are passed down. Leaves
+    // evaluate the carried field at their particles and sum what is left directly.
+    auto evaluate_dual() -> void
+    {
+        auto const& root = m_ndtree.box();
+        m_group_accelerations.resize(m_simulation_size);
+        m_grouped.assign(m_simulation_size, std::uint8_t{ 0 });
+        if (root.summary().has_value())
+        {
+            auto const* const candidates = &root;
+            dual_walk(
+                root,
+                std::span{ &candidates, 1 },
+                local_field{},
+                m_particles.staged().data(),
+                0uz
+            );
+        }
+    }
+
+    auto dual_walk(
+        box_t const&                  target,
+        std::span<box_t const* const> inherited,
+        local_field                   field,
+        particle_t const*             base,
+        std::size_t                   level
+    ) -> void
+    {
+        auto& f_evals = m_f_eval_count.local();
+        auto& frames  = m_dual_frames.local();
+        if (frames.size() == level)
+        {
+            frames.emplace_back();
+        }
+        auto& [candidates, kept] = frames[level];
+        candidates.assign(inherited.begin(), inherited.end());
+        kept.clear();
+        auto const& center = target.summary().value();
+        const auto  size   = std::sqrt(box_size_sq(target));
+        while (!candidates.empty())
+        {
+            auto const& box = *candidates.back();
+            candidates.pop_back();
+            if (!box.summary().has_value())
+            {
+                continue;
+            }
+            const auto box_size = std::sqrt(box_size_sq(box));
+            const auto d        = pm::utils::l2_norm_sq(
+                pm::utils::distance(center.position(), box.summary().value().position())
+                    .value()
+            );
+            // The field is carried across the target, which has to be small too. The
+            // field at its center of mass has no previous acceleration to go by.
+            if (size * size < m_theta_sq.get() * d && accept(box, d, value_type{ 0 }))
+            {
+                ++f_evals;
+                field.acceleration = field.acceleration + cell_contribution(center, box);
+                if constexpr (s_gradient_support)
+                {
+                    const auto gradient = interaction_t::acceleration_gradient(
+                        center, box.summary().value()
+                    );
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        for (auto j = 0uz; j != s_dimension; ++j)
+                        {
+                            field.gradient[i][j] += gradient[i][j];
+                        }
+                    }
+                }
+            }
+            else if (box.fragmented() && box_size >= size)
+            {
+                for (auto const& subbox : box.subboxes())
+                {
+                    candidates.push_back(&subbox);
+                }
+            }
+            else
+            {
+                kept.push_back(&box);
+            }
+        }
+
+        if (!target.fragmented())
+        {
+            auto& stack = m_walk_stacks.local();
+            for (auto const* const p : target.contained_elements())
+            {
+                auto acc = field.at(center.position(), p->position());
+                for (auto const* const box : kept)
+                {
+                    if (box->fragmented())
+                    {
+                        acc = std::move(acc) + get_box_contribution(
+                                                   *p,
+                                                   *box,
+                                                   f_evals,
+                                                   stack,
+                                                   previous_acceleration(
+                                                       static_cast<std::size_t>(p - base)
+                                                   )
+                                               );
+                        continue;
+                    }
+                    for (auto const* const other : box->contained_elements())
+                    {
+                        if (other->id() != p->id()) [[likely]]
+                        {
+                            ++f_evals;
+                            acc = std::move(acc) +
+                                  interaction_t::acceleration_contribution(*p, *other);
+                        }
+                    }
+                }
+                const auto p_idx             = static_cast<std::size_t>(p - base);
+                m_group_accelerations[p_idx] = acc;
+                m_grouped[p_idx]             = std::uint8_t{ 1 };
+            }
+            return;
+        }
+
+        // The field is moved to the center of mass of every sub-box
+        auto const descend = [&](box_t const& subbox) {
+            if (!subbox.summary().has_value())
+            {
+                return;
+            }
+            auto shifted         = field;
+            shifted.acceleration = field.at(
+                center.position(), subbox.summary().value().position()
+            );
+            dual_walk(subbox, kept, shifted, base, level + 1);
+        };
+        // linear_ndtree only keeps the non-empty sub-boxes, so there may be fewer than
+        // s_subdivisions of them
+        auto&& subboxes = target.subboxes();
+        if (target.elements() >= s_dual_parallel_grain)
+        {
+            // Isolated, so a thread waiting here only takes on targets below this one
+            // and leaves the frames of this level and above alone
+            tbb::this_task_arena::isolate([&] {
+                tbb::parallel_for(
+                    std::size_t{ 0 },
+                    std::ranges::size(subboxes),
+                    [&](std::size_t i) { descend(subboxes[i]); }
+                );
+            });
+        }
+        else
+        {
+            for (auto const& subbox : subboxes)
+            {
+                descend(subbox);
+            }
+        }
+    }
+
+    [[nodiscard]]
+    auto accept(box_t const& box, value_type d_sq, value_type acc_old) const noexcept
+        -> bool
+    {
+        return opening_criterion_t::template accept<interaction_t>(
+            box, d_sq, m_theta_sq.get(), acc_old
+        );
+    }
+
+    // Zero until the particle has been evaluated once, or when the criterion does not
+    // need it
+    [[nodiscard]]
+    auto previous_acceleration(std::size_t p_idx) const noexcept -> value_type
+    {
+        if constexpr (s_keeps_acceleration)
+        {
+            return m_acceleration_norms[p_idx];
+        }
+        else
+        {
+            return value_type{ 0 };
+        }
+    }
+
+    [[nodiscard]]
+    static auto box_size_sq(box_t const& box) noexcept -> value_type
+    {
+        return pm::utils::l2_norm_sq(box.diagonal_length().value());
+    }
+
+    auto collect_leaves(box_t const& root) -> void
+    {
+        auto& stack = m_walk_stacks.local();
+        m_leaves.clear();
+        stack.clear();
+        stack.push_back(&root);
+        while (!stack.empty())
+        {
+            auto const& box = *stack.back();
+            stack.pop_back();
+            if (box.fragmented())
+            {
+                for (auto const& subbox : box.subboxes())
+                {
+                    stack.push_back(&subbox);
+                }
+            }
+            else if (!std::ranges::empty(box.contained_elements()))
+            {
+                m_leaves.push_back(&box);
+            }
+        }
+    }
+
+    auto build_interaction_list(
+        box_t const&      leaf,
+        box_t const&      root,
+        interaction_list& list,
+        walk_stack_t&     stack
+    ) const -> void
+    {
+        // Tight bounds of the bucket, the leaf boundary may be much larger. The smallest
+        // previous acceleration in it makes the criterion hold for all of them.
+        auto lo      = std::array<value_type, s_dimension>{};
+        auto hi      = std::array<value_type, s_dimension>{};
+        auto acc_old = std::numeric_limits<value_type>::max();
+        std::ranges::fill(lo, std::numeric_limits<value_type>::max());
+        std::ranges::fill(hi, std::numeric_limits<value_type>::lowest());
+        auto const* const base = m_particles.staged().data();
+        for (auto const* const p : leaf.contained_elements())
+        {
+            for (auto k = 0uz; k != s_dimension; ++k)
+            {
+                lo[k] = std::min<value_type>(lo[k], p->position()[k]);
+                hi[k] = std::max<value_type>(hi[k], p->position()[k]);
+            }
+            acc_old = std::min(
+                acc_old, previous_acceleration(static_cast<std::size_t>(p - base))
+            );
+        }
+
+        list.cells.clear();
+        list.particles.clear();
+        stack.clear();
+        stack.push_back(&root);
+        while (!stack.empty())
+        {
+            auto const& box = *stack.back();
+            stack.pop_back();
+            if (!box.summary().has_value())
+            {
+                continue;
+            }
+            auto const& summary = box.summary().value();
+            auto        d       = value_type{ 0 };
+            for (auto k = 0uz; k != s_dimension; ++k)
+            {
+                const auto x   = static_cast<value_type>(summary.position()[k]);
+                const auto gap = std::max({ lo[k] - x, value_type{ 0 }, x - hi[k] });
+                d += gap * gap;
+            }
+            if (accept(box, d, acc_old))
+            {
+                list.cells.push_back(&box);
+            }
+            else if (box.fragmented())
+            {
+                for (auto const& subbox : box.subboxes() | std::views::reverse)
+                {
+                    stack.push_back(&subbox);
+                }
+            }
+            else
+            {
+                std::ranges::copy(
+                    box.contained_elements(), std::back_inserter(list.particles)
+                );
+            }
+        }
+        if constexpr (s_mixed_precision_support)
+        {
+            if (m_mixed_precision)
+            {
+                shadow_cells(list);
+            }
+        }
+    }
+
+    // Gathers the summaries the tree keeps in shadow_t, so the walk converts nothing
+    auto shadow_cells(interaction_list& list) const noexcept -> void
+        requires s_mixed_precision_support
+    {
+        constexpr auto lanes  = shadow_simd_t::size();
+        const auto     padded = (list.cells.size() + lanes - 1) / lanes * lanes;
+        for (auto& component : list.shadow_positions)
+        {
+            component.assign(padded, shadow_t{ 0 });
+        }
+        list.shadow_masses.assign(padded, shadow_t{ 0 });
+        for (auto c = 0uz; c != list.cells.size(); ++c)
+        {
+            auto const& summary = list.cells[c]->narrow_summary().value();
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                list.shadow_positions[i][c] = static_cast<shadow_t>(summary.position[i]);
+            }
+            list.shadow_masses[c] = static_cast<shadow_t>(summary.mass);
+        }
+    }
+
+    // Monopole far field of the shadow cells of the list at p. Every pack is evaluated
+    // in shadow_t, and its lanes are summed into the result in value_type.
+    [[nodiscard]]
+    auto evaluate_shadow_cells(particle_t const& p, interaction_list const& list)
+        const noexcept -> acceleration_t
+    {
+        namespace stdx       = std::experimental;
+        constexpr auto lanes = shadow_simd_t::size();
+        using pack_t         = std::array<shadow_simd_t, s_dimension>;
+        auto target          = pack_t{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            target[i] = shadow_simd_t(static_cast<shadow_t>(p.position()[i]));
+        }
+        auto acc = acceleration_t{};
+        for (auto j = 0uz; j != list.shadow_masses.size(); j += lanes)
+        {
+            auto distance = pack_t{};
+            auto d_sq     = shadow_simd_t(shadow_t{ 0 });
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                distance[i] = shadow_simd_t(
+                                  list.shadow_positions[i].data() + j,
+                                  stdx::element_aligned
+                              ) -
+                              target[i];
+                d_sq += distance[i] * distance[i];
+            }
+            const auto mass =
+                shadow_simd_t(list.shadow_masses.data() + j, stdx::element_aligned);
+            const auto scale = interaction_t::acceleration_scale(d_sq, mass);
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                const auto component = scale * distance[i];
+                for (auto l = 0uz; l != lanes; ++l)
+                {
+                    acc[i] += static_cast<value_type>(component[l]);
+                }
+            }
+        }
+        return acc;
+    }
+
+    [[nodiscard]]
+    auto evaluate_interaction_list(
+        particle_t const&       p,
+        interaction_list const& list,
+        std::size_t&            f_evals
+    ) const noexcept -> acceleration_t
+    {
+        auto acc = acceleration_t{};
+        if (m_mixed_precision)
+        {
+            // No cell is p alone: accepted cells have their center of mass outside of
+            // the bucket
+            f_evals += list.cells.size();
+            acc      = evaluate_shadow_cells(p, list);
+        }
+        else
+        {
+            for (auto const* const cell : list.cells)
+            {
+                if (cell->summary().value().id() != p.id()) [[likely]]
+                {
+                    ++f_evals;
+                    acc = std::move(acc) + cell_contribution(p, *cell);
+                }
+            }
+        }
+        for (auto const* const other : list.particles)
+        {
+            if (other->id() != p.id()) [[likely]]
+            {
+                ++f_evals;
+                acc = std::move(acc) +
+                      interaction_t::acceleration_contribution(p, *other);
+            }
+        }
+        return acc;
+    }
+
+    duration_t                                                m_current_time{};
+    duration_t                                                m_simulation_duration;
+    duration_t                                                m_dt;
+    storage_t                                                 m_particles;
+    tree_t                                                    m_ndtree;
+    size_type                                                 m_simulation_size;
+    solver_t                                                  m_solver;
+    // Set when the configuration asks for individual timesteps
+    std::optional<block_solver_t>                             m_block_solver;
+    // One counter per worker of the force phase, reduced on read
+    mutable tbb::enumerable_thread_specific<std::size_t>      m_f_eval_count{ 0uz };
+    // Kept per thread so the walk does not allocate once the stacks have grown
+    mutable tbb::enumerable_thread_specific<walk_stack_t>     m_walk_stacks;
+    // Candidate and kept cells of the dual walk, per thread and per level of the
+    // targets it is in. A deque, so deeper levels do not move the frames in use.
+    tbb::enumerable_thread_specific<std::deque<dual_frame>>   m_dual_frames;
+    utility::generics::ranged_value<value_type>               m_theta_sq;
+    bool                                                      m_tree_regroup;
+    bool                                                      m_tree_refit;
+    bool                                                      m_reorganize_tree = true;
+    traversal_t                                               m_traversal;
+    // Far field of the group walk in shadow_t, only for monopole cells
+    bool                                                      m_mixed_precision;
+    ndt::MultipoleOrder                                       m_multipole_order;
+    // Steps between reorders, none with 0, and the steps taken so far
+    size_type                                                 m_reorder_interval;
+    ndt::SpaceFillingCurve                                    m_reorder_curve;
+    size_type                                                 m_steps = 0;
+    // Index in the particles the engine was built from of the one at every slot
+    std::vector<size_type>                                    m_original_index;
+    // Reorder buffers, kept between reorders
+    std::vector<keyed_index_t>                                m_reorder_keys;
+    std::vector<keyed_index_t>                                m_reorder_scratch;
+    std::vector<size_type>                                    m_order;
+    std::vector<size_type>                                    m_reorder_slots;
+    // Group and dual traversal state, rebuilt by every commit_buffer
+    std::vector<box_t const*>                                 m_leaves;
+    std::vector<acceleration_t>                               m_group_accelerations;
+    std::vector<std::uint8_t>                                 m_grouped;
+    std::vector<std::uint8_t>                                 m_active;
+    // Particles whose position changed in the last staging
+    std::vector<size_type>                                    m_moved;
+    // Accelerations handed out by the bulk interface
+    components_t                                              m_acceleration_components;
+    // Magnitudes of the last acceleration of every particle, with s_keeps_acceleration
+    std::vector<value_type>                                   m_acceleration_norms;
+    mutable tbb::enumerable_thread_specific<interaction_list> m_interaction_lists;
 #ifdef USE_ROOT_PLOTTING
     duration_t m_plot_interval  = duration_t{ 3.0 };
     duration_t m_prev_plot_time = -m_plot_interval;
@@ -1,14 +1,28 @@
 #pragma once
 
+#include "block_leapfrog.hpp"
 #include "compile_time_utility.hpp"
 #include "energy.hpp"
 #include "particle_concepts.hpp"
 #include "particle_interaction.hpp"
+#include "particle_storage.hpp"
 #include "random.hpp"
 #include "simulation_config.hpp"
 #include "yoshida.hpp"
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <execution>
+#include <experimental/simd>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <vector>
 #ifdef USE_ROOT_PLOTTING
 #include "scatter_plot_3D.hpp"
 #endif
@@ -20,14 +34,17 @@ using namespace pm::interaction;
 
 template <
     pm::particle_concepts::Particle  Particle_Type,
-    pm::interaction::InteractionType Interaction_Type
-    // typename Solver_Type
-    >
+    pm::interaction::InteractionType Interaction_Type,
+    // typename Solver_Type,
+    // Either storage::aos_storage or storage::soa_storage
+    template <typename, std::size_t> typename Storage_Type = storage::aos_storage>
 class brute_force_computation
 {
 public:
     using particle_t    = Particle_Type;
     using solver_t      = solvers::yoshida4_solver<brute_force_computation, particle_t>;
+    using block_solver_t =
+        solvers::block_leapfrog_solver<brute_force_computation, particle_t>;
     using interaction_t = particle_interaction_t<particle_t, Interaction_Type>;
     static_assert(pm::particle_concepts::Interaction<interaction_t>);
     using value_type                              = typename particle_t::value_type;
@@ -38,6 +55,34 @@ public:
     using mass_t                                  = typename particle_t::mass_t;
     using owning_container_t                      = std::vector<particle_t>;
     inline static constexpr auto s_working_copies = solver_t::s_working_copies;
+    using storage_t = Storage_Type<particle_t, s_working_copies + 1>;
+    // Whether the interaction evaluates both halves of a pair with a single kernel
+    inline static constexpr auto s_pair_support =
+        requires(particle_t const& p) { interaction_t::pair_contribution(p, p); };
+    // Bands of consecutive rows of the pair triangle, each with about as many pairs and
+    // a buffer of its own, for the parallel pass. There are as many whatever the
+    // workers, so the rounding of the sums does not depend on them.
+    inline static constexpr auto s_row_bands = std::size_t{ 16 };
+    inline static constexpr auto s_no_copy = std::numeric_limits<std::size_t>::max();
+    using simd_t = std::experimental::native_simd<value_type>;
+    inline static constexpr auto s_dimension = particle_t::s_dimension;
+    // Whether the interaction kernel can run on packs of separate coordinates and masses
+    inline static constexpr auto s_simd_support =
+        requires(simd_t const& v) { interaction_t::acceleration_scale(v, v); };
+    inline static constexpr auto s_lanes = simd_t::size();
+    // Targets kept in registers against every source pack, and sources streamed per
+    // tile. A tile of 3D double sources takes 32 KiB, about the size of L1.
+    inline static constexpr auto s_target_block = std::size_t{ 4 };
+    inline static constexpr auto s_source_tile  = std::size_t{ 1024 };
+    inline static constexpr auto s_pack_size    = std::max(s_lanes, s_target_block);
+    // Whether the SIMD kernel reads the sources straight from the storage
+    inline static constexpr auto s_packed_storage = [] {
+        if constexpr (storage_t::s_is_packed)
+        {
+            return storage_t::s_padding % s_pack_size == 0;
+        }
+        return false;
+    }();
 
     brute_force_computation(
         std::vector<particle_t> const& particles,
@@ -45,20 +90,33 @@ public:
         utility::concepts::Duration auto const sim_duration,
         utility::concepts::Duration auto const sim_dt
         */
-        simulation::config::simulation_common_config<particle_t> const& base_config
+        simulation::config::simulation_common_config<particle_t> const&   base_config,
+        simulation::config::brute_force_specific_config<particle_t> const& bf_config = {}
     ) :
         m_simulation_duration{
             std::chrono::duration_cast<duration_t>(base_config.duration_)
         },
         m_dt{ std::chrono::duration_cast<duration_t>(base_config.dt_) },
-        m_particles{
-            utility::compile_time_utility::array_factory<s_working_copies + 1>(particles)
-        },
-        m_simulation_size{ std::ranges::size(m_particles[0]) },
-        m_solver(this, m_simulation_size, m_dt)
+        m_particles{ particles },
+        m_simulation_size{ m_particles.size() },
+        m_kernel{ bf_config.kernel_ },
+        m_solver(this, m_simulation_size, m_dt),
+        m_accelerations(m_simulation_size),
+        m_row_bands{ row_bands(m_simulation_size) }
     {
         assert(m_dt > duration_t{ 0 });
         assert(m_simulation_duration > duration_t{ 0 });
+        if (base_config.timestep_bins_ > 0)
+        {
+            m_block_solver.emplace(
+                this,
+                m_simulation_size,
+                m_dt,
+                base_config.timestep_bins_,
+                base_config.timestep_accuracy_,
+                std::cbrt(interaction_t::epsilon)
+            );
+        }
     }
 
     auto run() noexcept -> void
@@ -74,8 +132,7 @@ public:
 #endif
         while (m_current_time < m_simulation_duration)
         {
-            m_solver.run();
-            m_current_time += m_dt;
+            step();
             /*
             if (utility::random::srandom::randfloat<float>() < 0.02f)
             {
@@ -94,66 +151,218 @@ public:
             for (auto j = decltype(m_simulation_size){}; j != m_simulation_size; ++j)
             {
                 data[0][j].x =
-                    static_cast<float>(m_particles[s_working_copies][j].position()[0]);
+                    static_cast<float>(m_particles.position(s_working_copies, j)[0]);
                 data[0][j].y =
-                    static_cast<float>(m_particles[s_working_copies][j].position()[1]);
+                    static_cast<float>(m_particles.position(s_working_copies, j)[1]);
                 data[0][j].z =
-                    static_cast<float>(m_particles[s_working_copies][j].position()[2]);
+                    static_cast<float>(m_particles.position(s_working_copies, j)[2]);
             }
             scatter_plot.render();
         }
 #endif
     }
 
+    auto step() noexcept -> void
+    {
+        if (m_block_solver.has_value())
+        {
+            m_block_solver->run();
+        }
+        else
+        {
+            m_solver.run();
+        }
+        m_current_time += m_dt;
+    }
+
+    // Acceleration of a particle of a working copy. Reads the result of the last
+    // commit_buffer when it is for that copy, and sums over every other particle
+    // otherwise.
     auto get_acceleration(std::size_t copy_idx, std::size_t p_idx) const noexcept
         -> acceleration_t
     {
+        if (copy_idx == m_committed_copy) [[likely]]
+        {
+            return m_accelerations[p_idx];
+        }
         acceleration_t acc{};
-        auto const&    p = m_particles[copy_idx][p_idx];
-        for (auto const& other : m_particles[copy_idx])
+        auto const&    p       = m_particles.particle(copy_idx, p_idx);
+        auto&          f_evals = m_f_eval_count.local();
+        for (auto j = 0uz; j != m_simulation_size; ++j)
         {
+            auto const& other = m_particles.particle(copy_idx, j);
             if (other.id() != p.id()) [[likely]]
             {
-                ++m_f_eval_count;
+                ++f_evals;
                 acc = std::move(acc) + interaction_t::acceleration_contribution(p, other);
             }
         }
         return acc;
     }
 
-    inline auto commit_buffer(std::size_t) noexcept -> void
+    // With the kernel of the configuration
+    inline auto commit_buffer(std::size_t working_copy_idx) -> void
+    {
+        if constexpr (s_simd_support)
+        {
+            if (m_kernel == simulation::config::BruteForceKernel::simd)
+            {
+                compute_accelerations(std::execution::par_unseq, working_copy_idx);
+                return;
+            }
+        }
+        compute_accelerations(std::execution::par, working_copy_idx);
+    }
+
+    // Same as above when only the particles in active need their acceleration, as with
+    // individual timesteps. Unless they are all active, nothing is computed ahead and
+    // get_acceleration sums over every other particle for each of them.
+    inline auto commit_buffer(
+        std::size_t                   working_copy_idx,
+        std::span<std::size_t const> active
+    ) -> void
+    {
+        if (std::ranges::size(active) == m_simulation_size)
+        {
+            commit_buffer(working_copy_idx);
+            return;
+        }
+        m_committed_copy = s_no_copy;
+    }
+
+    // Accelerations of every particle of a working copy. Every unordered pair is
+    // evaluated once and both of its contributions are written, which halves the
+    // interaction work of a full pass. The sums run in index order, so the result does
+    // not depend on anything but the particles.
+    auto compute_accelerations(std::size_t copy_idx) -> void
+    {
+        auto& f_evals = m_f_eval_count.local();
+        std::ranges::fill(m_accelerations, acceleration_t{});
+        accumulate_rows(copy_idx, 0uz, m_simulation_size, m_accelerations, f_evals);
+        m_committed_copy = copy_idx;
+        m_packed_copy    = s_no_copy;
+    }
+
+    // Same as above with the bands of rows of the pair triangle spread over the workers.
+    // Every band accumulates into its own buffer, and the buffers are summed per particle
+    // in band order at the end, so the result does not depend on the schedule either. A
+    // band only writes the particles from its first row on.
+    auto compute_accelerations(std::execution::parallel_policy, std::size_t copy_idx)
+        -> void
     {
+        if (std::ranges::empty(m_band_accelerations))
+        {
+            m_band_accelerations.assign(
+                s_row_bands, std::vector<acceleration_t>(m_simulation_size)
+            );
+        }
+        tbb::parallel_for(0uz, s_row_bands, [this, copy_idx](std::size_t band) {
+            const auto first  = m_row_bands[band];
+            auto&      buffer = m_band_accelerations[band];
+            std::fill(
+                std::ranges::begin(buffer) + static_cast<std::ptrdiff_t>(first),
+                std::ranges::end(buffer),
+                acceleration_t{}
+            );
+            accumulate_rows(
+                copy_idx, first, m_row_bands[band + 1], buffer, m_f_eval_count.local()
+            );
+        });
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_simulation_size),
+            [this](tbb::blocked_range<std::size_t> const& r) {
+                for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                {
+                    auto acc = acceleration_t{};
+                    for (auto band = 0uz;
+                         band != s_row_bands && m_row_bands[band] <= p_idx;
+                         ++band)
+                    {
+                        acc = std::move(acc) + m_band_accelerations[band][p_idx];
+                    }
+                    m_accelerations[p_idx] = acc;
+                }
+            }
+        );
+        m_committed_copy = copy_idx;
+        m_packed_copy    = s_no_copy;
     }
 
+    // Same result with every target summed over every source by the SIMD kernel. The
+    // copy is packed into one array per coordinate plus masses, blocks of targets are
+    // spread over the workers and each block runs over the sources one tile at a time.
+    // A target is summed by a single worker in a fixed order, so the schedule does not
+    // show in the result.
+    auto compute_accelerations(
+        std::execution::parallel_unsequenced_policy,
+        std::size_t copy_idx
+    ) -> void
+        requires s_simd_support
+    {
+        pack(copy_idx);
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_packed_size / s_target_block),
+            [this](tbb::blocked_range<std::size_t> const& r) {
+                accumulate_tiles(r.begin() * s_target_block, r.end() * s_target_block);
+            }
+        );
+        for (auto p_idx = 0uz; p_idx != m_simulation_size; ++p_idx)
+        {
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                m_accelerations[p_idx][i] = m_packed_accelerations[i][p_idx];
+            }
+        }
+        m_f_eval_count.local() += m_simulation_size * (m_simulation_size - 1);
+        m_committed_copy = copy_idx;
+        m_packed_copy    = copy_idx;
+    }
+
+    // The particles themselves with the array of structures storage, put together from
+    // the arrays with the structure of arrays one
     [[nodiscard]]
-    inline auto current_system_state() const noexcept -> auto const&
+    inline auto current_system_state() const -> decltype(auto)
     {
-        return m_particles[s_working_copies];
+        return m_particles.particles(s_working_copies);
     }
 
     [[nodiscard]]
-    inline auto current_system_state() noexcept -> auto&
+    inline auto current_system_state() -> decltype(auto)
     {
-        return m_particles[s_working_copies];
+        return m_particles.particles(s_working_copies);
     }
 
+    // By reference or by value, depending on the storage
     [[nodiscard]]
-    inline auto position_read(std::size_t p_idx) const noexcept -> position_t const&
+    inline auto position_read(std::size_t p_idx) const noexcept -> decltype(auto)
+    {
+        return m_particles.position(s_working_copies, p_idx);
+    }
 
+    // Positions of the copy are about to change, so its accelerations no longer hold.
+    // Called ahead of concurrent position writes, which then only read m_committed_copy.
+    inline auto invalidate_copy(std::size_t copy_idx) noexcept -> void
     {
-        return current_system_state()[p_idx].position();
+        if (copy_idx == m_committed_copy)
+        {
+            m_committed_copy = s_no_copy;
+        }
     }
 
     inline auto position_write(std::size_t p_idx, position_t value) noexcept -> void
     {
-        current_system_state()[p_idx].position() = value;
+        if (s_working_copies == m_committed_copy) [[unlikely]]
+        {
+            m_committed_copy = s_no_copy;
+        }
+        m_particles.set_position(s_working_copies, p_idx, value);
     }
 
     [[nodiscard]]
     inline auto position_buffer_read(std::size_t buffer_id, std::size_t p_idx)
-        const noexcept -> position_t const&
+        const noexcept -> decltype(auto)
     {
-        return m_particles[buffer_id][p_idx].position();
+        return m_particles.position(buffer_id, p_idx);
     }
 
     inline auto position_buffer_write(
@@ -162,25 +371,29 @@ public:
         position_t const& value
     ) noexcept -> void
     {
-        m_particles[buffer_id][p_idx].position() = value;
+        if (buffer_id == m_committed_copy) [[unlikely]]
+        {
+            m_committed_copy = s_no_copy;
+        }
+        m_particles.set_position(buffer_id, p_idx, value);
     }
 
     [[nodiscard]]
-    inline auto velocity_read(std::size_t p_idx) const noexcept -> velocity_t const&
+    inline auto velocity_read(std::size_t p_idx) const noexcept -> decltype(auto)
     {
-        return current_system_state()[p_idx].velocity();
+        return m_particles.velocity(s_working_copies, p_idx);
     }
 
     inline auto velocity_write(std::size_t p_idx, velocity_t value) noexcept -> void
     {
-        current_system_state()[p_idx].velocity() = value;
+        m_particles.set_velocity(s_working_copies, p_idx, value);
     }
 
     [[nodiscard]]
     inline auto velocity_buffer_read(std::size_t buffer_id, std::size_t p_idx)
-        const noexcept -> velocity_t const&
+        const noexcept -> decltype(auto)
     {
-        return m_particles[buffer_id][p_idx].velocity();
+        return m_particles.velocity(buffer_id, p_idx);
     }
 
     inline auto velocity_buffer_write(
@@ -189,23 +402,276 @@ public:
         velocity_t const& value
     ) noexcept -> void
     {
-        m_particles[buffer_id][p_idx].velocity() = value;
+        m_particles.set_velocity(buffer_id, p_idx, value);
+    }
+
+    // Bulk interface of the solver, with the structure of arrays storage: whole copies,
+    // one span per coordinate. Copy s_working_copies is the current state. Writable
+    // positions of the committed copy invalidate its accelerations.
+    [[nodiscard]]
+    inline auto positions(std::size_t copy_idx) noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        if (copy_idx == m_committed_copy) [[unlikely]]
+        {
+            m_committed_copy = s_no_copy;
+        }
+        return m_particles.positions(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto positions(std::size_t copy_idx) const noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.positions(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto velocities(std::size_t copy_idx) noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.velocities(copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto velocities(std::size_t copy_idx) const noexcept -> decltype(auto)
+        requires storage_t::s_is_packed
+    {
+        return m_particles.velocities(copy_idx);
+    }
+
+    // Accelerations of the committed copy, one array per coordinate. The SIMD kernel
+    // leaves them that way, the other passes are transposed first.
+    [[nodiscard]]
+    auto accelerations([[maybe_unused]] std::size_t copy_idx)
+        -> std::array<std::span<value_type const>, s_dimension>
+        requires storage_t::s_is_packed
+    {
+        assert(copy_idx == m_committed_copy);
+        if (m_packed_copy != m_committed_copy)
+        {
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                m_packed_accelerations[i].resize(m_simulation_size);
+                for (auto p_idx = 0uz; p_idx != m_simulation_size; ++p_idx)
+                {
+                    m_packed_accelerations[i][p_idx] = m_accelerations[p_idx][i];
+                }
+            }
+            m_packed_copy = m_committed_copy;
+        }
+        auto ret = std::array<std::span<value_type const>, s_dimension>{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            ret[i] = std::span{ m_packed_accelerations[i] }.first(m_simulation_size);
+        }
+        return ret;
     }
 
     [[nodiscard]]
     inline auto f_eval_count() const noexcept -> std::size_t
     {
-        return m_f_eval_count;
+        return m_f_eval_count.combine(std::plus{});
     }
 
 private:
+    // First row of every band and the end of the last one. The rows shrink towards the
+    // end of the triangle, so the bands get longer.
+    [[nodiscard]]
+    static auto row_bands(std::size_t size) noexcept
+        -> std::array<std::size_t, s_row_bands + 1>
+    {
+        auto       bands = std::array<std::size_t, s_row_bands + 1>{};
+        const auto pairs = size * (size - std::min(size, 1uz)) / 2;
+        auto       row   = 0uz;
+        auto       below = 0uz; // Pairs in the rows before row
+        for (auto band = 1uz; band != s_row_bands; ++band)
+        {
+            while (row != size && below < pairs * band / s_row_bands)
+            {
+                below += size - 1 - row;
+                ++row;
+            }
+            bands[band] = row;
+        }
+        bands[s_row_bands] = size;
+        return bands;
+    }
+
+    // Pairs (i, j) with i in [first, last) and j > i, accumulated into accelerations
+    auto accumulate_rows(
+        std::size_t                  copy_idx,
+        std::size_t                  first,
+        std::size_t                  last,
+        std::vector<acceleration_t>& accelerations,
+        std::size_t&                 f_evals
+    ) const noexcept -> void
+    {
+        for (auto i = first; i != last; ++i)
+        {
+            auto const& p   = m_particles.particle(copy_idx, i);
+            auto        acc = accelerations[i];
+            for (auto j = i + 1; j != m_simulation_size; ++j)
+            {
+                auto const& other = m_particles.particle(copy_idx, j);
+                f_evals += 2;
+                if constexpr (s_pair_support)
+                {
+                    const auto [on_p, on_other] =
+                        interaction_t::pair_contribution(p, other);
+                    acc              = std::move(acc) + on_p;
+                    accelerations[j] = accelerations[j] + on_other;
+                }
+                else
+                {
+                    acc = std::move(acc) +
+                          interaction_t::acceleration_contribution(p, other);
+                    accelerations[j] = accelerations[j] +
+                                       interaction_t::acceleration_contribution(other, p);
+                }
+            }
+            accelerations[i] = acc;
+        }
+    }
+
+    // Points the SIMD kernel to the sources of a copy, packing them first unless the
+    // storage already keeps them that way. Padding sources have no mass and sit at the
+    // origin, they add nothing.
+    auto pack(std::size_t copy_idx) -> void
+    {
+        if constexpr (s_packed_storage)
+        {
+            m_packed_size        = m_particles.padded_size();
+            m_source_masses      = m_particles.masses().data();
+            const auto positions = m_particles.positions(copy_idx);
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                m_source_positions[i] = positions[i].data();
+            }
+        }
+        else
+        {
+            m_packed_size =
+                (m_simulation_size + s_pack_size - 1) / s_pack_size * s_pack_size;
+            m_packed_masses.assign(m_packed_size, value_type{ 0 });
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                m_packed_positions[i].assign(m_packed_size, value_type{ 0 });
+            }
+            for (auto p_idx = 0uz; p_idx != m_simulation_size; ++p_idx)
+            {
+                auto const& p          = m_particles.particle(copy_idx, p_idx);
+                m_packed_masses[p_idx] = p.mass().magnitude();
+                for (auto i = 0uz; i != s_dimension; ++i)
+                {
+                    m_packed_positions[i][p_idx] = p.position()[i];
+                }
+            }
+            m_source_masses = m_packed_masses.data();
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                m_source_positions[i] = m_packed_positions[i].data();
+            }
+        }
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            m_packed_accelerations[i].assign(m_packed_size, value_type{ 0 });
+        }
+    }
+
+    // Packed targets [first, last) against every source. A target is not skipped as its
+    // own source: the separation is zero, and the softening keeps the scale finite.
+    auto accumulate_tiles(std::size_t first, std::size_t last) noexcept -> void
+    {
+        namespace stdx = std::experimental;
+        static_assert(interaction_t::epsilon > value_type{ 0 });
+        using pack_t = std::array<simd_t, s_dimension>;
+        for (auto tile = 0uz; tile < m_packed_size; tile += s_source_tile)
+        {
+            const auto tile_end = std::min(tile + s_source_tile, m_packed_size);
+            for (auto t = first; t != last; t += s_target_block)
+            {
+                auto targets = std::array<pack_t, s_target_block>{};
+                auto acc     = std::array<pack_t, s_target_block>{};
+                for (auto k = 0uz; k != s_target_block; ++k)
+                {
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        targets[k][i] = simd_t(m_source_positions[i][t + k]);
+                        acc[k][i]     = simd_t(value_type{ 0 });
+                    }
+                }
+                for (auto j = tile; j != tile_end; j += s_lanes)
+                {
+                    auto sources = pack_t{};
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        sources[i].copy_from(
+                            m_source_positions[i] + j, stdx::element_aligned
+                        );
+                    }
+                    const auto mass = simd_t(m_source_masses + j, stdx::element_aligned);
+                    for (auto k = 0uz; k != s_target_block; ++k)
+                    {
+                        auto distance = pack_t{};
+                        auto d_sq     = simd_t(value_type{ 0 });
+                        for (auto i = 0uz; i != s_dimension; ++i)
+                        {
+                            distance[i] = sources[i] - targets[k][i];
+                            d_sq       += distance[i] * distance[i];
+                        }
+                        const auto scale = interaction_t::acceleration_scale(d_sq, mass);
+                        for (auto i = 0uz; i != s_dimension; ++i)
+                        {
+                            acc[k][i] += scale * distance[i];
+                        }
+                    }
+                }
+                for (auto k = 0uz; k != s_target_block; ++k)
+                {
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        for (auto l = 0uz; l != s_lanes; ++l)
+                        {
+                            m_packed_accelerations[i][t + k] += acc[k][i][l];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     duration_t                                           m_current_time{};
     duration_t                                           m_simulation_duration;
     duration_t                                           m_dt;
-    std::array<owning_container_t, s_working_copies + 1> m_particles;
+    storage_t                                            m_particles;
     std::size_t                                          m_simulation_size;
+    simulation::config::BruteForceKernel                 m_kernel;
     solver_t                                             m_solver;
-    mutable std::size_t                                  m_f_eval_count = 0;
+    // Set when the configuration asks for individual timesteps
+    std::optional<block_solver_t>                        m_block_solver;
+    // Working copy whose accelerations are in m_accelerations
+    std::size_t                                          m_committed_copy{ s_no_copy };
+    // One counter per worker of the force phase, reduced on read. A pair counts as two
+    // evaluations, one per particle, like in the other engines.
+    mutable tbb::enumerable_thread_specific<std::size_t> m_f_eval_count{ 0uz };
+
+    // Result of the last commit_buffer, and the bands of the parallel pass with their
+    // buffers, allocated by the first one
+    std::vector<acceleration_t>              m_accelerations;
+    std::array<std::size_t, s_row_bands + 1> m_row_bands;
+    std::vector<std::vector<acceleration_t>> m_band_accelerations;
+
+    // Copy packed for the SIMD kernel, padded to whole target blocks and source packs,
+    // and where the kernel reads it from
+    std::array<std::vector<value_type>, s_dimension> m_packed_positions;
+    std::array<std::vector<value_type>, s_dimension> m_packed_accelerations;
+    std::vector<value_type>                          m_packed_masses;
+    std::size_t                                      m_packed_size{};
+    // Working copy whose accelerations are in m_packed_accelerations
+    std::size_t                                      m_packed_copy{ s_no_copy };
+    std::array<value_type const*, s_dimension>       m_source_positions{};
+    value_type const*                                m_source_masses{};
 };
 
 } // namespace simulation::bf
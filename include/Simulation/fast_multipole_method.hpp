@@ -0,0 +1,1056 @@
+#pragma once
+
+#include "block_leapfrog.hpp"
+#include "concepts.hpp"
+#include "ndtree.hpp"
+#include "particle_concepts.hpp"
+#include "particle_interaction.hpp"
+#include "particle_storage.hpp"
+#include "physical_constants.hpp"
+#include "simulation_config.hpp"
+#include "yoshida.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <utility>
+#include <vector>
+
+namespace simulation::fmm
+{
+
+using namespace pm::interaction;
+
+namespace detail
+{
+
+// Cartesian Taylor expansions of 1/|r| truncated at total order p. Coefficients are
+// stored in flat arrays with one entry per multi-index n, |n| <= p, in graded order, so
+// every recurrence only reads entries that are already computed. With b the offset of
+// a source from the expansion center z and a the offset of a target from it:
+//  - multipoles  M_n = sum m b^n / n!
+//  - locals      L_k = sum_n (-1)^|n| M_n D^(k+n) (1/|r|)
+// and the potential at the target is -G sum_k L_k a^k / k!.
+template <std::size_t N, std::floating_point F>
+class cartesian_expansion
+{
+public:
+    using value_type    = F;
+    using multi_index_t = std::array<unsigned, N>;
+    using point_t       = std::array<value_type, N>;
+
+    // The acceleration is the gradient of the local expansion, so it has order - 1
+    explicit cartesian_expansion(unsigned order) :
+        m_order{ order }
+    {
+        assert(m_order >= 1);
+        build_indices();
+        build_tables();
+    }
+
+    [[nodiscard]]
+    auto order() const noexcept -> unsigned
+    {
+        return m_order;
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> std::size_t
+    {
+        return std::ranges::size(m_indices);
+    }
+
+    // x^n / n! for every n
+    auto powers(point_t const& x, std::span<value_type> out) const noexcept -> void
+    {
+        out[0] = value_type{ 1 };
+        for (auto n = 1uz; n != size(); ++n)
+        {
+            auto const& r = m_power_recurrence[n];
+            out[n]        = out[r.from] * x[r.axis] / static_cast<value_type>(r.exponent);
+        }
+    }
+
+    // D^n (1/|r|) for every n, from the recurrence of the Taylor coefficients
+    // |n| r^2 a_n = -(2|n| - 1) sum_i r_i a_(n - e_i) - (|n| - 1) sum_i a_(n - 2e_i)
+    // with a_n = D^n (1/|r|) / n!. out needs one entry past size(), terms of the
+    // recurrence that do not exist read that entry as zero.
+    auto derivatives(point_t const& r, std::span<value_type> out) const noexcept -> void
+    {
+        assert(std::ranges::size(out) > size());
+        const auto r_sq = norm_sq(r);
+        out[size()]     = value_type{ 0 };
+        out[0]          = value_type{ 1 } / std::sqrt(r_sq);
+        for (auto n = 1uz; n != size(); ++n)
+        {
+            auto const& rec    = m_derivative_recurrence[n];
+            auto        first  = value_type{ 0 };
+            auto        second = value_type{ 0 };
+            for (auto i = 0uz; i != N; ++i)
+            {
+                first  += r[i] * out[rec.minus_one[i]];
+                second += out[rec.minus_two[i]];
+            }
+            out[n] = -(rec.first_factor * first + rec.second_factor * second) / r_sq;
+        }
+        for (auto n = 1uz; n != size(); ++n)
+        {
+            out[n] *= m_factorials[n];
+        }
+    }
+
+    [[nodiscard]]
+    static auto norm_sq(point_t const& x) noexcept -> value_type
+    {
+        auto sq = value_type{ 0 };
+        for (auto const e : x)
+        {
+            sq += e * e;
+        }
+        return sq;
+    }
+
+    // Adds a point mass at offset b from the center
+    auto p2m(value_type mass, point_t const& b, std::span<value_type> multipole)
+        const noexcept -> void
+    {
+        auto pw = std::array<value_type, s_max_terms>{};
+        powers(b, pw);
+        for (auto n = 0uz; n != size(); ++n)
+        {
+            multipole[n] += mass * pw[n];
+        }
+    }
+
+    // Adds a child multipole to the parent's, s is the child center minus the parent
+    // center
+    auto m2m(
+        std::span<value_type const> child,
+        point_t const&              s,
+        std::span<value_type>       parent
+    ) const noexcept -> void
+    {
+        auto pw = std::array<value_type, s_max_terms>{};
+        powers(s, pw);
+        for (auto const& t : m_shift_terms)
+        {
+            parent[t.high] += child[t.low] * pw[t.diff];
+        }
+    }
+
+    // Adds the field of a source multipole to the target local expansion, r is the
+    // target center minus the source center. L_k only needs the multipoles of order up
+    // to p - |k|, which are the first entries in graded order.
+    auto m2l(
+        std::span<value_type const> multipole,
+        point_t const&              r,
+        std::span<value_type>       local
+    ) const noexcept -> void
+    {
+        auto signed_multipole = std::array<value_type, s_max_terms>{};
+        for (auto n = 0uz; n != size(); ++n)
+        {
+            signed_multipole[n] = m_signs[n] * multipole[n];
+        }
+        auto d = std::array<value_type, s_max_terms + 1>{};
+        derivatives(r, d);
+        auto const* kn = m_m2l_derivatives.data();
+        for (auto k = 0uz; k != size(); ++k)
+        {
+            const auto count = m_order_ends[m_order - m_orders[k]];
+            auto       sum   = value_type{ 0 };
+            for (auto n = 0uz; n != count; ++n)
+            {
+                sum += signed_multipole[n] * d[kn[n]];
+            }
+            local[k] += sum;
+            kn       += count;
+        }
+    }
+
+    // Multiply-adds of one M2L, the cost of a translation
+    [[nodiscard]]
+    auto m2l_cost() const noexcept -> std::size_t
+    {
+        return std::ranges::size(m_m2l_derivatives);
+    }
+
+    // Adds the parent local expansion to the child's, t is the child center minus the
+    // parent center
+    auto l2l(
+        std::span<value_type const> parent,
+        point_t const&              t,
+        std::span<value_type>       child
+    ) const noexcept -> void
+    {
+        auto pw = std::array<value_type, s_max_terms>{};
+        powers(t, pw);
+        for (auto const& s : m_shift_terms)
+        {
+            child[s.low] += parent[s.high] * pw[s.diff];
+        }
+    }
+
+    // Acceleration at offset a from the center, without the gravitational constant
+    [[nodiscard]]
+    auto l2p(std::span<value_type const> local, point_t const& a) const noexcept
+        -> point_t
+    {
+        auto pw = std::array<value_type, s_max_terms>{};
+        powers(a, pw);
+        auto acc = point_t{};
+        for (auto const& t : m_gradient_terms)
+        {
+            acc[t.axis] += local[t.local] * pw[t.power];
+        }
+        return acc;
+    }
+
+    // Orders above this do not pay off in double precision
+    inline static constexpr auto s_max_order = 10u;
+    // Multi-indices of order at most s_max_order, (s_max_order + N choose N)
+    inline static constexpr auto s_max_terms = [] {
+        auto terms = 1uz;
+        for (auto i = 1uz; i <= N; ++i)
+        {
+            terms = terms * (s_max_order + i) / i;
+        }
+        return terms;
+    }();
+
+private:
+    struct power_recurrence
+    {
+        std::uint32_t from;
+        std::uint32_t axis;
+        unsigned      exponent;
+    };
+
+    struct derivative_recurrence
+    {
+        std::array<std::uint32_t, N> minus_one;
+        std::array<std::uint32_t, N> minus_two;
+        value_type                   first_factor;  // (2|n| - 1) / |n|
+        value_type                   second_factor; // (|n| - 1) / |n|
+    };
+
+    // high += low * x^diff / diff!, with high = low + diff
+    struct shift_term
+    {
+        std::uint32_t high;
+        std::uint32_t low;
+        std::uint32_t diff;
+    };
+
+    // acc[axis] += local * a^power / power!
+    struct gradient_term
+    {
+        std::uint32_t axis;
+        std::uint32_t local;
+        std::uint32_t power;
+    };
+
+    auto build_indices() -> void
+    {
+        assert(m_order <= s_max_order);
+        // Every index with entries up to the order, sorted by total order
+        auto n = multi_index_t{};
+        while (true)
+        {
+            if (std::ranges::fold_left(n, 0u, std::plus{}) <= m_order)
+            {
+                m_indices.push_back(n);
+            }
+            auto i = 0uz;
+            while (i != N && n[i] == m_order)
+            {
+                n[i++] = 0;
+            }
+            if (i == N)
+            {
+                break;
+            }
+            ++n[i];
+        }
+        std::ranges::stable_sort(m_indices, std::less{}, [](auto const& idx) {
+            return std::ranges::fold_left(idx, 0u, std::plus{});
+        });
+        m_order_ends.assign(m_order + 1, 0uz);
+        for (auto const& idx : m_indices)
+        {
+            const auto order = std::ranges::fold_left(idx, 0u, std::plus{});
+            m_orders.push_back(order);
+            m_signs.push_back(order % 2 == 0 ? value_type{ 1 } : value_type{ -1 });
+            for (auto q = order; q <= m_order; ++q)
+            {
+                ++m_order_ends[q];
+            }
+            m_factorials.push_back(std::ranges::fold_left(
+                idx, value_type{ 1 }, [](auto acc, auto e) { return acc * factorial(e); }
+            ));
+        }
+    }
+
+    auto build_tables() -> void
+    {
+        m_power_recurrence.resize(size());
+        m_derivative_recurrence.resize(size());
+        for (auto n = 1uz; n != size(); ++n)
+        {
+            auto const& idx  = m_indices[n];
+            const auto  axis = static_cast<std::size_t>(
+                std::ranges::find_if(idx, [](auto e) { return e != 0; }) -
+                std::ranges::begin(idx)
+            );
+            auto from = idx;
+            --from[axis];
+            m_power_recurrence[n] = { index_of(from),
+                                      static_cast<std::uint32_t>(axis),
+                                      idx[axis] };
+            // Missing terms point past the last coefficient
+            const auto none = static_cast<std::uint32_t>(size());
+            auto&      rec  = m_derivative_recurrence[n];
+            for (auto i = 0uz; i != N; ++i)
+            {
+                auto one          = idx;
+                auto two          = idx;
+                rec.minus_one[i] = idx[i] >= 1 ? (--one[i], index_of(one)) : none;
+                rec.minus_two[i] = idx[i] >= 2 ? (two[i] -= 2, index_of(two)) : none;
+            }
+            const auto order  = static_cast<value_type>(m_orders[n]);
+            rec.first_factor  = (value_type{ 2 } * order - value_type{ 1 }) / order;
+            rec.second_factor = (order - value_type{ 1 }) / order;
+        }
+        for (auto h = 0uz; h != size(); ++h)
+        {
+            for (auto l = 0uz; l != size(); ++l)
+            {
+                if (dominates(m_indices[h], m_indices[l]))
+                {
+                    m_shift_terms.push_back(
+                        { static_cast<std::uint32_t>(h),
+                          static_cast<std::uint32_t>(l),
+                          index_of(difference(m_indices[h], m_indices[l])) }
+                    );
+                }
+            }
+        }
+        for (auto k = 0uz; k != size(); ++k)
+        {
+            for (auto n = 0uz; n != m_order_ends[m_order - m_orders[k]]; ++n)
+            {
+                m_m2l_derivatives.push_back(index_of(sum(m_indices[k], m_indices[n])));
+            }
+        }
+        for (auto k = 0uz; k != size(); ++k)
+        {
+            if (m_orders[k] == m_order)
+            {
+                continue;
+            }
+            for (auto i = 0uz; i != N; ++i)
+            {
+                auto up = m_indices[k];
+                ++up[i];
+                m_gradient_terms.push_back(
+                    { static_cast<std::uint32_t>(i),
+                      index_of(up),
+                      static_cast<std::uint32_t>(k) }
+                );
+            }
+        }
+    }
+
+    [[nodiscard]]
+    auto index_of(multi_index_t const& n) const noexcept -> std::uint32_t
+    {
+        const auto it = std::ranges::find(m_indices, n);
+        assert(it != std::ranges::end(m_indices));
+        return static_cast<std::uint32_t>(it - std::ranges::begin(m_indices));
+    }
+
+    [[nodiscard]]
+    static auto dominates(multi_index_t const& h, multi_index_t const& l) noexcept
+        -> bool
+    {
+        return std::ranges::equal(h, l, std::ranges::greater_equal{});
+    }
+
+    [[nodiscard]]
+    static auto difference(multi_index_t h, multi_index_t const& l) noexcept
+        -> multi_index_t
+    {
+        std::ranges::transform(h, l, std::ranges::begin(h), std::minus{});
+        return h;
+    }
+
+    [[nodiscard]]
+    static auto sum(multi_index_t a, multi_index_t const& b) noexcept -> multi_index_t
+    {
+        std::ranges::transform(a, b, std::ranges::begin(a), std::plus{});
+        return a;
+    }
+
+    [[nodiscard]]
+    static auto factorial(unsigned n) noexcept -> value_type
+    {
+        auto f = value_type{ 1 };
+        for (auto i = 2u; i <= n; ++i)
+        {
+            f *= static_cast<value_type>(i);
+        }
+        return f;
+    }
+
+    unsigned                           m_order;
+    std::vector<multi_index_t>         m_indices;
+    std::vector<unsigned>              m_orders;
+    // Number of indices of order at most q, for every q up to the order
+    std::vector<std::size_t>           m_order_ends;
+    std::vector<value_type>            m_signs;
+    std::vector<value_type>            m_factorials;
+    std::vector<power_recurrence>      m_power_recurrence;
+    std::vector<derivative_recurrence> m_derivative_recurrence;
+    std::vector<shift_term>            m_shift_terms;
+    // Index of k + n for every (k, n) of the M2L, grouped by k
+    std::vector<std::uint32_t>         m_m2l_derivatives;
+    std::vector<gradient_term>         m_gradient_terms;
+};
+
+} // namespace detail
+
+// Fast multipole method on the same ndtree as barnes_hut_approximation. Every
+// commit_buffer runs a full pass over the tree:
+//  - P2M: multipoles of the leaves about their center of mass
+//  - M2M: multipoles of the inner cells, bottom up
+//  - M2L: local expansions from well separated cells, found by a dual tree traversal
+//  - L2L: local expansions pushed down to the leaves
+//  - L2P and P2P: accelerations from the local expansion and the neighbouring leaves
+// get_acceleration then only reads the result.
+template <
+    pm::particle_concepts::Particle  Particle_Type,
+    pm::interaction::InteractionType Interaction_Type,
+    std::size_t                      Tree_Fanout = 2>
+class fast_multipole_method
+{
+public:
+    using particle_t    = Particle_Type;
+    using tree_t        = ndt::ndtree<Tree_Fanout, particle_t>;
+    using box_t         = typename tree_t::box_t;
+    using solver_t      = solvers::yoshida4_solver<fast_multipole_method, particle_t>;
+    using block_solver_t =
+        solvers::block_leapfrog_solver<fast_multipole_method, particle_t>;
+    using interaction_t = particle_interaction_t<particle_t, Interaction_Type>;
+    static_assert(pm::particle_concepts::Interaction<interaction_t>);
+    static_assert(
+        Interaction_Type == pm::interaction::InteractionType::Gravitational,
+        "The expansions are those of the gravitational potential"
+    );
+    using depth_t                                 = typename tree_t::depth_t;
+    using size_type                               = typename tree_t::size_type;
+    using boundary_t                              = typename tree_t::boundary_t;
+    using value_type                              = typename particle_t::value_type;
+    using acceleration_t                          = typename particle_t::acceleration_t;
+    using position_t                              = typename particle_t::position_t;
+    using velocity_t                              = typename particle_t::velocity_t;
+    using mass_t                                  = typename particle_t::mass_t;
+    using duration_t                              = std::chrono::duration<value_type>;
+    using owning_container_t                      = std::vector<particle_t>;
+    inline static constexpr auto s_dimension      = particle_t::s_dimension;
+    using expansion_t = detail::cartesian_expansion<s_dimension, value_type>;
+    using point_t                                 = typename expansion_t::point_t;
+    using cell_idx_t                              = std::uint32_t;
+    inline static constexpr auto s_working_copies = solver_t::s_working_copies;
+    using storage_t = storage::aos_storage<particle_t, s_working_copies + 1>;
+    static_assert(
+        expansion_t::s_max_order ==
+        simulation::config::fmm_specific_config<particle_t>::s_max_expansion_order
+    );
+
+    fast_multipole_method(
+        std::vector<particle_t> const&                                  particles,
+        simulation::config::simulation_common_config<particle_t> const& base_config,
+        simulation::config::fmm_specific_config<particle_t> const&      specific_config,
+        std::optional<boundary_t> tree_bounds = std::nullopt
+    ) :
+        m_simulation_duration{
+            std::chrono::duration_cast<duration_t>(base_config.duration_)
+        },
+        m_dt{ std::chrono::duration_cast<duration_t>(base_config.dt_) },
+        m_particles{ particles },
+        m_ndtree(
+            std::execution::par,
+            m_particles.stage(s_working_copies),
+            specific_config.tree_max_depth_,
+            specific_config.tree_box_capacity_,
+            tree_bounds
+        ),
+        m_simulation_size{ m_particles.size() },
+        m_solver(this, m_simulation_size, m_dt),
+        m_theta{ specific_config.theta_ },
+        m_expansion{ specific_config.expansion_order_ }
+    {
+        assert(m_dt > duration_t{ 0 });
+        assert(m_simulation_duration > duration_t{ 0 });
+        if (base_config.timestep_bins_ > 0)
+        {
+            m_block_solver.emplace(
+                this,
+                m_simulation_size,
+                m_dt,
+                base_config.timestep_bins_,
+                base_config.timestep_accuracy_,
+                std::cbrt(interaction_t::epsilon)
+            );
+        }
+    }
+
+    auto run() noexcept -> void
+    {
+        while (m_current_time < m_simulation_duration)
+        {
+            step();
+        }
+    }
+
+    auto step() noexcept -> void
+    {
+        if (m_block_solver.has_value())
+        {
+            m_block_solver->run();
+        }
+        else
+        {
+            m_solver.run();
+        }
+        m_current_time += m_dt;
+    }
+
+    [[nodiscard]]
+    auto get_acceleration(size_type, std::size_t p_idx) const noexcept -> acceleration_t
+    {
+        return m_accelerations[p_idx];
+    }
+
+    // Runs the whole pass, the accelerations of every particle of the working copy are
+    // ready afterwards. The copy is staged into the particles of the only tree first.
+    inline auto commit_buffer(std::size_t working_copy_idx) noexcept -> void
+    {
+        m_particles.stage(working_copy_idx);
+        m_ndtree.reorganize();
+        m_ndtree.regroup();
+        m_ndtree.cache_summary();
+        flatten(m_ndtree.box());
+        upward_pass();
+        traverse();
+        downward_pass();
+        evaluate();
+    }
+
+    // A pass covers every particle anyway, so individual timesteps only save the kicks
+    inline auto commit_buffer(std::size_t working_copy_idx, std::span<std::size_t const>)
+        noexcept -> void
+    {
+        commit_buffer(working_copy_idx);
+    }
+
+    [[nodiscard]]
+    inline auto current_system_state() const noexcept -> auto const&
+    {
+        return m_particles.particles(s_working_copies);
+    }
+
+    [[nodiscard]]
+    inline auto current_system_state() noexcept -> auto&
+    {
+        return m_particles.particles(s_working_copies);
+    }
+
+    [[nodiscard]]
+    inline auto tree() const noexcept -> tree_t const&
+    {
+        return m_ndtree;
+    }
+
+    [[nodiscard]]
+    inline auto expansion() const noexcept -> expansion_t const&
+    {
+        return m_expansion;
+    }
+
+    [[nodiscard]]
+    inline auto position_read(std::size_t p_idx) const noexcept -> position_t const&
+    {
+        return m_particles.position(s_working_copies, p_idx);
+    }
+
+    inline auto position_write(std::size_t p_idx, position_t value) noexcept -> void
+    {
+        m_particles.set_position(s_working_copies, p_idx, value);
+    }
+
+    [[nodiscard]]
+    inline auto position_buffer_read(std::size_t buffer_id, std::size_t p_idx)
+        const noexcept -> position_t const&
+    {
+        return m_particles.position(buffer_id, p_idx);
+    }
+
+    inline auto position_buffer_write(
+        std::size_t       buffer_id,
+        std::size_t       p_idx,
+        position_t const& value
+    ) noexcept -> void
+    {
+        m_particles.set_position(buffer_id, p_idx, value);
+    }
+
+    [[nodiscard]]
+    inline auto velocity_read(std::size_t p_idx) const noexcept -> velocity_t const&
+    {
+        return m_particles.velocity(s_working_copies, p_idx);
+    }
+
+    inline auto velocity_write(std::size_t p_idx, velocity_t value) noexcept -> void
+    {
+        m_particles.set_velocity(s_working_copies, p_idx, value);
+    }
+
+    [[nodiscard]]
+    inline auto velocity_buffer_read(std::size_t buffer_id, std::size_t p_idx)
+        const noexcept -> velocity_t const&
+    {
+        return m_particles.velocity(buffer_id, p_idx);
+    }
+
+    inline auto velocity_buffer_write(
+        std::size_t       buffer_id,
+        std::size_t       p_idx,
+        velocity_t const& value
+    ) noexcept -> void
+    {
+        m_particles.set_velocity(buffer_id, p_idx, value);
+    }
+
+    // Particle-particle interactions plus cell-cell translations
+    [[nodiscard]]
+    inline auto f_eval_count() const noexcept -> std::size_t
+    {
+        return m_f_eval_count.combine(std::plus{});
+    }
+
+private:
+    inline static constexpr auto s_no_cell = std::numeric_limits<cell_idx_t>::max();
+    // Cost of a particle-particle interaction in M2L multiply-adds
+    inline static constexpr auto s_p2p_cost = 4uz;
+
+    // Non-empty box of the tree. Cells are stored breadth first, so the children of a
+    // cell are contiguous and every level follows the previous one.
+    struct cell
+    {
+        box_t const* box;
+        point_t      center;
+        value_type   radius;
+        cell_idx_t   parent;
+        cell_idx_t   first_child;
+        cell_idx_t   child_count;
+    };
+
+    // Interaction pairs grouped by target cell, sources of target t are
+    // sources[offsets[t]] to sources[offsets[t + 1]]
+    struct interaction_lists
+    {
+        std::vector<std::pair<cell_idx_t, cell_idx_t>> pairs;
+        std::vector<std::size_t>                       offsets;
+        std::vector<cell_idx_t>                        sources;
+    };
+
+    [[nodiscard]]
+    static auto to_point(position_t const& x) noexcept -> point_t
+    {
+        auto p = point_t{};
+        for (auto i = 0uz; i != s_dimension; ++i)
+        {
+            p[i] = static_cast<value_type>(x[i]);
+        }
+        return p;
+    }
+
+    [[nodiscard]]
+    static auto offset(point_t const& to, point_t const& from) noexcept -> point_t
+    {
+        auto d = point_t{};
+        std::ranges::transform(to, from, std::ranges::begin(d), std::minus{});
+        return d;
+    }
+
+    [[nodiscard]]
+    static auto norm(point_t const& x) noexcept -> value_type
+    {
+        return std::sqrt(expansion_t::norm_sq(x));
+    }
+
+    [[nodiscard]]
+    auto multipole(cell_idx_t c) noexcept -> std::span<value_type>
+    {
+        const auto terms = m_expansion.size();
+        return std::span{ m_multipoles }.subspan(c * terms, terms);
+    }
+
+    [[nodiscard]]
+    auto local(cell_idx_t c) noexcept -> std::span<value_type>
+    {
+        const auto terms = m_expansion.size();
+        return std::span{ m_locals }.subspan(c * terms, terms);
+    }
+
+    [[nodiscard]]
+    auto leaf(cell const& c) const noexcept -> bool
+    {
+        return c.child_count == 0;
+    }
+
+    auto flatten(box_t const& root) -> void
+    {
+        m_cells.clear();
+        m_levels.assign(1, 0uz);
+        m_leaves.clear();
+        if (root.summary().has_value())
+        {
+            m_cells.push_back({ &root, {}, value_type{ 0 }, s_no_cell, 0, 0 });
+        }
+        for (auto begin = 0uz; begin != m_cells.size();)
+        {
+            const auto end = m_cells.size();
+            for (auto c = begin; c != end; ++c)
+            {
+                auto const& box   = *m_cells[c].box;
+                m_cells[c].center = to_point(box.summary().value().position());
+                if (!box.fragmented())
+                {
+                    m_leaves.push_back(static_cast<cell_idx_t>(c));
+                    continue;
+                }
+                const auto first = static_cast<cell_idx_t>(m_cells.size());
+                for (auto const& subbox : box.subboxes())
+                {
+                    if (subbox.summary().has_value())
+                    {
+                        m_cells.push_back({ &subbox,
+                                            {},
+                                            value_type{ 0 },
+                                            static_cast<cell_idx_t>(c),
+                                            0,
+                                            0 });
+                    }
+                }
+                m_cells[c].first_child = first;
+                m_cells[c].child_count = static_cast<cell_idx_t>(m_cells.size()) - first;
+            }
+            m_levels.push_back(end);
+            begin = end;
+        }
+        m_multipoles.assign(m_cells.size() * m_expansion.size(), value_type{ 0 });
+        m_locals.assign(m_cells.size() * m_expansion.size(), value_type{ 0 });
+    }
+
+    // P2M for every leaf, then M2M and the cell radii level by level from the bottom
+    auto upward_pass() -> void
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_leaves.size()),
+            [this](tbb::blocked_range<std::size_t> const& r) {
+                for (auto l = r.begin(); l != r.end(); ++l)
+                {
+                    auto& c = m_cells[m_leaves[l]];
+                    auto  m = multipole(m_leaves[l]);
+                    for (auto const* const p : c.box->contained_elements())
+                    {
+                        const auto b = offset(to_point(p->position()), c.center);
+                        m_expansion.p2m(p->mass().magnitude(), b, m);
+                        c.radius = std::max(c.radius, norm(b));
+                    }
+                }
+            }
+        );
+        for (auto level = m_levels.size() - 1; level-- != 0;)
+        {
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(m_levels[level], m_levels[level + 1]),
+                [this](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto c = r.begin(); c != r.end(); ++c)
+                    {
+                        auto& parent = m_cells[c];
+                        for (auto i = 0u; i != parent.child_count; ++i)
+                        {
+                            const auto  child_idx = parent.first_child + i;
+                            auto const& child     = m_cells[child_idx];
+                            const auto  s         = offset(child.center, parent.center);
+                            m_expansion.m2m(
+                                multipole(child_idx),
+                                s,
+                                multipole(static_cast<cell_idx_t>(c))
+                            );
+                            parent.radius =
+                                std::max(parent.radius, norm(s) + child.radius);
+                        }
+                    }
+                }
+            );
+        }
+    }
+
+    [[nodiscard]]
+    auto well_separated(cell const& a, cell const& b) const noexcept -> bool
+    {
+        return a.radius + b.radius < m_theta * norm(offset(a.center, b.center));
+    }
+
+    // Sparse leaves are summed directly even when well separated
+    [[nodiscard]]
+    auto direct_cheaper(cell const& a, cell const& b) const noexcept -> bool
+    {
+        return leaf(a) && leaf(b) &&
+               std::ranges::size(a.box->contained_elements()) *
+                       std::ranges::size(b.box->contained_elements()) * s_p2p_cost <
+                   m_expansion.m2l_cost();
+    }
+
+    // Dual tree traversal from the pair (root, root). Well separated pairs go to the
+    // M2L lists, pairs of leaves that are not to the P2P lists, and otherwise the larger
+    // cell is split. Pairs are one sided, the target is always the first cell, so both
+    // lists can be evaluated in parallel over targets.
+    auto traverse() -> void
+    {
+        m_m2l.pairs.clear();
+        m_p2p.pairs.clear();
+        m_pair_stack.clear();
+        if (!m_cells.empty())
+        {
+            m_pair_stack.emplace_back(0, 0);
+        }
+        while (!m_pair_stack.empty())
+        {
+            const auto [a_idx, b_idx] = m_pair_stack.back();
+            m_pair_stack.pop_back();
+            auto const& a = m_cells[a_idx];
+            auto const& b = m_cells[b_idx];
+            if (a_idx == b_idx)
+            {
+                if (leaf(a))
+                {
+                    m_p2p.pairs.emplace_back(a_idx, a_idx);
+                    continue;
+                }
+                for (auto i = a.first_child; i != a.first_child + a.child_count; ++i)
+                {
+                    for (auto j = a.first_child; j != a.first_child + a.child_count; ++j)
+                    {
+                        m_pair_stack.emplace_back(i, j);
+                    }
+                }
+            }
+            else if (well_separated(a, b) && !direct_cheaper(a, b))
+            {
+                m_m2l.pairs.emplace_back(a_idx, b_idx);
+            }
+            else if (leaf(a) && leaf(b))
+            {
+                m_p2p.pairs.emplace_back(a_idx, b_idx);
+            }
+            else if (leaf(b) || (!leaf(a) && a.radius >= b.radius))
+            {
+                for (auto i = a.first_child; i != a.first_child + a.child_count; ++i)
+                {
+                    m_pair_stack.emplace_back(i, b_idx);
+                }
+            }
+            else
+            {
+                for (auto j = b.first_child; j != b.first_child + b.child_count; ++j)
+                {
+                    m_pair_stack.emplace_back(a_idx, j);
+                }
+            }
+        }
+        group_by_target(m_m2l);
+        group_by_target(m_p2p);
+    }
+
+    // Counting sort of the pairs by target cell
+    auto group_by_target(interaction_lists& lists) -> void
+    {
+        lists.offsets.assign(m_cells.size() + 1, 0uz);
+        for (auto const& [target, source] : lists.pairs)
+        {
+            ++lists.offsets[target + 1];
+        }
+        std::inclusive_scan(
+            lists.offsets.begin(), lists.offsets.end(), lists.offsets.begin()
+        );
+        lists.sources.resize(lists.pairs.size());
+        auto next = lists.offsets;
+        for (auto const& [target, source] : lists.pairs)
+        {
+            lists.sources[next[target]++] = source;
+        }
+    }
+
+    // M2L into every cell, then L2L level by level from the top
+    auto downward_pass() -> void
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_cells.size()),
+            [this](tbb::blocked_range<std::size_t> const& r) {
+                auto& f_evals = m_f_eval_count.local();
+                for (auto c = r.begin(); c != r.end(); ++c)
+                {
+                    const auto target = static_cast<cell_idx_t>(c);
+                    for (auto s = m_m2l.offsets[c]; s != m_m2l.offsets[c + 1]; ++s)
+                    {
+                        const auto source = m_m2l.sources[s];
+                        m_expansion.m2l(
+                            multipole(source),
+                            offset(m_cells[target].center, m_cells[source].center),
+                            local(target)
+                        );
+                    }
+                    f_evals += m_m2l.offsets[c + 1] - m_m2l.offsets[c];
+                }
+            }
+        );
+        for (auto level = 1uz; level + 1 < m_levels.size(); ++level)
+        {
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(m_levels[level], m_levels[level + 1]),
+                [this](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto c = r.begin(); c != r.end(); ++c)
+                    {
+                        auto const& child = m_cells[c];
+                        m_expansion.l2l(
+                            local(child.parent),
+                            offset(child.center, m_cells[child.parent].center),
+                            local(static_cast<cell_idx_t>(c))
+                        );
+                    }
+                }
+            );
+        }
+    }
+
+    // L2P and P2P for the particles of every leaf. Particles outside of the tree bounds
+    // belong to no leaf and are summed directly.
+    auto evaluate() -> void
+    {
+        auto const& particles = m_particles.staged();
+        auto const* base      = particles.data();
+        const auto  G         = pm::physical_parameters<value_type>::G;
+        m_accelerations.resize(m_simulation_size);
+        m_evaluated.assign(m_simulation_size, std::uint8_t{ 0 });
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_leaves.size()),
+            [&](tbb::blocked_range<std::size_t> const& r) {
+                auto& f_evals = m_f_eval_count.local();
+                for (auto l = r.begin(); l != r.end(); ++l)
+                {
+                    const auto  target = m_leaves[l];
+                    auto const& c      = m_cells[target];
+                    for (auto const* const p : c.box->contained_elements())
+                    {
+                        const auto far = m_expansion.l2p(
+                            local(target), offset(to_point(p->position()), c.center)
+                        );
+                        auto acc = acceleration_t{};
+                        for (auto i = 0uz; i != s_dimension; ++i)
+                        {
+                            acc[i] = G * far[i];
+                        }
+                        for (auto s = m_p2p.offsets[target];
+                             s != m_p2p.offsets[target + 1];
+                             ++s)
+                        {
+                            auto const& source = m_cells[m_p2p.sources[s]];
+                            for (auto const* const other :
+                                 source.box->contained_elements())
+                            {
+                                if (other->id() != p->id()) [[likely]]
+                                {
+                                    ++f_evals;
+                                    acc = std::move(acc) +
+                                          interaction_t::acceleration_contribution(
+                                              *p, *other
+                                          );
+                                }
+                            }
+                        }
+                        const auto p_idx       = static_cast<std::size_t>(p - base);
+                        m_accelerations[p_idx] = acc;
+                        m_evaluated[p_idx]     = std::uint8_t{ 1 };
+                    }
+                }
+            }
+        );
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, m_simulation_size),
+            [&](tbb::blocked_range<std::size_t> const& r) {
+                auto& f_evals = m_f_eval_count.local();
+                for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                {
+                    if (m_evaluated[p_idx]) [[likely]]
+                    {
+                        continue;
+                    }
+                    auto acc = acceleration_t{};
+                    for (auto const& other : particles)
+                    {
+                        if (other.id() != particles[p_idx].id())
+                        {
+                            ++f_evals;
+                            acc = std::move(acc) +
+                                  interaction_t::acceleration_contribution(
+                                      particles[p_idx], other
+                                  );
+                        }
+                    }
+                    m_accelerations[p_idx] = acc;
+                }
+            }
+        );
+    }
+
+    duration_t                                           m_current_time{};
+    duration_t                                           m_simulation_duration;
+    duration_t                                           m_dt;
+    storage_t                                            m_particles;
+    tree_t                                               m_ndtree;
+    size_type                                            m_simulation_size;
+    solver_t                                             m_solver;
+    // Set when the configuration asks for individual timesteps
+    std::optional<block_solver_t>                        m_block_solver;
+    value_type                                           m_theta;
+    expansion_t                                          m_expansion;
+    // One counter per worker, reduced on read
+    mutable tbb::enumerable_thread_specific<std::size_t> m_f_eval_count{ 0uz };
+    // Pass state, rebuilt by every commit_buffer
+    std::vector<cell>                                    m_cells;
+    std::vector<std::size_t>                             m_levels;
+    std::vector<cell_idx_t>                              m_leaves;
+    std::vector<value_type>                              m_multipoles;
+    std::vector<value_type>                              m_locals;
+    std::vector<std::pair<cell_idx_t, cell_idx_t>>       m_pair_stack;
+    interaction_lists                                    m_m2l;
+    interaction_lists                                    m_p2p;
+    std::vector<acceleration_t>                          m_accelerations;
+    std::vector<std::uint8_t>                            m_evaluated;
+};
+
+} // namespace simulation::fmm
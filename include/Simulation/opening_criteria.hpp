@@ -0,0 +1,105 @@
+#pragma once
+
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Opening criteria of barnes_hut_approximation, passed to it as a template parameter.
+// accept tells whether the summary of a box may stand in for its samples, as seen from
+// a target at squared distance d_sq of the box's center of mass. acc_old is the
+// magnitude of the target's acceleration at its previous evaluation, zero when there is
+// none. Criteria that read it set s_uses_acceleration so the engine keeps it.
+
+namespace simulation::bh_approx::opening
+{
+
+// The box diagonal over the distance, s / d < theta
+struct geometric
+{
+    inline static constexpr auto s_uses_acceleration = false;
+
+    template <typename Interaction_Type, typename Box_Type, typename Value_Type>
+    [[nodiscard]]
+    static auto accept(
+        Box_Type const& box,
+        Value_Type      d_sq,
+        Value_Type      theta_sq,
+        Value_Type
+    ) noexcept -> bool
+    {
+        const auto s_sq = pm::utils::l2_norm_sq(box.diagonal_length().value());
+        return s_sq < theta_sq * d_sq;
+    }
+};
+
+// Salmon and Warren: the distance from the center of mass to the farthest corner of the
+// box over the distance, bmax / d < theta. The corners are those of the tight bounds of
+// the samples, so a center of mass close to the edge of a sparse box opens it only when
+// the samples actually reach out that far.
+struct bmax
+{
+    inline static constexpr auto s_uses_acceleration = false;
+
+    template <typename Interaction_Type, typename Box_Type, typename Value_Type>
+    [[nodiscard]]
+    static auto accept(
+        Box_Type const& box,
+        Value_Type      d_sq,
+        Value_Type      theta_sq,
+        Value_Type
+    ) noexcept -> bool
+    {
+        auto const& center = box.summary().value().position();
+        auto const& bounds = box.sample_bounds().has_value() ? box.sample_bounds().value()
+                                                             : box.extent();
+        auto        b_sq   = Value_Type{ 0 };
+        for (auto k = 0uz; k != Box_Type::s_dimension; ++k)
+        {
+            const auto x   = static_cast<Value_Type>(center[k]);
+            const auto far = std::max(
+                x - static_cast<Value_Type>(bounds.min(k)),
+                static_cast<Value_Type>(bounds.max(k)) - x
+            );
+            b_sq += far * far;
+        }
+        return b_sq < theta_sq * d_sq;
+    }
+};
+
+// Relative force error: the monopole field of the box times (s / d)^2, an estimate of
+// the error of its truncated expansion, against theta^2 times the previous acceleration
+// of the target. A target within about one diagonal of the center of mass always opens
+// the box. Without a previous acceleration, at the first evaluation, it falls back to
+// the geometric criterion.
+struct relative_error
+{
+    inline static constexpr auto s_uses_acceleration = true;
+
+    template <typename Interaction_Type, typename Box_Type, typename Value_Type>
+        requires requires(Value_Type v) { Interaction_Type::acceleration_scale(v, v); }
+    [[nodiscard]]
+    static auto accept(
+        Box_Type const& box,
+        Value_Type      d_sq,
+        Value_Type      theta_sq,
+        Value_Type      acc_old
+    ) noexcept -> bool
+    {
+        if (!(acc_old > Value_Type{ 0 }))
+        {
+            return geometric::accept<Interaction_Type>(box, d_sq, theta_sq, acc_old);
+        }
+        const auto s_sq = pm::utils::l2_norm_sq(box.diagonal_length().value());
+        if (!(s_sq < d_sq))
+        {
+            return false;
+        }
+        const auto mass =
+            static_cast<Value_Type>(box.summary().value().mass().magnitude());
+        const auto field =
+            Interaction_Type::acceleration_scale(d_sq, mass) * std::sqrt(d_sq);
+        return field * s_sq < theta_sq * acc_old * d_sq;
+    }
+};
+
+} // namespace simulation::bh_approx::opening
@@ -20,7 +20,47 @@ enum struct SimulationType
 {
     _none_,
     barnes_hut,
-    brute_force
+    brute_force,
+    fmm
+};
+
+// Kernel brute_force_computation evaluates all the accelerations with: every target
+// summed over every source in SIMD packs, or every unordered pair evaluated once with
+// both of its contributions written. The pairs halve the interactions at the cost of
+// scattered writes. Interactions without a SIMD kernel always take the pairs.
+enum struct BruteForceKernel
+{
+    simd,
+    pairwise
+};
+
+// How barnes_hut_approximation walks the tree: once per particle, once per leaf
+// bucket with an interaction list shared by the particles of the bucket, or once for
+// the whole tree against itself, with cell-cell interactions pushed down to the
+// particles
+enum struct TraversalType
+{
+    particle,
+    group,
+    dual
+};
+
+// How barnes_hut_approximation reorganizes the tree after particles moved: choosing
+// between the two below from the migration it finds, relocating the particles that left
+// their leaves, or building the tree again
+enum struct TreeReorganizeType
+{
+    adaptive,
+    relocate,
+    rebuild
+};
+
+// Space filling curve barnes_hut_approximation sorts the particles along when it
+// reorders them
+enum struct ReorderCurveType
+{
+    morton,
+    hilbert
 };
 
 namespace detail
@@ -32,7 +72,8 @@ inline auto simulation_type_parse(std::string_view sim_type) -> SimulationType
     using namespace std::literals;
     static const std::unordered_map<std::string_view, SimulationType> map{
         { "barnes_hut"sv, SimulationType::barnes_hut },
-        { "brute_force"sv, SimulationType::brute_force }
+        { "brute_force"sv, SimulationType::brute_force },
+        { "fmm"sv, SimulationType::fmm }
     };
     return map.at(sim_type);
 }
@@ -43,11 +84,104 @@ inline auto simulation_type_to_str(SimulationType sim_type) -> std::string_view
     using namespace std::literals;
     static const std::unordered_map<SimulationType, std::string_view> map{
         { SimulationType::barnes_hut, "barnes_hut"sv },
-        { SimulationType::brute_force, "brute_force"sv }
+        { SimulationType::brute_force, "brute_force"sv },
+        { SimulationType::fmm, "fmm"sv }
     };
     return map.at(sim_type);
 }
 
+[[nodiscard]]
+inline auto brute_force_kernel_parse(std::string_view kernel) -> BruteForceKernel
+{
+    using namespace std::literals;
+    static const std::unordered_map<std::string_view, BruteForceKernel> map{
+        { "simd"sv, BruteForceKernel::simd },
+        { "pairwise"sv, BruteForceKernel::pairwise }
+    };
+    return map.at(kernel);
+}
+
+[[nodiscard]]
+inline auto brute_force_kernel_to_str(BruteForceKernel kernel) -> std::string_view
+{
+    using namespace std::literals;
+    static const std::unordered_map<BruteForceKernel, std::string_view> map{
+        { BruteForceKernel::simd, "simd"sv },
+        { BruteForceKernel::pairwise, "pairwise"sv }
+    };
+    return map.at(kernel);
+}
+
+[[nodiscard]]
+inline auto traversal_type_parse(std::string_view traversal) -> TraversalType
+{
+    using namespace std::literals;
+    static const std::unordered_map<std::string_view, TraversalType> map{
+        { "particle"sv, TraversalType::particle },
+        { "group"sv, TraversalType::group },
+        { "dual"sv, TraversalType::dual }
+    };
+    return map.at(traversal);
+}
+
+[[nodiscard]]
+inline auto traversal_type_to_str(TraversalType traversal) -> std::string_view
+{
+    using namespace std::literals;
+    static const std::unordered_map<TraversalType, std::string_view> map{
+        { TraversalType::particle, "particle"sv },
+        { TraversalType::group, "group"sv },
+        { TraversalType::dual, "dual"sv }
+    };
+    return map.at(traversal);
+}
+
+[[nodiscard]]
+inline auto tree_reorganize_type_parse(std::string_view reorganize) -> TreeReorganizeType
+{
+    using namespace std::literals;
+    static const std::unordered_map<std::string_view, TreeReorganizeType> map{
+        { "adaptive"sv, TreeReorganizeType::adaptive },
+        { "relocate"sv, TreeReorganizeType::relocate },
+        { "rebuild"sv, TreeReorganizeType::rebuild }
+    };
+    return map.at(reorganize);
+}
+
+[[nodiscard]]
+inline auto tree_reorganize_type_to_str(TreeReorganizeType reorganize) -> std::string_view
+{
+    using namespace std::literals;
+    static const std::unordered_map<TreeReorganizeType, std::string_view> map{
+        { TreeReorganizeType::adaptive, "adaptive"sv },
+        { TreeReorganizeType::relocate, "relocate"sv },
+        { TreeReorganizeType::rebuild, "rebuild"sv }
+    };
+    return map.at(reorganize);
+}
+
+[[nodiscard]]
+inline auto reorder_curve_type_parse(std::string_view curve) -> ReorderCurveType
+{
+    using namespace std::literals;
+    static const std::unordered_map<std::string_view, ReorderCurveType> map{
+        { "morton"sv, ReorderCurveType::morton },
+        { "hilbert"sv, ReorderCurveType::hilbert }
+    };
+    return map.at(curve);
+}
+
+[[nodiscard]]
+inline auto reorder_curve_type_to_str(ReorderCurveType curve) -> std::string_view
+{
+    using namespace std::literals;
+    static const std::unordered_map<ReorderCurveType, std::string_view> map{
+        { ReorderCurveType::morton, "morton"sv },
+        { ReorderCurveType::hilbert, "hilbert"sv }
+    };
+    return map.at(curve);
+}
+
 } // namespace detail
 
 template <pm::particle_concepts::Particle Particle_Type>
@@ -114,6 +248,7 @@ struct simulation_common_config
     using value_type = typename Particle_Type::value_type;
     using size_type  = std::size_t;
     using duration_t = std::chrono::duration<value_type>;
+    inline static constexpr auto s_max_timestep_bins = 30u;
 
     [[nodiscard]]
     auto is_valid() const noexcept -> bool
@@ -142,6 +277,22 @@ struct simulation_common_config
             );
             return false;
         }
+        if (timestep_bins_ > s_max_timestep_bins)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "Timestep bins must be at most 30.\n"
+            );
+            return false;
+        }
+        if (timestep_accuracy_ <= 0)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "Timestep accuracy must be positive.\n"
+            );
+            return false;
+        }
         return true;
     }
 
@@ -152,13 +303,20 @@ struct simulation_common_config
                   << "\tDuration: " << duration_.count() << " seconds\n"
                   << "\tParticle Count: " << particle_count_ << "\n"
                   << "\tSimulation Type: " << detail::simulation_type_to_str(sim_type_)
-                  << "\n";
+                  << "\n"
+                  << "\tTimestep Bins: " << timestep_bins_ << "\n"
+                  << "\tTimestep Accuracy: " << timestep_accuracy_ << "\n";
     }
 
     duration_t     dt_;
     duration_t     duration_;
     size_type      particle_count_;
     SimulationType sim_type_;
+    // Individual timesteps down to dt / 2^timestep_bins_ with the block leapfrog solver,
+    // 0 advances every particle with dt through the Yoshida solver
+    unsigned       timestep_bins_     = 0;
+    // eta of the individual timestep criterion
+    value_type     timestep_accuracy_ = static_cast<value_type>(0.1);
 };
 
 template <pm::particle_concepts::Particle Particle_Type>
@@ -172,7 +330,11 @@ struct brute_force_specific_config
 
     auto print() const noexcept -> void
     {
+        std::cout << "Brute Force Specific Config:\n"
+                  << "\tKernel: " << detail::brute_force_kernel_to_str(kernel_) << "\n";
     }
+
+    BruteForceKernel kernel_ = BruteForceKernel::simd;
 };
 
 template <pm::particle_concepts::Particle Particle_Type>
@@ -211,6 +373,23 @@ struct barnes_hut_specific_config
             );
             return false;
         }
+        if (mixed_precision_ && traversal_ != TraversalType::group)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "Mixed precision is only available with the group traversal.\n"
+            );
+            return false;
+        }
+        if (mixed_precision_ && quadrupole_)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "Mixed precision only evaluates monopoles, it cannot be combined with "
+                "the quadrupole.\n"
+            );
+            return false;
+        }
         return true;
     }
 
@@ -219,12 +398,106 @@ struct barnes_hut_specific_config
         std::cout << "Barnes-Hut Specific Config:\n"
                   << "\tTree Max Depth: " << tree_max_depth_ << "\n"
                   << "\tTree Box Capacity: " << tree_box_capacity_ << "\n"
-                  << "\tTheta: " << theta_ << "\n";
+                  << "\tTheta: " << theta_ << "\n"
+                  << "\tTree Regroup: " << std::boolalpha << tree_regroup_
+                  << std::noboolalpha << "\n"
+                  << "\tTraversal: " << detail::traversal_type_to_str(traversal_)
+                  << "\n"
+                  << "\tQuadrupole: " << std::boolalpha << quadrupole_ << std::noboolalpha
+                  << "\n"
+                  << "\tTree Refit: " << std::boolalpha << tree_refit_ << std::noboolalpha
+                  << "\n"
+                  << "\tTree Reorganize: "
+                  << detail::tree_reorganize_type_to_str(tree_reorganize_) << "\n"
+                  << "\tTree Relocation Cost: " << tree_relocation_cost_ << "\n"
+                  << "\tMixed Precision: " << std::boolalpha << mixed_precision_
+                  << std::noboolalpha << "\n"
+                  << "\tReorder Interval: " << reorder_interval_ << "\n"
+                  << "\tReorder Curve: "
+                  << detail::reorder_curve_type_to_str(reorder_curve_) << "\n";
+    }
+
+    depth_t            tree_max_depth_;
+    size_type          tree_box_capacity_;
+    value_type         theta_;
+    bool               tree_regroup_ = true;
+    TraversalType      traversal_    = TraversalType::particle;
+    bool               quadrupole_   = false;
+    // Reorganize the tree once per step and only refit it for the substages
+    bool               tree_refit_      = false;
+    TreeReorganizeType tree_reorganize_ = TreeReorganizeType::adaptive;
+    // Weight of a level relocated against a level built, for the adaptive reorganize
+    value_type         tree_relocation_cost_ = value_type{ 4 };
+    // Monopole far field of the group walk in float, accumulated in value_type
+    bool               mixed_precision_ = false;
+    // Steps between sorts of the particles along reorder_curve_, none with 0
+    size_type          reorder_interval_ = 0;
+    ReorderCurveType   reorder_curve_    = ReorderCurveType::hilbert;
+};
+
+template <pm::particle_concepts::Particle Particle_Type>
+struct fmm_specific_config
+{
+    using value_type = simulation_common_config<Particle_Type>::value_type;
+    using size_type  = simulation_common_config<Particle_Type>::size_type;
+    using depth_t    = unsigned int;
+    inline static constexpr auto s_theta_range =
+        utility::generics::interval{ value_type{ 0 }, value_type{ 1 } };
+    inline static constexpr auto s_max_expansion_order = 10u;
+
+    [[nodiscard]]
+    auto is_valid() const noexcept -> bool
+    {
+        if (tree_max_depth_ <= 0)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "ndTree max depth must be greater than 0.\n"
+            );
+            return false;
+        }
+        if (tree_box_capacity_ <= 0)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "ndTree box capacity must be greater than 0.\n"
+            );
+            return false;
+        }
+        if (!utility::generics::in(theta_, s_theta_range) || theta_ <= 0)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "FMM opening angle theta must be in the range (0, 1].\n"
+            );
+            return false;
+        }
+        if (expansion_order_ < 1 || expansion_order_ > s_max_expansion_order)
+        {
+            utility::logging::default_source::log(
+                utility::logging::severity_level::error,
+                "FMM expansion order must be in the range [1, 10].\n"
+            );
+            return false;
+        }
+        return true;
+    }
+
+    auto print() const noexcept -> void
+    {
+        std::cout << "FMM Specific Config:\n"
+                  << "\tTree Max Depth: " << tree_max_depth_ << "\n"
+                  << "\tTree Box Capacity: " << tree_box_capacity_ << "\n"
+                  << "\tTheta: " << theta_ << "\n"
+                  << "\tExpansion Order: " << expansion_order_ << "\n";
     }
 
     depth_t    tree_max_depth_;
     size_type  tree_box_capacity_;
+    // Cells A and B interact through their expansions when
+    // r_A + r_B < theta * |z_A - z_B|, with r the radius about the center of mass z
     value_type theta_;
+    unsigned   expansion_order_ = 4;
 };
 
 template <pm::particle_concepts::Particle Particle_Type>
@@ -234,6 +507,7 @@ struct simulation_config
     using base_config_t     = simulation_common_config<Particle_Type>;
     using bf_config_t       = brute_force_specific_config<Particle_Type>;
     using bh_config_t       = barnes_hut_specific_config<Particle_Type>;
+    using fmm_config_t      = fmm_specific_config<Particle_Type>;
     using physics_config_t  = physics_config<Particle_Type>;
     using universe_config_t = universe_config<Particle_Type>;
 
@@ -262,16 +536,30 @@ struct simulation_config
         return simulation_general_config_;
     }
 
+    // The defaults when the configuration is for another simulation type
+    [[nodiscard]]
+    inline auto brute_force_config() const noexcept -> bf_config_t
+    {
+        auto const* const cfg = std::get_if<bf_config_t>(&simulation_specific_config_);
+        return cfg != nullptr ? *cfg : bf_config_t{};
+    }
+
     [[nodiscard]]
     inline auto barnes_hut_config() const noexcept -> bh_config_t const&
     {
         return std::get<bh_config_t>(simulation_specific_config_);
     }
 
-    physics_config_t                       physics_config_;
-    universe_config_t                      universe_config_;
-    base_config_t                          simulation_general_config_;
-    std::variant<bf_config_t, bh_config_t> simulation_specific_config_;
+    [[nodiscard]]
+    inline auto fmm_config() const noexcept -> fmm_config_t const&
+    {
+        return std::get<fmm_config_t>(simulation_specific_config_);
+    }
+
+    physics_config_t                                     physics_config_;
+    universe_config_t                                    universe_config_;
+    base_config_t                                        simulation_general_config_;
+    std::variant<bf_config_t, bh_config_t, fmm_config_t> simulation_specific_config_;
 };
 
 template <pm::particle_concepts::Particle Particle_Type>
@@ -286,6 +574,14 @@ auto parse_config(std::string const& file_path) -> simulation_config<Particle_Ty
             "GeneralConfig.simulation_type",
             po::value<std::string>(),
             "Simulation approximaton type"
+        )(
+            "GeneralConfig.timestep_bins",
+            po::value<unsigned int>(),
+            "Power-of-two individual timestep bins below dt"
+        )(
+            "GeneralConfig.timestep_accuracy",
+            po::value<value_type>(),
+            "Individual timestep accuracy parameter"
         );
 
     po::options_description physics_desc("Physics Configuration");
@@ -300,14 +596,64 @@ auto parse_config(std::string const& file_path) -> simulation_config<Particle_Ty
         "UniverseConfig.universe_radius", po::value<value_type>(), "Universe radius"
     );
 
+    po::options_description brute_force_desc("Brute Force Configuration");
+    brute_force_desc.add_options()(
+        "BruteForceConfig.kernel", po::value<std::string>(), "Kernel, simd or pairwise"
+    );
+
     po::options_description barnes_hut_desc("Barnes-Hut Configuration");
     barnes_hut_desc
         .add_options()("BarnesHutConfig.tree_max_depth", po::value<unsigned int>(), "Max tree depth")("BarnesHutConfig.tree_box_capacity", po::value<std::size_t>(), "Box capacity")(
             "BarnesHutConfig.theta", po::value<value_type>(), "Theta parameter"
+        )(
+            "BarnesHutConfig.tree_regroup", po::value<bool>(), "Regroup sparse boxes"
+        )(
+            "BarnesHutConfig.traversal",
+            po::value<std::string>(),
+            "Tree walk per particle, per leaf bucket or dual tree"
+        )(
+            "BarnesHutConfig.quadrupole",
+            po::value<bool>(),
+            "Quadrupole far field for accepted cells"
+        )(
+            "BarnesHutConfig.tree_refit",
+            po::value<bool>(),
+            "Refit the tree instead of reorganizing it between substages"
+        )(
+            "BarnesHutConfig.tree_reorganize",
+            po::value<std::string>(),
+            "Relocate escaped particles, rebuild the tree, or choose adaptively"
+        )(
+            "BarnesHutConfig.tree_relocation_cost",
+            po::value<value_type>(),
+            "Cost of a level relocated against a level built, for adaptive reorganize"
+        )(
+            "BarnesHutConfig.mixed_precision",
+            po::value<bool>(),
+            "Single precision far field for the group traversal"
+        )(
+            "BarnesHutConfig.reorder_interval",
+            po::value<std::size_t>(),
+            "Steps between sorts of the particles along a space filling curve, 0 for none"
+        )(
+            "BarnesHutConfig.reorder_curve",
+            po::value<std::string>(),
+            "Space filling curve the particles are sorted along, morton or hilbert"
         );
 
+    po::options_description fmm_desc("FMM Configuration");
+    fmm_desc.add_options()(
+        "FmmConfig.tree_max_depth", po::value<unsigned int>(), "Max tree depth"
+    )("FmmConfig.tree_box_capacity", po::value<std::size_t>(), "Box capacity")(
+        "FmmConfig.theta", po::value<value_type>(), "Opening angle"
+    )("FmmConfig.expansion_order", po::value<unsigned int>(), "Expansion order");
+
     po::options_description all_desc;
-    all_desc.add(general_desc).add(physics_desc).add(barnes_hut_desc);
+    all_desc.add(general_desc)
+        .add(physics_desc)
+        .add(brute_force_desc)
+        .add(barnes_hut_desc)
+        .add(fmm_desc);
 
     // Parse the configuration file
     po::variables_map vm;
@@ -349,6 +695,16 @@ auto parse_config(std::string const& file_path) -> simulation_config<Particle_Ty
             vm["GeneralConfig.simulation_type"].as<std::string>()
         );
     }
+    if (vm.contains("GeneralConfig.timestep_bins"))
+    {
+        config.simulation_general_config_.timestep_bins_ =
+            vm["GeneralConfig.timestep_bins"].as<unsigned int>();
+    }
+    if (vm.contains("GeneralConfig.timestep_accuracy"))
+    {
+        config.simulation_general_config_.timestep_accuracy_ =
+            vm["GeneralConfig.timestep_accuracy"].as<value_type>();
+    }
 
     if (vm.count("PhysicsConfig.gravitational_constant"))
     {
@@ -364,7 +720,19 @@ auto parse_config(std::string const& file_path) -> simulation_config<Particle_Ty
                 .as<typename universe_config<Particle_Type>::value_type>();
     }
 
-    if (config.simulation_general_config_.sim_type_ == SimulationType::barnes_hut)
+    if (config.simulation_general_config_.sim_type_ == SimulationType::brute_force)
+    {
+        brute_force_specific_config<Particle_Type> bf_config{};
+        if (vm.contains("BruteForceConfig.kernel"))
+        {
+            bf_config.kernel_ = detail::brute_force_kernel_parse(
+                vm["BruteForceConfig.kernel"].as<std::string>()
+            );
+        }
+
+        config.simulation_specific_config_ = bf_config;
+    }
+    else if (config.simulation_general_config_.sim_type_ == SimulationType::barnes_hut)
     {
         barnes_hut_specific_config<Particle_Type> bh_config{};
         if (vm.count("BarnesHutConfig.tree_max_depth"))
@@ -385,9 +753,82 @@ auto parse_config(std::string const& file_path) -> simulation_config<Particle_Ty
                 vm["BarnesHutConfig.theta"]
                     .as<typename barnes_hut_specific_config<Particle_Type>::value_type>();
         }
+        if (vm.count("BarnesHutConfig.tree_regroup"))
+        {
+            bh_config.tree_regroup_ = vm["BarnesHutConfig.tree_regroup"].as<bool>();
+        }
+        if (vm.contains("BarnesHutConfig.traversal"))
+        {
+            bh_config.traversal_ = detail::traversal_type_parse(
+                vm["BarnesHutConfig.traversal"].as<std::string>()
+            );
+        }
+        if (vm.contains("BarnesHutConfig.quadrupole"))
+        {
+            bh_config.quadrupole_ = vm["BarnesHutConfig.quadrupole"].as<bool>();
+        }
+        if (vm.contains("BarnesHutConfig.tree_refit"))
+        {
+            bh_config.tree_refit_ = vm["BarnesHutConfig.tree_refit"].as<bool>();
+        }
+        if (vm.contains("BarnesHutConfig.tree_reorganize"))
+        {
+            bh_config.tree_reorganize_ = detail::tree_reorganize_type_parse(
+                vm["BarnesHutConfig.tree_reorganize"].as<std::string>()
+            );
+        }
+        if (vm.contains("BarnesHutConfig.tree_relocation_cost"))
+        {
+            bh_config.tree_relocation_cost_ =
+                vm["BarnesHutConfig.tree_relocation_cost"]
+                    .as<typename barnes_hut_specific_config<Particle_Type>::value_type>();
+        }
+        if (vm.contains("BarnesHutConfig.mixed_precision"))
+        {
+            bh_config.mixed_precision_ = vm["BarnesHutConfig.mixed_precision"].as<bool>();
+        }
+        if (vm.contains("BarnesHutConfig.reorder_interval"))
+        {
+            bh_config.reorder_interval_ =
+                vm["BarnesHutConfig.reorder_interval"].as<std::size_t>();
+        }
+        if (vm.contains("BarnesHutConfig.reorder_curve"))
+        {
+            bh_config.reorder_curve_ = detail::reorder_curve_type_parse(
+                vm["BarnesHutConfig.reorder_curve"].as<std::string>()
+            );
+        }
 
         config.simulation_specific_config_ = bh_config;
     }
+    else if (config.simulation_general_config_.sim_type_ == SimulationType::fmm)
+    {
+        fmm_specific_config<Particle_Type> fmm_config{};
+        if (vm.contains("FmmConfig.tree_max_depth"))
+        {
+            fmm_config.tree_max_depth_ =
+                vm["FmmConfig.tree_max_depth"]
+                    .as<typename fmm_specific_config<Particle_Type>::depth_t>();
+        }
+        if (vm.contains("FmmConfig.tree_box_capacity"))
+        {
+            fmm_config.tree_box_capacity_ =
+                vm["FmmConfig.tree_box_capacity"]
+                    .as<typename fmm_specific_config<Particle_Type>::size_type>();
+        }
+        if (vm.contains("FmmConfig.theta"))
+        {
+            fmm_config.theta_ =
+                vm["FmmConfig.theta"]
+                    .as<typename fmm_specific_config<Particle_Type>::value_type>();
+        }
+        if (vm.contains("FmmConfig.expansion_order"))
+        {
+            fmm_config.expansion_order_ = vm["FmmConfig.expansion_order"].as<unsigned>();
+        }
+
+        config.simulation_specific_config_ = fmm_config;
+    }
 
     return config;
 }
@@ -0,0 +1,338 @@
+#pragma once
+
+#include "concepts.hpp"
+#include "particle_concepts.hpp"
+#include "utils.hpp"
+#include "yoshida.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <utility>
+#include <vector>
+
+// Kick drift kick leapfrog with individual timesteps in power-of-two blocks. Every
+// particle sits in a bin b and advances with dt / 2^b, down to dt / 2^Bins. Time is
+// counted in ticks of the finest step and jumps from one tick on which some step ends
+// to the next, every particle drifting across the gap at once. Only the particles whose
+// step ends on a tick have their force evaluated and are kicked. All of them end their
+// step on the last tick, so the state is synchronized once run returns.
+//
+// A particle picks its bin when its step ends, from the timestep
+//   eta * min(sqrt(l / |a|), |a| / |da/dt|)
+// with l the softening length of the interaction and da/dt the change of its
+// acceleration over the step just taken. It may move to a finer bin on any tick, and to
+// a coarser one only on a tick the coarser steps share, so the bins stay nested.
+//
+// Systems commit the current state for a set of active particles, after which
+// get_acceleration holds for those particles only:
+//   commit_buffer(system_t::s_working_copies, active)
+
+namespace solvers
+{
+
+using namespace pm;
+
+template <typename System, particle_concepts::Particle Particle_Type>
+struct block_leapfrog_solver
+{
+    using particle_t     = Particle_Type;
+    using system_t       = System;
+    using value_type     = typename particle_t::value_type;
+    using acceleration_t = typename particle_t::acceleration_t;
+    using duration_t     = std::chrono::duration<value_type>; // default is seconds
+    using bin_t          = std::uint8_t;
+    // Finest bin there can be, ticks are counted in a std::size_t
+    inline static constexpr auto s_max_bins = 30u;
+    // Smallest range of active particles handed to a worker in the force phase, and of
+    // the kick and drift loops, as in the Yoshida solver
+    inline static constexpr auto s_parallel_grain = std::size_t{ 16 };
+    inline static constexpr auto s_bulk_grain     = std::size_t{ 4096 };
+    inline static constexpr auto s_dimension = particle_t::s_dimension;
+
+    system_t*                   system_;
+    std::size_t                 size_;
+    duration_t                  dt_;
+    unsigned                    bins_;
+    value_type                  accuracy_;
+    value_type                  length_;
+    bool                        started_ = false;
+    std::vector<bin_t>          bin_;
+    // At the start of every particle's current step
+    std::vector<acceleration_t> acceleration_;
+    std::vector<std::size_t>    active_;
+
+    block_leapfrog_solver(
+        system_t*                              system,
+        std::size_t                            size,
+        utility::concepts::Duration auto const delta_t,
+        unsigned                               bins,
+        value_type                             accuracy,
+        value_type                             softening_length
+    ) :
+        system_{ system },
+        size_{ size },
+        dt_{ delta_t },
+        bins_{ std::min(bins, s_max_bins) },
+        accuracy_{ accuracy },
+        length_{ softening_length },
+        bin_(size, static_cast<bin_t>(bins_)),
+        acceleration_(size)
+    {
+    }
+
+    // Ticks in a step of a bin
+    [[nodiscard]]
+    auto ticks(unsigned bin) const noexcept -> std::size_t
+    {
+        return std::size_t{ 1 } << (bins_ - bin);
+    }
+
+    [[nodiscard]]
+    auto step(unsigned bin) const noexcept -> value_type
+    {
+        return dt_.count() / static_cast<value_type>(std::size_t{ 1 } << bin);
+    }
+
+    auto run() -> void
+    {
+        const auto current = system_t::s_working_copies;
+        const auto last    = ticks(0);
+        const auto tick    = step(bins_);
+        if (!started_)
+        {
+            active_.resize(size_);
+            std::iota(active_.begin(), active_.end(), std::size_t{ 0 });
+            system_->commit_buffer(current, std::span<std::size_t const>(active_));
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, size_, s_parallel_grain),
+                [this, current](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                    {
+                        const auto a         = system_->get_acceleration(current, p_idx);
+                        const auto bin       = wanted_bin(a, nullptr, value_type{ 0 });
+                        acceleration_[p_idx] = a;
+                        bin_[p_idx]          = static_cast<bin_t>(bin);
+                    }
+                }
+            );
+            started_ = true;
+        }
+
+        // Every particle starts a step on the first tick
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, size_, s_bulk_grain),
+            [this](tbb::blocked_range<std::size_t> const& r) {
+                for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                {
+                    kick(
+                        p_idx,
+                        acceleration_[p_idx],
+                        value_type{ 0.5 } * step(bin_[p_idx])
+                    );
+                }
+            }
+        );
+        // Steps of a bin end on the multiples of its ticks, and those of the finest
+        // occupied bin are the first to end
+        auto finest = std::ranges::fold_left(bin_, 0u, [](unsigned acc, bin_t b) {
+            return std::max(acc, unsigned{ b });
+        });
+        for (auto t = std::size_t{ 0 }; t != last;)
+        {
+            const auto next = (t / ticks(finest) + 1) * ticks(finest);
+            drift(static_cast<value_type>(next - t) * tick);
+            t = next;
+            active_.clear();
+            auto idle_finest = 0u;
+            for (auto p_idx = 0uz; p_idx != size_; ++p_idx)
+            {
+                if (t % ticks(bin_[p_idx]) == 0)
+                {
+                    active_.push_back(p_idx);
+                }
+                else
+                {
+                    idle_finest = std::max(idle_finest, unsigned{ bin_[p_idx] });
+                }
+            }
+            if (active_.empty())
+            {
+                continue;
+            }
+            system_->commit_buffer(current, std::span<std::size_t const>(active_));
+
+            // Every active particle only writes its own slots
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, active_.size(), s_parallel_grain),
+                [this, current, t, last](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto i = r.begin(); i != r.end(); ++i)
+                    {
+                        const auto p_idx = active_[i];
+                        const auto a     = system_->get_acceleration(current, p_idx);
+                        const auto h     = step(bin_[p_idx]);
+                        const auto bin   = rebin(
+                            bin_[p_idx], wanted_bin(a, &acceleration_[p_idx], h), t
+                        );
+                        // Closes the step just taken and opens the next one, unless
+                        // this is the last tick
+                        auto kick_length = value_type{ 0.5 } * h;
+                        if (t != last)
+                        {
+                            kick_length += value_type{ 0.5 } * step(bin);
+                        }
+                        kick(p_idx, a, kick_length);
+                        acceleration_[p_idx] = a;
+                        bin_[p_idx]          = static_cast<bin_t>(bin);
+                    }
+                }
+            );
+            finest = std::ranges::fold_left(
+                active_, idle_finest, [this](unsigned acc, std::size_t p_idx) {
+                    return std::max(acc, unsigned{ bin_[p_idx] });
+                }
+            );
+        }
+    }
+
+    // Follows a reordering of the system, the particle at order[i] moving to i
+    auto reorder(std::span<std::size_t const> order) -> void
+    {
+        auto bins          = std::vector<bin_t>(size_);
+        auto accelerations = std::vector<acceleration_t>(size_);
+        for (auto p_idx = 0uz; p_idx != size_; ++p_idx)
+        {
+            bins[p_idx]          = bin_[order[p_idx]];
+            accelerations[p_idx] = acceleration_[order[p_idx]];
+        }
+        bin_          = std::move(bins);
+        acceleration_ = std::move(accelerations);
+    }
+
+    // Particles in every bin, from 0 up to bins_
+    [[nodiscard]]
+    auto occupancy() const -> std::vector<std::size_t>
+    {
+        auto ret = std::vector<std::size_t>(bins_ + 1, 0uz);
+        for (auto const b : bin_)
+        {
+            ++ret[b];
+        }
+        return ret;
+    }
+
+private:
+    auto kick(std::size_t p_idx, acceleration_t const& a, value_type h) -> void
+    {
+        system_->velocity_write(p_idx, system_->velocity_read(p_idx) + h * a);
+    }
+
+    // x += v * h over every particle, through the bulk interface when the system has it
+    auto drift(value_type h) -> void
+    {
+        if constexpr (bulk_system<system_t>)
+        {
+            const auto  x  = system_->positions(system_t::s_working_copies);
+            auto const& cs = std::as_const(*system_);
+            const auto  v  = cs.velocities(system_t::s_working_copies);
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, size_, s_bulk_grain),
+                [&](tbb::blocked_range<std::size_t> const& r) {
+                    // Local, so the stores below cannot alias it
+                    const auto k_h = h;
+                    for (auto i = 0uz; i != s_dimension; ++i)
+                    {
+                        auto* const       xi = x[i].data();
+                        auto const* const vi = v[i].data();
+                        for (auto p = r.begin(); p != r.end(); ++p)
+                        {
+                            xi[p] = xi[p] + vi[p] * k_h;
+                        }
+                    }
+                }
+            );
+        }
+        else
+        {
+            // Systems that track which copy their accelerations are of forget it here,
+            // once, instead of on every concurrent position_write
+            if constexpr (requires { system_->invalidate_copy(0uz); })
+            {
+                system_->invalidate_copy(system_t::s_working_copies);
+            }
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, size_, s_bulk_grain),
+                [this, h](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                    {
+                        system_->position_write(
+                            p_idx,
+                            system_->position_read(p_idx) +
+                                system_->velocity_read(p_idx) * h
+                        );
+                    }
+                }
+            );
+        }
+    }
+
+    // Finest bin whose step is within the criterion. previous is the acceleration at the
+    // start of a step of length h that ends now, if there was one.
+    [[nodiscard]]
+    auto wanted_bin(
+        acceleration_t const&       a,
+        acceleration_t const* const previous,
+        value_type                  h
+    ) const noexcept -> unsigned
+    {
+        const auto magnitude = utils::l2_norm(a.value());
+        auto       limit     = dt_.count();
+        if (magnitude > value_type{ 0 })
+        {
+            limit = std::min(limit, accuracy_ * std::sqrt(length_ / magnitude));
+        }
+        if (previous != nullptr)
+        {
+            auto change = value_type{ 0 };
+            for (auto i = 0uz; i != s_dimension; ++i)
+            {
+                const auto d = a[i] - (*previous)[i];
+                change += d * d;
+            }
+            const auto jerk = std::sqrt(change) / h;
+            if (jerk > value_type{ 0 })
+            {
+                limit = std::min(limit, accuracy_ * magnitude / jerk);
+            }
+        }
+        auto bin = 0u;
+        while (bin != bins_ && step(bin) > limit)
+        {
+            ++bin;
+        }
+        return bin;
+    }
+
+    // Finer at once, coarser only as far as the tick is shared by the coarser steps
+    [[nodiscard]]
+    auto rebin(unsigned bin, unsigned wanted, std::size_t tick) const noexcept
+        -> unsigned
+    {
+        if (wanted >= bin)
+        {
+            return wanted;
+        }
+        while (bin > wanted && tick % ticks(bin - 1) == 0)
+        {
+            --bin;
+        }
+        return bin;
+    }
+};
+
+} // namespace solvers
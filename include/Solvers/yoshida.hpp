@@ -2,6 +2,12 @@
 
 #include "particle_concepts.hpp"
 #include "utils.hpp"
+#include <array>
+#include <cstddef>
+#include <span>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <utility>
 
 #define DEBUG_PRINT_YOSHIDA (false)
 
@@ -10,6 +16,17 @@ namespace solvers
 
 using namespace pm;
 
+// Systems that hand out whole working copies, one contiguous span per coordinate. The
+// accelerations are those of the copy committed last.
+template <typename System>
+concept bulk_system = requires(System& s, System const& cs, std::size_t copy) {
+    s.positions(copy);
+    s.velocities(copy);
+    cs.positions(copy);
+    cs.velocities(copy);
+    s.accelerations(copy);
+};
+
 template <typename System, particle_concepts::Particle Particle_Type>
 struct yoshida4_solver
 {
@@ -22,7 +39,19 @@ struct yoshida4_solver
     using acceleration_t                 = typename particle_t::acceleration_t;
     using mass_t                         = typename particle_t::mass_t;
     using duration_t = std::chrono::duration<value_type>; // default is seconds
-    inline static constexpr auto s_working_copies = s_order;
+    // Stage i only reads copy i - 1 and writes copy i, so the stages alternate between
+    // two working copies: copy i is kept in buffer i % 2, and the last stage writes the
+    // current state
+    inline static constexpr auto s_working_copies = std::size_t{ 2 };
+    // Smallest particle range handed to a worker in the force phase. Walk cost varies a
+    // lot between dense and sparse regions, so ranges are split and stolen on demand.
+    inline static constexpr auto s_parallel_grain = std::size_t{ 16 };
+    // Smallest particle range of the bulk kick and drift loops, which cost the same for
+    // every particle
+    inline static constexpr auto s_bulk_grain = std::size_t{ 4096 };
+    inline static constexpr auto s_dimension  = particle_t::s_dimension;
+    using components_t       = std::array<std::span<value_type>, s_dimension>;
+    using const_components_t = std::array<std::span<value_type const>, s_dimension>;
 
     inline static constexpr auto x0 = value_type{ -1.70241438392 };
     inline static constexpr auto x1 = value_type{ 1.35120719196 };
@@ -49,7 +78,64 @@ struct yoshida4_solver
     {
     }
 
+    [[nodiscard]]
+    static constexpr auto buffer(std::size_t stage) noexcept -> std::size_t
+    {
+        return stage + 1 == s_order ? s_working_copies : stage % s_working_copies;
+    }
+
+    // Through the bulk interface when the system has it, one particle at a time through
+    // the buffer accessors otherwise. Both evaluate the same expressions in the same
+    // order.
     auto run() -> void
+    {
+        if constexpr (bulk_system<system_t>)
+        {
+            run_bulk();
+        }
+        else
+        {
+            run_per_particle();
+        }
+    }
+
+    // Every stage is one fused kick and drift loop per coordinate over contiguous
+    // arrays, split over the workers. Copy s_working_copies is the current state.
+    auto run_bulk() -> void
+    {
+        const auto  dt      = dt_.count();
+        auto const& cs      = std::as_const(*system_);
+        const auto  current = s_working_copies;
+        kick_drift(
+            system_->positions(0),
+            system_->velocities(0),
+            cs.positions(current),
+            cs.velocities(current),
+            nullptr,
+            value_type{ 0 },
+            c[0],
+            dt
+        );
+        for (std::size_t i = 1; i != s_order; ++i)
+        {
+            const auto from = buffer(i - 1);
+            const auto to   = buffer(i);
+            system_->commit_buffer(from);
+            const auto a = const_components_t(system_->accelerations(from));
+            kick_drift(
+                system_->positions(to),
+                system_->velocities(to),
+                cs.positions(from),
+                cs.velocities(from),
+                &a,
+                d[i - 1],
+                c[i],
+                dt
+            );
+        }
+    }
+
+    auto run_per_particle() -> void
     {
         const auto dt = dt_.count();
 
@@ -64,40 +150,38 @@ struct yoshida4_solver
         }
         for (std::size_t i = 1; i != s_order; ++i)
         {
-            system_->commit_buffer(i - 1);
+            const auto from = buffer(i - 1);
+            const auto to   = buffer(i);
+            system_->commit_buffer(from);
 
-            for (std::size_t p_idx = 0; p_idx != size_; ++p_idx)
-            {
-                const auto a = system_->get_acceleration(i - 1, p_idx);
-                system_->velocity_buffer_write(
-                    i,
-                    p_idx,
-                    system_->velocity_buffer_read(i - 1, p_idx) + d[i - 1] * a * dt
-                );
-                system_->position_buffer_write(
-                    i,
-                    p_idx,
-                    system_->position_buffer_read(i - 1, p_idx) +
-                        c[i] * system_->velocity_buffer_read(i, p_idx) * dt
-                );
-            }
-        }
-        for (std::size_t p_idx = 0; p_idx != size_; ++p_idx)
-        {
-            system_->position_write(
-                p_idx,
-                system_->position_buffer_read(s_order - 1, p_idx) +
-                    c[s_order - 1] * system_->velocity_buffer_read(s_order - 1, p_idx) *
-                        dt
-            );
-            system_->velocity_write(
-                p_idx, system_->velocity_buffer_read(s_order - 1, p_idx)
+            // Copy i - 1 is only read and every particle writes its own slot of copy i,
+            // so the result does not depend on the schedule
+            tbb::parallel_for(
+                tbb::blocked_range<std::size_t>(0, size_, s_parallel_grain),
+                [this, i, from, to, dt](tbb::blocked_range<std::size_t> const& r) {
+                    for (auto p_idx = r.begin(); p_idx != r.end(); ++p_idx)
+                    {
+                        const auto a = system_->get_acceleration(from, p_idx);
+                        system_->velocity_buffer_write(
+                            to,
+                            p_idx,
+                            system_->velocity_buffer_read(from, p_idx) +
+                                d[i - 1] * a * dt
+                        );
+                        system_->position_buffer_write(
+                            to,
+                            p_idx,
+                            system_->position_buffer_read(from, p_idx) +
+                                c[i] * system_->velocity_buffer_read(to, p_idx) * dt
+                        );
+                    }
+                }
             );
         }
 #if DEBUG_PRINT_YOSHIDA
         for (std::size_t i = 0; i != size_; ++i)
         {
-            for (std::size_t j = 0; j != s_order; ++j)
+            for (std::size_t j = 0; j != s_working_copies; ++j)
             {
                 std::cout << "---------------------\n";
                 std::cout << system_->position_buffer_read(j, i) << '\t';
@@ -107,5 +191,51 @@ struct yoshida4_solver
         }
 #endif
     }
+
+    // to_v = from_v + kick * a * dt and to_x = from_x + drift * to_v * dt, without the
+    // kick when there are no accelerations. The spans may be longer than the system.
+    auto kick_drift(
+        components_t const&       to_x,
+        components_t const&       to_v,
+        const_components_t const& from_x,
+        const_components_t const& from_v,
+        const_components_t const* a,
+        value_type                kick,
+        value_type                drift,
+        value_type                dt
+    ) const -> void
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, size_, s_bulk_grain),
+            [&](tbb::blocked_range<std::size_t> const& r) {
+                // Locals, so the stores below cannot alias them
+                const auto k_kick  = kick;
+                const auto k_drift = drift;
+                const auto h       = dt;
+                for (auto i = 0uz; i != s_dimension; ++i)
+                {
+                    auto* const       x      = to_x[i].data();
+                    auto* const       v      = to_v[i].data();
+                    auto const* const x_from = from_x[i].data();
+                    auto const* const v_from = from_v[i].data();
+                    if (a == nullptr)
+                    {
+                        for (auto p = r.begin(); p != r.end(); ++p)
+                        {
+                            v[p] = v_from[p];
+                            x[p] = x_from[p] + k_drift * v[p] * h;
+                        }
+                        continue;
+                    }
+                    auto const* const ai = (*a)[i].data();
+                    for (auto p = r.begin(); p != r.end(); ++p)
+                    {
+                        v[p] = v_from[p] + k_kick * ai[p] * h;
+                        x[p] = x_from[p] + k_drift * v[p] * h;
+                    }
+                }
+            }
+        );
+    }
 };
 } // namespace solvers
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <experimental/simd>
+#include <limits>
+#include <type_traits>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// Square roots and reciprocals for the packed force kernels. Packs that fill an AVX or
+// AVX-512 register start from the hardware estimate and refine it with Newton steps, to
+// about 22 to 23 correct bits in float lanes and about 50 in double lanes, a few ulps
+// short of the exact operation. Anything else, 256-bit double packs included, takes
+// sqrt and a division. Scalars always take the exact path.
+
+namespace utility::simd_math
+{
+
+namespace stdx = std::experimental;
+
+namespace detail
+{
+
+// One Newton step each, every step doubles the number of correct bits
+template <typename T>
+[[nodiscard]]
+inline auto rsqrt_step(T const& x, T const& y) noexcept -> T
+{
+    using value_type = typename T::value_type;
+    return y * (value_type{ 1.5 } - value_type{ 0.5 } * x * y * y);
+}
+
+template <typename T>
+[[nodiscard]]
+inline auto reciprocal_step(T const& x, T const& y) noexcept -> T
+{
+    using value_type = typename T::value_type;
+    return y * (value_type{ 2 } - x * y);
+}
+
+template <typename T, typename Abi>
+inline constexpr auto s_bits = stdx::simd<T, Abi>::size() * sizeof(T) * 8;
+
+// Whether rsqrt and reciprocal start from a hardware estimate for such packs. There is
+// none for double below AVX-512, and seeding from float would lose the range of double.
+template <typename T, typename Abi>
+inline constexpr auto s_has_estimate =
+#ifdef __AVX512F__
+    (s_bits<T, Abi> == 512 && (std::same_as<T, double> || std::same_as<T, float>)) ||
+#endif
+#ifdef __AVX__
+    (s_bits<T, Abi> == 256 && std::same_as<T, float>) ||
+#endif
+    false;
+
+} // namespace detail
+
+// Type of the lanes of a pack, or the scalar itself
+template <typename T>
+struct element
+{
+    using type = T;
+};
+
+template <typename T, typename Abi>
+struct element<stdx::simd<T, Abi>>
+{
+    using type = T;
+};
+
+template <typename T>
+using element_t = typename element<T>::type;
+
+// 1 / sqrt(x) for x > 0
+template <std::floating_point T, typename Abi>
+[[nodiscard]]
+inline auto rsqrt(stdx::simd<T, Abi> const& x) noexcept -> stdx::simd<T, Abi>
+{
+    using simd_t = stdx::simd<T, Abi>;
+#ifdef __AVX512F__
+    if constexpr (detail::s_bits<T, Abi> == 512 && std::same_as<T, double>)
+    {
+        const auto y = simd_t(_mm512_rsqrt14_pd(static_cast<__m512d>(x)));
+        return detail::rsqrt_step(x, detail::rsqrt_step(x, y));
+    }
+    if constexpr (detail::s_bits<T, Abi> == 512 && std::same_as<T, float>)
+    {
+        const auto y = simd_t(_mm512_rsqrt14_ps(static_cast<__m512>(x)));
+        return detail::rsqrt_step(x, y);
+    }
+#endif
+#ifdef __AVX__
+    if constexpr (detail::s_bits<T, Abi> == 256 && std::same_as<T, float>)
+    {
+        const auto y = simd_t(_mm256_rsqrt_ps(static_cast<__m256>(x)));
+        return detail::rsqrt_step(x, y);
+    }
+#endif
+    return simd_t(T{ 1 }) / stdx::sqrt(x);
+}
+
+// 1 / x for x != 0
+template <std::floating_point T, typename Abi>
+[[nodiscard]]
+inline auto reciprocal(stdx::simd<T, Abi> const& x) noexcept -> stdx::simd<T, Abi>
+{
+    using simd_t = stdx::simd<T, Abi>;
+#ifdef __AVX512F__
+    if constexpr (detail::s_bits<T, Abi> == 512 && std::same_as<T, double>)
+    {
+        const auto y = simd_t(_mm512_rcp14_pd(static_cast<__m512d>(x)));
+        return detail::reciprocal_step(x, detail::reciprocal_step(x, y));
+    }
+    if constexpr (detail::s_bits<T, Abi> == 512 && std::same_as<T, float>)
+    {
+        const auto y = simd_t(_mm512_rcp14_ps(static_cast<__m512>(x)));
+        return detail::reciprocal_step(x, y);
+    }
+#endif
+#ifdef __AVX__
+    if constexpr (detail::s_bits<T, Abi> == 256 && std::same_as<T, float>)
+    {
+        const auto y = simd_t(_mm256_rcp_ps(static_cast<__m256>(x)));
+        return detail::reciprocal_step(x, y);
+    }
+#endif
+    return simd_t(T{ 1 }) / x;
+}
+
+// sqrt(x) for x >= 0, through the reciprocal square root where it has an estimate, and
+// exactly otherwise. Zero stays zero.
+template <std::floating_point T, typename Abi>
+[[nodiscard]]
+inline auto sqrt(stdx::simd<T, Abi> const& x) noexcept -> stdx::simd<T, Abi>
+{
+    using simd_t = stdx::simd<T, Abi>;
+    if constexpr (detail::s_has_estimate<T, Abi>)
+    {
+        return x * rsqrt(stdx::max(x, simd_t(std::numeric_limits<T>::min())));
+    }
+    else
+    {
+        return stdx::sqrt(x);
+    }
+}
+
+template <std::floating_point T>
+[[nodiscard]]
+inline auto rsqrt(T x) noexcept -> T
+{
+    return T{ 1 } / std::sqrt(x);
+}
+
+template <std::floating_point T>
+[[nodiscard]]
+inline auto reciprocal(T x) noexcept -> T
+{
+    return T{ 1 } / x;
+}
+
+template <std::floating_point T>
+[[nodiscard]]
+inline auto sqrt(T x) noexcept -> T
+{
+    return std::sqrt(x);
+}
+
+} // namespace utility::simd_math
@@ -1,6 +1,7 @@
 #include "barnes_hut_approximation.hpp"
 #include "brute_force.hpp"
 #include "factory.hpp"
+#include "fast_multipole_method.hpp"
 #include "logging.hpp"
 #include "particle.hpp"
 #include "particle_interaction.hpp"
@@ -175,7 +176,45 @@ int brute_force_bench()
     }
 
     simulation::bf::brute_force_computation<particle_t, interaction> simulation_a(
-        particles, config.general_config()
+        particles, config.general_config(), config.brute_force_config()
+    );
+
+    std::cout << "Simulation A\n";
+    simulation_a.run();
+    std::cout << "Done\n";
+
+    return EXIT_SUCCESS;
+}
+
+int fmm_bench()
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+#ifdef NDEBUG
+    const auto config_file_path = "data/input/release/config.ini";
+#else
+    const auto config_file_path = "data/input/debug/config.ini";
+#endif
+
+    const auto config    = simulation::config::parse_config<particle_t>(config_file_path);
+    const auto size      = config.general_config().particle_count_;
+    auto       particles = generate_particle_set<N, F>(size);
+
+    assert(config.is_valid());
+    config.print();
+    if (config.physics_config_.gravitational_constant_.has_value())
+    {
+        pm::physical_parameters<F>::set_gravitational_constant(
+            config.physics_config_.gravitational_constant_.value()
+        );
+    }
+
+    simulation::fmm::fast_multipole_method<particle_t, interaction> simulation_a(
+        particles, config.general_config(), config.fmm_config()
     );
 
     std::cout << "Simulation A\n";
@@ -273,6 +312,7 @@ int main()
     );
     // barnes_hut_bench();
     brute_force_bench();
+    // fmm_bench();
     // electrostatic_test();
 
 #ifdef USE_ROOT_PLOTTING
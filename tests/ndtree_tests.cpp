@@ -1,8 +1,16 @@
+#include "linear_ndtree.hpp"
 #include "ndtree.hpp"
 #include "particle.hpp"
 #include "particle_factory.hpp"
+#include "space_filling_curve.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <execution>
 #include <iostream>
+#include <ranges>
+#include <sstream>
 
 TEST(TreeTests, TreeSplitsAndContainAllElements)
 {
@@ -19,4 +27,795 @@ TEST(TreeTests, TreeSplitsAndContainAllElements)
         ndt::ndtree<Tree_Fanout, particle_t>(particles, depth_t, box_capacity_t);
     const auto n_elements = tree_t.box().elements();
     ASSERT_EQ(n_elements, 10);
-}
\ No newline at end of file
+}
+
+TEST(TreeTests, ArenaHandsOutOneBlockPerFragmentedBox)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 6;
+    const std::size_t  box_capacity    = 2;
+    const F            universe_radius = 100.0;
+    // Enough for rebuilds to build subtrees concurrently
+    const std::size_t size = 2 * tree_t::box_t::s_parallel_build_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    auto tree      = tree_t(particles, depth, box_capacity);
+    ASSERT_EQ(tree.box().elements(), size);
+    EXPECT_EQ(tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes());
+    EXPECT_GE(tree.arena().allocated_blocks(), tree.arena().blocks_in_use());
+
+    // Samples moving a little are relocated into blocks the arena already holds
+    const auto allocated_blocks = tree.arena().allocated_blocks();
+    const auto shrink           = [&particles] {
+        for (auto& p : particles)
+        {
+            p.position()[0] *= F{ 0.999 };
+        }
+    };
+    shrink();
+    tree.reorganize();
+    ASSERT_EQ(tree.box().elements(), size);
+    EXPECT_EQ(tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes());
+    EXPECT_EQ(tree.arena().allocated_blocks(), allocated_blocks);
+
+    // Nor does it take any more alternating relocations and rebuilds
+    for (int i = 0; i != 4; ++i)
+    {
+        for (auto mode : { ndt::ReorganizeMode::relocate, ndt::ReorganizeMode::rebuild })
+        {
+            tree.set_reorganize_policy({ .mode = mode });
+            shrink();
+            tree.reorganize();
+            ASSERT_EQ(tree.box().elements(), size);
+            EXPECT_EQ(
+                tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes()
+            );
+            EXPECT_EQ(tree.arena().allocated_blocks(), allocated_blocks);
+        }
+    }
+}
+
+TEST(TreeTests, RegroupCollapsesSparseBoxesAfterReorganize)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 400;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+
+    // Contract the cloud so most of the tree ends up empty
+    for (auto& p : particles)
+    {
+        for (auto& x : p.position())
+        {
+            x *= F{ 0.05 };
+        }
+    }
+    // Relocated rather than rebuilt, so the emptied boxes are left for regroup
+    tree.set_reorganize_policy({ .mode = ndt::ReorganizeMode::relocate });
+    tree.reorganize();
+    ASSERT_EQ(tree.box().elements(), size);
+    const auto boxes_before  = tree.box().boxes();
+    const auto blocks_in_use = tree.arena().blocks_in_use();
+    tree.regroup();
+    ASSERT_EQ(tree.box().elements(), size);
+    EXPECT_LT(tree.arena().blocks_in_use(), blocks_in_use);
+    EXPECT_EQ(tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes());
+
+    // A regrouped tree has the same topology as a tree built from scratch
+    const auto fresh_tree = tree_t(particles, depth, box_capacity, limits);
+    EXPECT_EQ(tree.box().boxes(), fresh_tree.box().boxes());
+    EXPECT_LT(tree.box().boxes(), boxes_before);
+}
+
+TEST(TreeTests, EscapedSamplesGrowTheRootInsteadOfBeingDropped)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 400;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+    auto       linear_tree =
+        ndt::linear_ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+    const auto boxes_before = tree.box().boxes();
+
+    // Ejected on both sides of the root, one of them far enough for several doublings
+    particles[0].position()[0] = F{ 3 } * universe_radius;
+    particles[1].position()[1] = F{ -20 } * universe_radius;
+    particles[2].position()    = particles[1].position();
+    tree.reorganize();
+    tree.cache_summary();
+    linear_tree.reorganize();
+    linear_tree.cache_summary();
+
+    const auto expected = merge(particles);
+    ASSERT_TRUE(expected.has_value());
+    const auto check = [&](auto const& t) {
+        ASSERT_EQ(t.box().elements(), size);
+        ASSERT_TRUE(t.box().summary().has_value());
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                t.box().summary()->position()[i],
+                expected->position()[i],
+                1e-9 * universe_radius
+            );
+        }
+    };
+    check(tree);
+    check(linear_tree);
+
+    // The old root is one box of the grown one, so the cloud keeps its resolution
+    EXPECT_GE(tree.box().boxes(), boxes_before);
+    tree.regroup();
+    EXPECT_EQ(tree.box().elements(), size);
+}
+
+TEST(TreeTests, RunawayAndNonFiniteSamplesDoNotDeepenTheTree)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 400;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+    auto       linear_tree =
+        ndt::linear_ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+
+    // Overflowed, built from its bits as -ffinite-math-only has no infinity
+    particles[1].position()[2] = std::bit_cast<F>(std::uint64_t{ 0x7ff0000000000000 });
+    const auto check = [&](auto const& t) {
+        const auto bounds =
+            ndt::detail::compute_finite_limits(std::execution::par, particles);
+        ASSERT_TRUE(bounds.has_value());
+        EXPECT_EQ(t.box().elements(), size - 1);
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_DOUBLE_EQ(t.box().boundary().min(i), bounds->min(i));
+            EXPECT_DOUBLE_EQ(t.box().boundary().max(i), bounds->max(i));
+        }
+    };
+    // Every reorganize the sample runs away further than the root may grow towards it,
+    // so the tree is built again in the bounds of the samples instead
+    for (auto distance : { F{ 1e6 }, F{ 1e12 }, F{ 1e18 }, F{ 1e24 } })
+    {
+        particles[0].position()[0] = distance * universe_radius;
+        tree.reorganize();
+        linear_tree.reorganize();
+        EXPECT_TRUE(tree.reorganize_statistics().rebuilt);
+        check(tree);
+        check(linear_tree);
+    }
+}
+
+TEST(TreeTests, AdaptiveReorganizeRebuildsOnlyAfterLargeMigrations)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    // Enough for rebuilds to build subtrees concurrently
+    const std::size_t size = 2 * tree_t::box_t::s_parallel_build_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    // Symmetric, so mirrored samples stay inside the root
+    const auto limits    = typename tree_t::boundary_t(-universe_radius, universe_radius);
+    auto       tree      = tree_t(particles, depth, box_capacity, limits);
+    auto       relocated = tree_t(particles, depth, box_capacity, limits);
+    relocated.set_reorganize_policy({ .mode = ndt::ReorganizeMode::relocate });
+
+    // Nothing moved, there is nothing to relocate
+    tree.reorganize();
+    EXPECT_EQ(tree.reorganize_statistics().samples, size);
+    EXPECT_EQ(tree.reorganize_statistics().escaped, 0);
+    EXPECT_FALSE(tree.reorganize_statistics().rebuilt);
+
+    // Mirrored, almost every sample climbs most of the way to the root
+    const auto mirror = [&particles] {
+        for (auto& p : particles)
+        {
+            for (auto& x : p.position())
+            {
+                x = -x;
+            }
+        }
+    };
+    mirror();
+    tree.reorganize();
+    relocated.reorganize();
+    EXPECT_GT(tree.reorganize_statistics().escaped, size / 2);
+    EXPECT_TRUE(tree.reorganize_statistics().rebuilt);
+    EXPECT_FALSE(relocated.reorganize_statistics().rebuilt);
+    EXPECT_EQ(
+        tree.reorganize_statistics().climbed, relocated.reorganize_statistics().climbed
+    );
+
+    // Either way the tree holds every sample, and the rebuilt one is a fresh tree
+    ASSERT_EQ(tree.box().elements(), size);
+    ASSERT_EQ(relocated.box().elements(), size);
+    const auto fresh_tree = tree_t(particles, depth, box_capacity, limits);
+    EXPECT_EQ(tree.box().boxes(), fresh_tree.box().boxes());
+    EXPECT_EQ(tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes());
+    tree.cache_summary();
+    relocated.cache_summary();
+    ASSERT_TRUE(tree.box().summary().has_value());
+    ASSERT_TRUE(relocated.box().summary().has_value());
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        EXPECT_NEAR(
+            tree.box().summary()->position()[i],
+            relocated.box().summary()->position()[i],
+            1e-9 * universe_radius
+        );
+    }
+
+    // Once it built both shapes concurrently, forced rebuilds between them take nothing
+    // from the heap
+    tree.set_reorganize_policy({ .mode = ndt::ReorganizeMode::rebuild });
+    mirror();
+    tree.reorganize();
+    const auto allocated_blocks  = tree.arena().allocated_blocks();
+    const auto allocated_buffers = tree.arena().allocated_element_buffers();
+    for (int i = 0; i != 4; ++i)
+    {
+        mirror();
+        tree.reorganize();
+        ASSERT_TRUE(tree.reorganize_statistics().rebuilt);
+        ASSERT_EQ(tree.box().elements(), size);
+        EXPECT_EQ(tree.arena().allocated_blocks(), allocated_blocks);
+        EXPECT_EQ(tree.arena().allocated_element_buffers(), allocated_buffers);
+    }
+}
+
+TEST(TreeTests, LimitsAreReducedInOnePassAndBoxesKeepTightSampleBounds)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    // Large enough for the limits to be reduced in several chunks
+    const std::size_t size = 4 * ndt::detail::s_parallel_limits_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    const auto limits = ndt::detail::compute_limits(particles);
+    const auto parallel_limits =
+        ndt::detail::compute_limits(std::execution::par, particles);
+    auto tree = tree_t(std::execution::par, particles, depth, box_capacity);
+    tree.cache_summary();
+    ASSERT_TRUE(tree.box().sample_bounds().has_value());
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        const auto [min, max] = std::ranges::minmax(
+            particles | std::views::transform([i](auto const& p) {
+                return p.position()[i];
+            })
+        );
+        EXPECT_EQ(limits.min(i), min);
+        EXPECT_EQ(limits.max(i), max);
+        EXPECT_EQ(parallel_limits.min(i), min);
+        EXPECT_EQ(parallel_limits.max(i), max);
+        EXPECT_EQ(tree.box().sample_bounds()->min(i), min);
+        EXPECT_EQ(tree.box().sample_bounds()->max(i), max);
+    }
+
+    // Every leaf's bounds are those of its samples, within its boundary
+    const auto check = [](auto const& self, auto const& b) -> void {
+        if (b.fragmented())
+        {
+            for (auto const& sb : b.subboxes())
+            {
+                self(self, sb);
+            }
+            return;
+        }
+        if (std::ranges::empty(b.contained_elements()))
+        {
+            EXPECT_FALSE(b.sample_bounds().has_value());
+            return;
+        }
+        ASSERT_TRUE(b.sample_bounds().has_value());
+        auto const& bounds = b.sample_bounds().value();
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            const auto [min, max] = std::ranges::minmax(
+                b.contained_elements() | std::views::transform([i](auto const* const p) {
+                    return p->position()[i];
+                })
+            );
+            EXPECT_EQ(bounds.min(i), min);
+            EXPECT_EQ(bounds.max(i), max);
+            EXPECT_GE(bounds.min(i), b.boundary().min(i) - tree_t::box_t::s_boundary_tol);
+            EXPECT_LE(bounds.max(i), b.boundary().max(i) + tree_t::box_t::s_boundary_tol);
+        }
+    };
+    check(check, tree.box());
+}
+
+TEST(TreeTests, ParallelBuildReproducesSerialTree)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    // Large enough for the first two levels to be built concurrently
+    const std::size_t size = 20 * tree_t::box_t::s_parallel_build_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    auto serial_tree   = tree_t(particles, depth, box_capacity);
+    auto parallel_tree = tree_t(std::execution::par, particles, depth, box_capacity);
+    serial_tree.cache_summary();
+    parallel_tree.cache_summary();
+    ASSERT_EQ(parallel_tree.box().elements(), size);
+    EXPECT_EQ(
+        parallel_tree.arena().blocks_in_use() * tree_t::s_subdivisions,
+        parallel_tree.box().boxes()
+    );
+
+    std::ostringstream serial_info;
+    std::ostringstream parallel_info;
+    serial_info << serial_tree;
+    parallel_info << parallel_tree;
+    EXPECT_EQ(serial_info.str(), parallel_info.str());
+}
+
+TEST(TreeTests, ParallelRebuildsReuseTheStorageOfTheArena)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 8 * tree_t::box_t::s_parallel_build_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto tree = tree_t(std::execution::par, particles, depth, box_capacity, limits);
+    tree.set_reorganize_policy({ .mode = ndt::ReorganizeMode::rebuild });
+
+    // Built again from the same samples, the tree takes nothing from the heap
+    const auto allocated_blocks  = tree.arena().allocated_blocks();
+    const auto allocated_buffers = tree.arena().allocated_element_buffers();
+    for (int i = 0; i != 4; ++i)
+    {
+        tree.reorganize();
+        ASSERT_TRUE(tree.reorganize_statistics().rebuilt);
+        ASSERT_EQ(tree.box().elements(), size);
+        EXPECT_EQ(tree.arena().allocated_blocks(), allocated_blocks);
+        EXPECT_EQ(tree.arena().allocated_element_buffers(), allocated_buffers);
+    }
+
+    // Nor does it going back and forth between two shapes, once it saw both of them
+    const auto contract = [&particles](F factor) {
+        for (auto& p : particles)
+        {
+            for (auto& x : p.position())
+            {
+                x *= factor;
+            }
+        }
+    };
+    contract(F{ 0.5 });
+    tree.reorganize();
+    contract(F{ 2 });
+    tree.reorganize();
+    const auto warm_blocks  = tree.arena().allocated_blocks();
+    const auto warm_buffers = tree.arena().allocated_element_buffers();
+    for (int i = 0; i != 4; ++i)
+    {
+        contract(F{ 0.5 });
+        tree.reorganize();
+        contract(F{ 2 });
+        tree.reorganize();
+        ASSERT_EQ(tree.box().elements(), size);
+        EXPECT_EQ(tree.arena().allocated_blocks(), warm_blocks);
+        EXPECT_EQ(tree.arena().allocated_element_buffers(), warm_buffers);
+    }
+    EXPECT_EQ(tree.arena().blocks_in_use() * tree_t::s_subdivisions, tree.box().boxes());
+}
+
+TEST(TreeTests, ParallelSummaryMatchesMergeAndCountsStayConsistent)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 8 * tree_t::box_t::s_parallel_summary_grain;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+    for (auto& p : particles)
+    {
+        for (auto& x : p.position())
+        {
+            x *= F{ 0.7 };
+        }
+    }
+    tree.reorganize();
+    tree.regroup();
+    tree.cache_summary();
+
+    // Element counts are kept up to date through reorganize and regroup
+    const auto check = [](auto const& self, auto const& b) -> std::size_t {
+        std::size_t count = 0;
+        if (b.fragmented())
+        {
+            for (auto const& sb : b.subboxes())
+            {
+                count += self(self, sb);
+            }
+        }
+        else
+        {
+            count = b.contained_elements().size();
+            if (count == 1)
+            {
+                // A lone sample is its own summary
+                EXPECT_EQ(b.summary()->id(), b.contained_elements().front()->id());
+            }
+        }
+        EXPECT_EQ(b.elements(), count);
+        return count;
+    };
+    ASSERT_EQ(check(check, tree.box()), size);
+
+    // Up to rounding, as the boxes sum moments where merge weighs mass fractions
+    const auto expected = merge(particles);
+    ASSERT_TRUE(expected.has_value());
+    ASSERT_TRUE(tree.box().summary().has_value());
+    EXPECT_NEAR(
+        tree.box().summary()->mass().magnitude(),
+        expected->mass().magnitude(),
+        1e-9 * expected->mass().magnitude()
+    );
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        EXPECT_NEAR(
+            tree.box().summary()->position()[i],
+            expected->position()[i],
+            1e-9 * universe_radius
+        );
+    }
+}
+
+TEST(TreeTests, UpdateSummaryOnlyRevisitsDirtyPathsAndMatchesFullSummary)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 5000;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto tree = ndt::ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+    tree.cache_summary(ndt::MultipoleOrder::quadrupole);
+    ASSERT_FALSE(tree.box().dirty());
+
+    // Every tenth of the first hundred leaves its box, the others barely move
+    for (std::size_t p_idx = 0; p_idx != 100; ++p_idx)
+    {
+        auto& x = particles[p_idx].position();
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            x[i] = p_idx % 10 == 0 ? -x[i] : x[i] * F{ 1.0001 };
+        }
+        tree.touch(&particles[p_idx]);
+    }
+    tree.reorganize();
+    tree.regroup();
+
+    using box_t = typename decltype(tree)::box_t;
+    const auto visit = [](auto const& self, box_t const& b, auto&& f) -> void {
+        f(b);
+        if (b.fragmented())
+        {
+            for (auto const& sb : b.subboxes())
+            {
+                self(self, sb, f);
+            }
+        }
+    };
+    std::size_t boxes = 0;
+    std::size_t dirty = 0;
+    visit(visit, tree.box(), [&](box_t const& b) {
+        ++boxes;
+        dirty += b.dirty() ? 1 : 0;
+    });
+    EXPECT_GT(dirty, 0);
+    EXPECT_LT(4 * dirty, boxes);
+
+    tree.update_summary(ndt::MultipoleOrder::quadrupole);
+    auto partial = std::vector<std::optional<particle_t>>{};
+    auto moments = std::vector<std::optional<pm::particle::quadrupole_moment<N, F>>>{};
+    auto narrow  = std::vector<std::optional<pm::particle::float_monopole<N>>>{};
+    visit(visit, tree.box(), [&](box_t const& b) {
+        EXPECT_FALSE(b.dirty());
+        partial.push_back(b.summary());
+        moments.push_back(b.quadrupole());
+        narrow.push_back(b.narrow_summary());
+    });
+
+    tree.cache_summary(ndt::MultipoleOrder::quadrupole);
+    std::size_t b_idx = 0;
+    visit(visit, tree.box(), [&](box_t const& b) {
+        ASSERT_EQ(b.summary().has_value(), partial[b_idx].has_value());
+        if (b.summary().has_value())
+        {
+            EXPECT_EQ(b.summary()->mass(), partial[b_idx]->mass());
+            EXPECT_EQ(b.summary()->position(), partial[b_idx]->position());
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                for (std::size_t j = 0; j != N; ++j)
+                {
+                    EXPECT_EQ(b.quadrupole().value()(i, j), moments[b_idx].value()(i, j));
+                }
+            }
+            // Kept in step with the summary by the partial pass too
+            ASSERT_TRUE(narrow[b_idx].has_value());
+            EXPECT_EQ(b.narrow_summary()->mass, narrow[b_idx]->mass);
+            EXPECT_EQ(b.narrow_summary()->position, narrow[b_idx]->position);
+        }
+        ++b_idx;
+    });
+}
+
+TEST(TreeTests, LinearTreeLeavesPartitionTheMortonOrder)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::linear_ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 1000;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+
+    // Leaves visited depth first have to cover the Morton order without gaps
+    const auto check_leaves = [&tree, box_capacity] {
+        auto       next  = tree.sorted_elements().data();
+        const auto visit = [&next, box_capacity](
+                               auto const& self, auto const& b
+                           ) -> void {
+            if (b.fragmented())
+            {
+                for (auto const& sb : b.subboxes())
+                {
+                    self(self, sb);
+                }
+                return;
+            }
+            EXPECT_LE(b.elements(), box_capacity);
+            EXPECT_EQ(b.contained_elements().data(), next);
+            next += b.elements();
+            for (auto const* const e : b.contained_elements())
+            {
+                EXPECT_TRUE(ndt::detail::in(e->position(), b.boundary(), F{ 1e-4 }));
+            }
+        };
+        visit(visit, tree.box());
+        EXPECT_EQ(next, tree.sorted_elements().data() + tree.box().elements());
+        EXPECT_EQ(tree.boxes().size(), tree.box().boxes() + 1);
+    };
+    ASSERT_EQ(tree.box().elements(), size);
+    check_leaves();
+
+    for (auto& p : particles)
+    {
+        for (auto& x : p.position())
+        {
+            x *= F{ 0.5 };
+        }
+    }
+    tree.reorganize();
+    ASSERT_EQ(tree.box().elements(), size);
+    check_leaves();
+
+    // Same cells as the pointer tree, so the root summary has to agree
+    auto pointer_tree =
+        ndt::ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+    tree.cache_summary();
+    pointer_tree.cache_summary();
+    ASSERT_TRUE(tree.box().summary().has_value());
+    ASSERT_TRUE(pointer_tree.box().summary().has_value());
+    EXPECT_NEAR(
+        tree.box().summary()->mass().magnitude(),
+        pointer_tree.box().summary()->mass().magnitude(),
+        1e-9 * pointer_tree.box().summary()->mass().magnitude()
+    );
+    for (std::size_t i = 0; i != N; ++i)
+    {
+        EXPECT_NEAR(
+            tree.box().summary()->position()[i],
+            pointer_tree.box().summary()->position()[i],
+            1e-9 * universe_radius
+        );
+    }
+}
+
+TEST(TreeTests, SpaceFillingCurveOrderSurvivesRebindingTheTree)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    using tree_t                       = ndt::ndtree<2, particle_t>;
+    const unsigned int depth           = 8;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 1000;
+
+    // The Hilbert curve visits every cell once, each one next to the one before
+    static constexpr auto levels = 3u;
+    static constexpr auto side   = ndt::sfc::key_t{ 1 } << levels;
+    auto                  cells  = std::vector<ndt::sfc::cells_t<N>>(side * side * side);
+    for (auto c = 0uz; c != std::ranges::size(cells); ++c)
+    {
+        cells[c] = { c % side, c / side % side, c / side / side };
+    }
+    std::ranges::sort(cells, {}, [](auto const& c) {
+        return ndt::sfc::hilbert_key<levels, N>(c);
+    });
+    for (auto c = 0uz; c != std::ranges::size(cells); ++c)
+    {
+        EXPECT_EQ((ndt::sfc::hilbert_key<levels, N>(cells[c])), c);
+        if (c != 0)
+        {
+            auto steps = ndt::sfc::key_t{ 0 };
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                steps += cells[c][i] > cells[c - 1][i] ? cells[c][i] - cells[c - 1][i]
+                                                       : cells[c - 1][i] - cells[c][i];
+            }
+            EXPECT_EQ(steps, 1u);
+        }
+    }
+
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+    auto       tree   = tree_t(particles, depth, box_capacity, limits);
+    tree.cache_summary();
+    const auto summary = tree.box().summary().value();
+
+    for (const auto curve :
+         { ndt::SpaceFillingCurve::morton, ndt::SpaceFillingCurve::hilbert })
+    {
+        auto keyed   = std::vector<ndt::detail::morton_keyed<std::size_t>>{};
+        auto scratch = std::vector<ndt::detail::morton_keyed<std::size_t>>{};
+        ndt::sfc::sort(
+            curve,
+            size,
+            [&particles](std::size_t idx) { return particles[idx].position(); },
+            limits,
+            keyed,
+            scratch
+        );
+        ASSERT_EQ(keyed.size(), size);
+        EXPECT_TRUE(
+            std::ranges::is_sorted(keyed, {}, [](auto const& e) { return e.key; })
+        );
+
+        auto order = std::vector<std::size_t>(size);
+        auto slots = std::vector<std::size_t>(size);
+        for (auto i = 0uz; i != size; ++i)
+        {
+            order[i]        = keyed[i].value;
+            slots[order[i]] = i;
+        }
+        auto permuted = particles;
+        for (auto i = 0uz; i != size; ++i)
+        {
+            permuted[i] = particles[order[i]];
+        }
+        std::ranges::copy(permuted, particles.begin());
+        auto const* const base = particles.data();
+        tree.rebind([base, &slots](particle_t const* p) {
+            return base + slots[static_cast<std::size_t>(p - base)];
+        });
+
+        // Every leaf holds the same positions as before, at their new slots
+        const auto visit = [](auto const& self, auto const& b) -> void {
+            if (b.fragmented())
+            {
+                for (auto const& sb : b.subboxes())
+                {
+                    self(self, sb);
+                }
+                return;
+            }
+            EXPECT_TRUE(std::ranges::is_sorted(b.contained_elements()));
+            for (auto const* const e : b.contained_elements())
+            {
+                EXPECT_TRUE(ndt::detail::in(e->position(), b.boundary(), F{ 1e-4 }));
+            }
+        };
+        visit(visit, tree.box());
+        ASSERT_EQ(tree.box().elements(), size);
+        tree.cache_summary();
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                tree.box().summary()->position()[i],
+                summary.position()[i],
+                1e-9 * universe_radius
+            );
+        }
+    }
+}
+
+TEST(TreeTests, CachedQuadrupoleMatchesDirectSumAboutCenterOfMass)
+{
+    static constexpr auto N            = 3;
+    using F                            = double;
+    using particle_t                   = pm::particle::ndparticle<N, F>;
+    const unsigned int depth           = 10;
+    const std::size_t  box_capacity    = 4;
+    const F            universe_radius = 100.0;
+    const std::size_t  size            = 5000;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    const auto limits = ndt::detail::compute_limits(particles);
+
+    const auto expected_center = merge(particles);
+    ASSERT_TRUE(expected_center.has_value());
+    auto expected = pm::particle::quadrupole_moment<N, F>{};
+    for (auto const& p : particles)
+    {
+        expected += quadrupole_contribution(p, expected_center->position());
+    }
+
+    const auto check = [&](auto const& tree) {
+        ASSERT_TRUE(tree.box().quadrupole().has_value());
+        auto const& q     = tree.box().quadrupole().value();
+        const auto  scale = std::abs(expected(0, 0)) + std::abs(expected(1, 1));
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            for (std::size_t j = 0; j != N; ++j)
+            {
+                EXPECT_NEAR(q(i, j), expected(i, j), 1e-9 * scale);
+            }
+        }
+    };
+    auto tree = ndt::ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+    tree.cache_summary(ndt::MultipoleOrder::quadrupole);
+    check(tree);
+    tree.cache_summary();
+    EXPECT_FALSE(tree.box().quadrupole().has_value());
+
+    auto linear_tree =
+        ndt::linear_ndtree<2, particle_t>(particles, depth, box_capacity, limits);
+    linear_tree.cache_summary(ndt::MultipoleOrder::quadrupole);
+    check(linear_tree);
+}
@@ -15,7 +15,7 @@ auto generate_particle_set(std::size_t size, F universe_radius)
     auto mass_generator = []() mutable -> F {
         using distribution_t = random_distribution<F, DistributionCategory::Exponential>;
         using param_type     = typename distribution_t::param_type;
-        const param_type      params(0.001);
+        const param_type      params(static_cast<F>(0.001));
         static distribution_t d(params);
         return d() * F{ 100 };
     };
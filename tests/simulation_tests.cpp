@@ -7,12 +7,17 @@
 #include "barnes_hut_approximation.hpp"
 #include "brute_force.hpp"
 #include "factory.hpp"
+#include "fast_multipole_method.hpp"
 #include "particle.hpp"
 #include "particle_factory.hpp"
 #include "simulation_config.hpp"
 #include "synthetic_clock.hpp"
+#include <algorithm>
 #include <chrono>
+#include <execution>
 #include <gtest/gtest.h>
+#include <random>
+#include <tbb/task_arena.h>
 
 constexpr auto universe_radius = 100;
 
@@ -75,6 +80,63 @@ TEST(SimulationTest, TreeAndBruteForceComparisonReturnsSimilarResults)
     );
 }
 
+TEST(SimulationTest, FreeParticlesDriftByVelocityTimesDtEveryStep)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(5),
+        .particle_count_ = 50,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size     = base_config.particle_count_;
+    auto       rng      = std::mt19937{ 7 };
+    auto       uniform  = std::uniform_real_distribution<F>(F{ -1 }, F{ 1 });
+    auto       position = [&]() -> F { return F{ universe_radius } * uniform(rng); };
+    auto       velocity = [&]() -> F { return uniform(rng); };
+    const auto particles = pm::factory::particle_set_factory<N, F>(
+        size, [] { return F{ 1 }; }, position, velocity
+    );
+    // Without gravity every substage drifts with the initial velocity, and the drift
+    // coefficients of a step add up to one
+    physical_parameters<F>::set_gravitational_constant(F{ 0 });
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_ = 7, .tree_box_capacity_ = 3, .theta_ = F{ 0.4 }
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        barnes_simulation_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_simulation_engine(particles, base_config);
+    barnes_simulation_engine.run();
+    brute_force_simulation_engine.run();
+    physical_parameters<F>::reset();
+
+    const auto duration = base_config.duration_.count();
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        auto const& p = particles[p_idx];
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            const auto expected = p.position()[i] + p.velocity()[i] * duration;
+            EXPECT_NEAR(
+                barnes_simulation_engine.position_read(p_idx)[i], expected, 1e-9
+            );
+            EXPECT_NEAR(
+                brute_force_simulation_engine.position_read(p_idx)[i], expected, 1e-9
+            );
+            EXPECT_DOUBLE_EQ(
+                barnes_simulation_engine.velocity_read(p_idx)[i], p.velocity()[i]
+            );
+        }
+    }
+}
+
 TEST(SimulationTest, TreeAndBruteForceComparisonReturnsTheSameResult)
 {
     using namespace pm;
@@ -134,3 +196,907 @@ TEST(SimulationTest, TreeAndBruteForceComparisonReturnsTheSameResult)
         )
     );
 }
+
+TEST(SimulationTest, LinearAndPointerTreeBackendsReturnSimilarResults)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(50),
+        .particle_count_ = 200,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_ = 7, .tree_box_capacity_ = 3, .theta_ = F{ 0.4 }
+    };
+
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        pointer_tree_engine(particles, base_config, bh_config);
+    using linear_tree_t = ndt::linear_ndtree<2, particle_t>;
+    simulation::bh_approx::
+        barnes_hut_approximation<particle_t, interaction, 2, linear_tree_t>
+            linear_tree_engine(particles, base_config, bh_config);
+
+    pointer_tree_engine.run();
+    linear_tree_engine.run();
+
+    // Both backends subdivide the same cells, only the summation order differs
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                pointer_tree_engine.velocity_read(p_idx)[i],
+                linear_tree_engine.velocity_read(p_idx)[i],
+                F{ 1e-9 * universe_radius }
+            );
+        }
+    }
+    EXPECT_EQ(pointer_tree_engine.f_eval_count(), linear_tree_engine.f_eval_count());
+}
+
+TEST(SimulationTest, OpeningCriteriaStayCloseToBruteForce)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    // A few steps, so the relative error criterion has previous accelerations to use
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(5),
+        .particle_count_ = 300,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_simulation_engine(particles, base_config);
+    brute_force_simulation_engine.run();
+
+    const auto check = [&]<typename Criterion>(F theta) {
+        simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+            .tree_max_depth_ = 7, .tree_box_capacity_ = 3, .theta_ = theta
+        };
+        simulation::bh_approx::barnes_hut_approximation<
+            particle_t,
+            interaction,
+            2,
+            ndt::ndtree<2, particle_t>,
+            storage::soa_storage,
+            Criterion>
+            engine(particles, base_config, bh_config);
+        engine.run();
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                EXPECT_NEAR(
+                    engine.velocity_read(p_idx)[i],
+                    brute_force_simulation_engine.velocity_read(p_idx)[i],
+                    F{ 1e-7 * universe_radius }
+                );
+            }
+        }
+        EXPECT_LT(engine.f_eval_count(), brute_force_simulation_engine.f_eval_count());
+    };
+    namespace opening = simulation::bh_approx::opening;
+    check.operator()<opening::geometric>(F{ 0.4 });
+    check.operator()<opening::bmax>(F{ 0.4 });
+    // theta squared is the tolerance on the relative force error
+    check.operator()<opening::relative_error>(F{ 0.05 });
+}
+
+TEST(SimulationTest, MixedPrecisionFarFieldStaysCloseToDoublePrecision)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 1000,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_    = 7,
+        .tree_box_capacity_ = 8,
+        .theta_             = F{ 0.5 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        double_engine(particles, base_config, bh_config);
+    bh_config.mixed_precision_ = true;
+    ASSERT_TRUE(bh_config.is_valid());
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        mixed_engine(particles, base_config, bh_config);
+    double_engine.commit_buffer(0);
+    mixed_engine.commit_buffer(0);
+
+    // The same cells are accepted, only their far field is rounded to float
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = double_engine.get_acceleration(0, p_idx);
+        const auto mixed = mixed_engine.get_acceleration(0, p_idx);
+        const auto scale = utils::l2_norm(exact.value());
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(mixed[i], exact[i], 1e-4 * scale);
+        }
+    }
+    EXPECT_EQ(mixed_engine.f_eval_count(), double_engine.f_eval_count());
+
+    // The cells only carry monopoles in float
+    bh_config.quadrupole_ = true;
+    EXPECT_FALSE(bh_config.is_valid());
+}
+
+TEST(SimulationTest, SinglePrecisionParticlesRunEndToEnd)
+{
+    using namespace pm;
+    using F                    = float;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(5),
+        .particle_count_ = 300,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size      = base_config.particle_count_;
+    auto       particles = particle_factory::generate_particle_set<N, F>(
+        size, static_cast<F>(universe_radius)
+    );
+
+    // With theta 0 every cell is opened, so both sum the same pairs
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_ = 7, .tree_box_capacity_ = 3, .theta_ = F{ 0 }
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        barnes_simulation_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_simulation_engine(particles, base_config);
+    barnes_simulation_engine.commit_buffer(0);
+    brute_force_simulation_engine.compute_accelerations(0);
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = brute_force_simulation_engine.get_acceleration(0, p_idx);
+        const auto tree  = barnes_simulation_engine.get_acceleration(0, p_idx);
+        const auto scale = utils::l2_norm(exact.value());
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(tree[i], exact[i], F{ 1e-3f } * scale);
+        }
+    }
+
+    barnes_simulation_engine.run();
+    brute_force_simulation_engine.run();
+    auto max_speed = F{ 0 };
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        max_speed = std::max(
+            max_speed,
+            utils::l2_norm(brute_force_simulation_engine.velocity_read(p_idx).value())
+        );
+    }
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                barnes_simulation_engine.velocity_read(p_idx)[i],
+                brute_force_simulation_engine.velocity_read(p_idx)[i],
+                F{ 1e-3f } * max_speed
+            );
+        }
+    }
+}
+
+TEST(SimulationTest, ParallelForceEvaluationMatchesSerialRunBitwise)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(20),
+        .particle_count_ = 500,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_ = 7, .tree_box_capacity_ = 3, .theta_ = F{ 0.4 }
+    };
+
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        serial_engine(particles, base_config, bh_config);
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        parallel_engine(particles, base_config, bh_config);
+
+    tbb::task_arena(1).execute([&] { serial_engine.run(); });
+    parallel_engine.run();
+
+    // Every particle is walked by exactly one thread, so the schedule must not show
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_EQ(
+                serial_engine.position_read(p_idx)[i],
+                parallel_engine.position_read(p_idx)[i]
+            );
+            EXPECT_EQ(
+                serial_engine.velocity_read(p_idx)[i],
+                parallel_engine.velocity_read(p_idx)[i]
+            );
+        }
+    }
+    EXPECT_EQ(serial_engine.f_eval_count(), parallel_engine.f_eval_count());
+}
+
+TEST(SimulationTest, BulkBruteForcePassesMatchPerParticleSums)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 1000,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::bf::brute_force_computation<particle_t, interaction> per_particle(
+        particles, base_config
+    );
+    simulation::bf::brute_force_computation<particle_t, interaction> serial(
+        particles, base_config
+    );
+    // The parallel kernels are reached through commit_buffer, as the solver does
+    simulation::bf::brute_force_computation<particle_t, interaction> parallel(
+        particles,
+        base_config,
+        { .kernel_ = simulation::config::BruteForceKernel::pairwise }
+    );
+    simulation::bf::brute_force_computation<particle_t, interaction> simd(
+        particles, base_config, { .kernel_ = simulation::config::BruteForceKernel::simd }
+    );
+    serial.compute_accelerations(0);
+    parallel.commit_buffer(0);
+    simd.commit_buffer(0);
+
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = per_particle.get_acceleration(0, p_idx);
+        const auto scale = utils::l2_norm(exact.value());
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(serial.get_acceleration(0, p_idx)[i], exact[i], 1e-12 * scale);
+            EXPECT_NEAR(parallel.get_acceleration(0, p_idx)[i], exact[i], 1e-12 * scale);
+            EXPECT_NEAR(simd.get_acceleration(0, p_idx)[i], exact[i], 1e-12 * scale);
+        }
+    }
+    EXPECT_EQ(serial.f_eval_count(), per_particle.f_eval_count());
+    EXPECT_EQ(parallel.f_eval_count(), per_particle.f_eval_count());
+    EXPECT_EQ(simd.f_eval_count(), per_particle.f_eval_count());
+
+    // The bands of the pairwise pass are summed in a fixed order, so passes scheduled
+    // differently agree to the last bit
+    simulation::bf::brute_force_computation<particle_t, interaction> again(
+        particles,
+        base_config,
+        { .kernel_ = simulation::config::BruteForceKernel::pairwise }
+    );
+    for (int pass = 0; pass != 4; ++pass)
+    {
+        again.commit_buffer(0);
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                EXPECT_EQ(
+                    again.get_acceleration(0, p_idx)[i],
+                    parallel.get_acceleration(0, p_idx)[i]
+                );
+            }
+        }
+    }
+}
+
+TEST(SimulationTest, SoaAndAosStoragesReturnTheSameResult)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(10),
+        .particle_count_ = 301,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_ = 7, .tree_box_capacity_ = 4, .theta_ = F{ 0.5 }
+    };
+    using bh_aos_t = simulation::bh_approx::barnes_hut_approximation<
+        particle_t,
+        interaction,
+        2,
+        ndt::ndtree<2, particle_t>,
+        storage::aos_storage>;
+
+    simulation::bf::brute_force_computation<particle_t, interaction> bf_aos(
+        particles, base_config
+    );
+    simulation::bf::brute_force_computation<particle_t, interaction, storage::soa_storage>
+        bf_soa(particles, base_config);
+    bh_aos_t bh_aos(particles, base_config, bh_config);
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction> bh_soa(
+        particles, base_config, bh_config
+    );
+
+    bf_aos.run();
+    bf_soa.run();
+    bh_aos.run();
+    bh_soa.run();
+
+    // The storage only changes where the state lives, not how it is computed. The soa
+    // engines are stepped through the bulk interface of the solver, the aos ones through
+    // the per particle accessors.
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_EQ(bf_aos.position_read(p_idx)[i], bf_soa.position_read(p_idx)[i]);
+            EXPECT_EQ(bf_aos.velocity_read(p_idx)[i], bf_soa.velocity_read(p_idx)[i]);
+            EXPECT_EQ(bh_aos.position_read(p_idx)[i], bh_soa.position_read(p_idx)[i]);
+            EXPECT_EQ(bh_aos.velocity_read(p_idx)[i], bh_soa.velocity_read(p_idx)[i]);
+        }
+    }
+    EXPECT_EQ(bh_aos.f_eval_count(), bh_soa.f_eval_count());
+}
+
+TEST(SimulationTest, GroupWalkMatchesBruteForceWithFewerEvaluations)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(50),
+        .particle_count_ = 300,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_    = 7,
+        .tree_box_capacity_ = 4,
+        .theta_             = F{ 0.4 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        group_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_engine(particles, base_config);
+
+    group_engine.run();
+    brute_force_engine.run();
+
+    // Accepting a cell for a whole bucket is stricter than for any of its particles
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                group_engine.velocity_read(p_idx)[i],
+                brute_force_engine.velocity_read(p_idx)[i],
+                F{ 1e-7 * universe_radius }
+            );
+        }
+    }
+    EXPECT_LT(group_engine.f_eval_count(), brute_force_engine.f_eval_count());
+}
+
+TEST(SimulationTest, DualWalkMatchesBruteForceWithFewerEvaluations)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 2000,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    auto bh_config = simulation::config::barnes_hut_specific_config<particle_t>{
+        .tree_max_depth_    = 8,
+        .tree_box_capacity_ = 8,
+        .theta_             = F{ 0.5 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        group_engine(particles, base_config, bh_config);
+    bh_config.traversal_ = simulation::config::TraversalType::dual;
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        dual_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_engine(particles, base_config);
+
+    group_engine.commit_buffer(0);
+    dual_engine.commit_buffer(0);
+    auto mean_error = F{ 0 };
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = brute_force_engine.get_acceleration(0, p_idx);
+        mean_error += utils::l2_norm((dual_engine.get_acceleration(0, p_idx) - exact)
+                                         .value()) /
+                      utils::l2_norm(exact.value()) / static_cast<F>(size);
+    }
+    EXPECT_LT(mean_error, F{ 1e-2 });
+    EXPECT_LT(dual_engine.f_eval_count(), group_engine.f_eval_count());
+}
+
+TEST(SimulationTest, DualWalkDescendsLargeTargetsInParallelOnBothBackends)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using linear_tree_t        = ndt::linear_ndtree<2, particle_t>;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 5000,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    // Two clusters in opposite corners: the root and the boxes down to the clusters
+    // hold more than s_dual_parallel_grain samples in fewer than 2^N sub-boxes
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto corner = p_idx < size / 2 ? F{ -1 } : F{ 1 };
+        for (auto& x : particles[p_idx].position())
+        {
+            x = corner * (F{ universe_radius } - F{ 0.25 } * std::abs(x));
+        }
+    }
+
+    auto bh_config = simulation::config::barnes_hut_specific_config<particle_t>{
+        .tree_max_depth_    = 8,
+        .tree_box_capacity_ = 8,
+        .theta_             = F{ 0.5 },
+        .traversal_         = simulation::config::TraversalType::dual
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        pointer_engine(particles, base_config, bh_config);
+    simulation::bh_approx::
+        barnes_hut_approximation<particle_t, interaction, 2, linear_tree_t>
+            linear_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction>
+        brute_force_engine(particles, base_config);
+    ASSERT_LT(
+        std::ranges::size(linear_engine.tree().box().subboxes()),
+        linear_tree_t::s_subdivisions
+    );
+
+    pointer_engine.commit_buffer(0);
+    linear_engine.commit_buffer(0);
+    auto pointer_error = F{ 0 };
+    auto linear_error  = F{ 0 };
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = brute_force_engine.get_acceleration(0, p_idx);
+        const auto scale = utils::l2_norm(exact.value()) * static_cast<F>(size);
+        pointer_error +=
+            utils::l2_norm((pointer_engine.get_acceleration(0, p_idx) - exact).value()) /
+            scale;
+        linear_error +=
+            utils::l2_norm((linear_engine.get_acceleration(0, p_idx) - exact).value()) /
+            scale;
+    }
+    EXPECT_LT(pointer_error, F{ 1e-2 });
+    EXPECT_LT(linear_error, F{ 1e-2 });
+}
+
+TEST(SimulationTest, QuadrupoleFarFieldLowersForceErrorAtTheSameTheta)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 2000,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    auto bh_config = simulation::config::barnes_hut_specific_config<particle_t>{
+        .tree_max_depth_ = 8, .tree_box_capacity_ = 4, .theta_ = F{ 0.8 }
+    };
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        monopole_engine(particles, base_config, bh_config);
+    bh_config.quadrupole_ = true;
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        quadrupole_engine(particles, base_config, bh_config);
+    simulation::bf::brute_force_computation<particle_t, interaction> brute_force_engine(
+        particles, base_config
+    );
+    monopole_engine.commit_buffer(0);
+    quadrupole_engine.commit_buffer(0);
+
+    auto monopole_error   = F{ 0 };
+    auto quadrupole_error = F{ 0 };
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        const auto exact = brute_force_engine.get_acceleration(0, p_idx);
+        const auto norm  = utils::l2_norm(exact.value());
+        monopole_error +=
+            utils::l2_norm((monopole_engine.get_acceleration(0, p_idx) - exact).value()) /
+            norm;
+        quadrupole_error +=
+            utils::l2_norm((quadrupole_engine.get_acceleration(0, p_idx) - exact).value()
+            ) /
+            norm;
+    }
+    // Both walks open the same cells
+    EXPECT_EQ(monopole_engine.f_eval_count(), quadrupole_engine.f_eval_count());
+    EXPECT_LT(quadrupole_error, F{ 0.5 } * monopole_error);
+}
+
+TEST(SimulationTest, TreeRefitBetweenSubstagesKeepsTheAccuracy)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+    using linear_tree_t   = ndt::linear_ndtree<2, particle_t>;
+    using linear_engine_t = simulation::bh_approx::
+        barnes_hut_approximation<particle_t, interaction, 2, linear_tree_t>;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(10),
+        .particle_count_ = 500,
+        .sim_type_       = simulation::config::SimulationType::_none_
+    };
+    const auto size     = base_config.particle_count_;
+    auto       rng      = std::mt19937{ 42 };
+    auto       uniform  = std::uniform_real_distribution<F>(F{ -1 }, F{ 1 });
+    auto       position = [&]() -> F { return F{ universe_radius } * uniform(rng); };
+    auto       particles = pm::factory::particle_set_factory<N, F>(
+        size, [] { return F{ 1 }; }, position, [] { return F{ 0 }; }
+    );
+    // Strong enough for particles to cross leaves within a step
+    physical_parameters<F>::set_gravitational_constant(F{ 10 });
+
+    auto bh_config = simulation::config::barnes_hut_specific_config<particle_t>{
+        .tree_max_depth_ = 8, .tree_box_capacity_ = 4, .theta_ = F{ 0.5 }
+    };
+    // Wide enough for no particle to leave the tree
+    const auto bounds = typename engine_t::boundary_t(
+        F{ -2 } * universe_radius, F{ 2 } * universe_radius
+    );
+    auto reorganized = engine_t(particles, base_config, bh_config, bounds);
+    bh_config.tree_refit_ = true;
+    auto refitted         = engine_t(particles, base_config, bh_config, bounds);
+    auto linear_refitted  = linear_engine_t(particles, base_config, bh_config, bounds);
+    simulation::bf::brute_force_computation<particle_t, interaction> brute_force_engine(
+        particles, base_config
+    );
+    reorganized.run();
+    refitted.run();
+    linear_refitted.run();
+    brute_force_engine.run();
+    physical_parameters<F>::reset();
+
+    // Mean distance to the brute force positions
+    const auto error = [&](auto const& engine) {
+        auto ret = F{ 0 };
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            ret += utils::l2_norm(
+                (engine.position_read(p_idx) - brute_force_engine.position_read(p_idx))
+                    .value()
+            );
+        }
+        return ret / static_cast<F>(size);
+    };
+    const auto reorganized_error = error(reorganized);
+    EXPECT_LT(error(refitted), F{ 1.25 } * reorganized_error);
+    EXPECT_LT(error(linear_refitted), F{ 1.25 } * reorganized_error);
+}
+
+TEST(SimulationTest, ReorderingAlongACurveKeepsTheTrajectories)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    using engine_t =
+        simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>;
+
+    for (const auto bins : { 0u, 3u })
+    {
+        simulation::config::simulation_common_config<particle_t> base_config{
+            .dt_             = std::chrono::seconds(1),
+            .duration_       = std::chrono::seconds(6),
+            .particle_count_ = 500,
+            .sim_type_       = simulation::config::SimulationType::_none_,
+            .timestep_bins_  = bins
+        };
+        const auto size = base_config.particle_count_;
+        auto       particles =
+            particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+        auto bh_config = simulation::config::barnes_hut_specific_config<particle_t>{
+            .tree_max_depth_ = 8, .tree_box_capacity_ = 4, .theta_ = F{ 0.5 }
+        };
+        auto plain                  = engine_t(particles, base_config, bh_config);
+        bh_config.reorder_interval_ = 2;
+        auto reordered              = engine_t(particles, base_config, bh_config);
+        plain.run();
+        reordered.run();
+
+        // Reordering only changes the order of the sums, the particles are found again
+        // through their original index and keep their ids
+        const auto plain_state     = plain.current_system_state();
+        const auto reordered_state = reordered.current_system_state();
+        auto       moved           = 0uz;
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            const auto original = reordered.original_index(p_idx);
+            moved += original != p_idx ? 1uz : 0uz;
+            EXPECT_EQ(reordered_state[p_idx].id(), plain_state[original].id());
+            for (std::size_t i = 0; i != N; ++i)
+            {
+                EXPECT_NEAR(
+                    reordered.position_read(p_idx)[i],
+                    plain.position_read(original)[i],
+                    1e-6 * universe_radius
+                );
+            }
+        }
+        EXPECT_GT(moved, size / 2);
+
+        const auto in_order = reordered.current_system_state_in_original_order();
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            EXPECT_EQ(in_order[p_idx].id(), plain_state[p_idx].id());
+        }
+    }
+}
+
+TEST(SimulationTest, FmmForceErrorDecreasesWithExpansionOrder)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(1),
+        .particle_count_ = 2000,
+        .sim_type_       = simulation::config::SimulationType::fmm
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+    simulation::bf::brute_force_computation<particle_t, interaction> brute_force_engine(
+        particles, base_config
+    );
+
+    auto previous_error = std::numeric_limits<F>::max();
+    for (const auto order : { 1u, 2u, 4u, 6u })
+    {
+        simulation::config::fmm_specific_config<particle_t> fmm_config{
+            .tree_max_depth_    = 8,
+            .tree_box_capacity_ = 8,
+            .theta_             = F{ 0.5 },
+            .expansion_order_   = order
+        };
+        simulation::fmm::fast_multipole_method<particle_t, interaction> fmm_engine(
+            particles, base_config, fmm_config
+        );
+        fmm_engine.commit_buffer(0);
+
+        auto error = F{ 0 };
+        for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+        {
+            const auto exact = brute_force_engine.get_acceleration(0, p_idx);
+            const auto diff  = fmm_engine.get_acceleration(0, p_idx) - exact;
+            error += utils::l2_norm(diff.value()) / utils::l2_norm(exact.value()) /
+                     static_cast<F>(size);
+        }
+        EXPECT_LT(error, previous_error) << "order " << order;
+        previous_error = error;
+    }
+    EXPECT_LT(previous_error, F{ 2e-4 });
+}
+
+TEST(SimulationTest, FmmAndBruteForceComparisonReturnsSimilarResults)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+
+    simulation::config::simulation_common_config<particle_t> base_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(50),
+        .particle_count_ = 300,
+        .sim_type_       = simulation::config::SimulationType::fmm
+    };
+    const auto size = base_config.particle_count_;
+    auto particles = particle_factory::generate_particle_set<N, F>(size, universe_radius);
+
+    simulation::config::fmm_specific_config<particle_t> fmm_config{
+        .tree_max_depth_    = 7,
+        .tree_box_capacity_ = 4,
+        .theta_             = F{ 0.5 },
+        .expansion_order_   = 5
+    };
+
+    simulation::fmm::fast_multipole_method<particle_t, interaction> fmm_engine(
+        particles, base_config, fmm_config
+    );
+    simulation::bf::brute_force_computation<particle_t, interaction> brute_force_engine(
+        particles, base_config
+    );
+
+    fmm_engine.run();
+    brute_force_engine.run();
+
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            EXPECT_NEAR(
+                fmm_engine.velocity_read(p_idx)[i],
+                brute_force_engine.velocity_read(p_idx)[i],
+                F{ 1e-7 * universe_radius }
+            );
+        }
+    }
+    EXPECT_LT(fmm_engine.f_eval_count(), brute_force_engine.f_eval_count());
+}
+
+TEST(SimulationTest, BlockTimestepsFollowFineStepsWithFewerEvaluations)
+{
+    using namespace pm;
+    using F                    = double;
+    static constexpr auto N    = 3;
+    using particle_t           = particle::ndparticle<N, F>;
+    constexpr auto interaction = pm::interaction::InteractionType::Gravitational;
+    constexpr auto size        = 300uz;
+    constexpr auto core        = 60uz;
+    constexpr auto bins        = 6u;
+
+    // A dense core in a sparse halo: the core needs steps far shorter than the halo
+    auto rng      = std::mt19937{ 42 };
+    auto uniform  = std::uniform_real_distribution<F>(F{ -1 }, F{ 1 });
+    auto calls    = 0uz;
+    auto position = [&]() -> F {
+        const auto radius = calls++ / N < core ? F{ 2 } : F{ universe_radius };
+        return radius * uniform(rng);
+    };
+    auto particles = pm::factory::particle_set_factory<N, F>(
+        size, [] { return F{ 1 }; }, position, [] { return F{ 0 }; }
+    );
+    physical_parameters<F>::set_gravitational_constant(F{ 1 });
+
+    simulation::config::simulation_common_config<particle_t> block_config{
+        .dt_             = std::chrono::seconds(1),
+        .duration_       = std::chrono::seconds(2),
+        .particle_count_ = size,
+        .sim_type_       = simulation::config::SimulationType::_none_,
+        .timestep_bins_  = bins
+    };
+    auto fine_config           = block_config;
+    fine_config.dt_            = std::chrono::duration<F>(F{ 1 } / F{ 1 << bins });
+    fine_config.timestep_bins_ = 0;
+    simulation::config::barnes_hut_specific_config<particle_t> bh_config{
+        .tree_max_depth_    = 7,
+        .tree_box_capacity_ = 4,
+        .theta_             = F{ 0.3 },
+        .traversal_         = simulation::config::TraversalType::group
+    };
+
+    simulation::bf::brute_force_computation<particle_t, interaction> block_engine(
+        particles, block_config
+    );
+    simulation::bf::brute_force_computation<particle_t, interaction> fine_engine(
+        particles, fine_config
+    );
+    simulation::bh_approx::barnes_hut_approximation<particle_t, interaction>
+        group_engine(particles, block_config, bh_config);
+    block_engine.run();
+    fine_engine.run();
+    group_engine.run();
+    physical_parameters<F>::reset();
+
+    auto max_error = F{ 0 };
+    for (std::size_t p_idx = 0; p_idx != size; ++p_idx)
+    {
+        for (std::size_t i = 0; i != N; ++i)
+        {
+            max_error = std::max(
+                max_error,
+                std::abs(
+                    block_engine.position_read(p_idx)[i] -
+                    fine_engine.position_read(p_idx)[i]
+                )
+            );
+            // The group walk only evaluates the buckets holding active particles
+            EXPECT_NEAR(
+                group_engine.position_read(p_idx)[i],
+                block_engine.position_read(p_idx)[i],
+                F{ 1e-3 }
+            );
+        }
+    }
+    // Within a hundredth of the core radius of Yoshida steps as short as the finest
+    // bin, and well under the evaluations of a single force pass per finest step. The
+    // Yoshida solver takes three of them.
+    EXPECT_LT(max_error, F{ 0.02 });
+    EXPECT_LT(4 * block_engine.f_eval_count(), fine_engine.f_eval_count() / 3);
+}